@@ -0,0 +1,37 @@
+#pragma once
+#include <concepts>
+#include <cstddef>
+#include <optional>
+
+#include "common/status.hpp"
+#include "common/types.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// HASH TABLE ENGINES
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  What a harness may assume about an engine. Each engine declares
+///         these as `static constexpr EngineCapabilities capabilities`.
+struct EngineCapabilities {
+    /// Every operation may be called concurrently from any number of threads.
+    bool thread_safe = false;
+    /// The table grows when it fills up instead of having a fixed capacity.
+    bool resizable = false;
+    /// The engine has search_batch(keys, num_keys, results).
+    bool batched = false;
+};
+
+/// @brief  The interface that every KeyType -> ValueType table implements, so
+///         that the tests and benchmarks can treat the engines uniformly.
+///
+/// N.B.  size() is not const, because the parallel engines must lock to read
+///       their length.
+template<typename T>
+concept HashTableEngine = std::default_initializable<T> &&
+        requires(T &table, const KeyType key, const ValueType value) {
+    { table.insert(key, value) } -> std::same_as<ErrorType>;
+    { table.search(key) } -> std::same_as<std::optional<ValueType>>;
+    { table.remove(key) } -> std::same_as<ErrorType>;
+    { table.size() } -> std::convertible_to<size_t>;
+    { T::capabilities } -> std::convertible_to<EngineCapabilities>;
+};
@@ -1,11 +1,35 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////
-/// LOGGING MACROS (not thread safe)
+/// LOGGING MACROS (thread safe)
 ////////////////////////////////////////////////////////////////////////////////
 
-/// Create my own sketchy logger
+/// Usage: LOG_INFO("inserted {} at offset {}", key, offset);
+///
+/// N.B.  The message must be a string literal (we store the pointer, not the
+///       characters) and there may be at most 4 arguments, each of which is an
+///       integer, a floating point number, a bool, an enum, or a pointer. Each
+///       '{}' is replaced by the next argument when the record is formatted.
+/// N.B.  Levels above LOG_LEVEL compile to nothing: the arguments are not even
+///       evaluated. Enabled levels copy a fixed-size binary record into the
+///       calling thread's ring buffer; nothing is formatted on the hot path.
+///       Records are formatted by logger::dump(), by the background flusher,
+///       or at exit. If a thread's ring is full, its new records are dropped
+///       (and counted) rather than blocking the caller.
 #define LOG_LEVEL_TRACE 6
 #define LOG_LEVEL_DEBUG 5
 #define LOG_LEVEL_INFO  4
@@ -18,45 +42,340 @@
     #define LOG_LEVEL       LOG_LEVEL_OFF
 #endif
 
-#define LOG_TRACE(x)                                                                               \
-    do {                                                                                           \
-        if (LOG_LEVEL >= LOG_LEVEL_TRACE) {                                                        \
-            std::cout << "[TRACE]\t[" << __FILE__ << ":" << __LINE__ << "]\t[" << __FUNCTION__     \
-                      << "]\t" << x << std::endl;                                                  \
-        }                                                                                          \
-    } while (0)
-#define LOG_DEBUG(x)                                                                               \
-    do {                                                                                           \
-        if (LOG_LEVEL >= LOG_LEVEL_DEBUG) {                                                        \
-            std::cout << "[DEBUG]\t[" << __FILE__ << ":" << __LINE__ << "]\t[" << __FUNCTION__     \
-                      << "]\t" << x << std::endl;                                                  \
-        }                                                                                          \
-    } while (0)
-#define LOG_INFO(x)                                                                                \
-    do {                                                                                           \
-        if (LOG_LEVEL >= LOG_LEVEL_INFO) {                                                         \
-            std::cout << "[INFO]\t[" << __FILE__ << ":" << __LINE__ << "]\t[" << __FUNCTION__      \
-                      << "]\t" << x << std::endl;                                                  \
-        }                                                                                          \
-    } while (0)
-#define LOG_WARN(x)                                                                                \
-    do {                                                                                           \
-        if (LOG_LEVEL >= LOG_LEVEL_WARN) {                                                         \
-            std::cout << "[WARN]\t[" << __FILE__ << ":" << __LINE__ << "]\t[" << __FUNCTION__      \
-                      << "]\t" << x << std::endl;                                                  \
-        }                                                                                          \
-    } while (0)
-#define LOG_ERROR(x)                                                                               \
-    do {                                                                                           \
-        if (LOG_LEVEL >= LOG_LEVEL_ERROR) {                                                        \
-            std::cout << "[ERROR]\t[" << __FILE__ << ":" << __LINE__ << "]\t[" << __FUNCTION__     \
-                      << "]\t" << x << std::endl;                                                  \
-        }                                                                                          \
-    } while (0)
-#define LOG_FATAL(x)                                                                               \
-    do {                                                                                           \
-        if (LOG_LEVEL >= LOG_LEVEL_FATAL) {                                                        \
-            std::cout << "[FATAL]\t[" << __FILE__ << ":" << __LINE__ << "]\t[" << __FUNCTION__     \
-                      << "]\t" << x << std::endl;                                                  \
-        }                                                                                          \
-    } while (0)
+#define LOG_WRITE_RECORD(level, msg, ...)                                                          \
+    ::logger::write_record((level), __FILE__, __LINE__, __func__, (msg)__VA_OPT__(,) __VA_ARGS__)
+#define LOG_DISABLED(...) do { } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+    #define LOG_TRACE(msg, ...) LOG_WRITE_RECORD(LOG_LEVEL_TRACE, msg __VA_OPT__(,) __VA_ARGS__)
+#else
+    #define LOG_TRACE(...) LOG_DISABLED()
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    #define LOG_DEBUG(msg, ...) LOG_WRITE_RECORD(LOG_LEVEL_DEBUG, msg __VA_OPT__(,) __VA_ARGS__)
+#else
+    #define LOG_DEBUG(...) LOG_DISABLED()
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+    #define LOG_INFO(msg, ...) LOG_WRITE_RECORD(LOG_LEVEL_INFO, msg __VA_OPT__(,) __VA_ARGS__)
+#else
+    #define LOG_INFO(...) LOG_DISABLED()
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+    #define LOG_WARN(msg, ...) LOG_WRITE_RECORD(LOG_LEVEL_WARN, msg __VA_OPT__(,) __VA_ARGS__)
+#else
+    #define LOG_WARN(...) LOG_DISABLED()
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+    #define LOG_ERROR(msg, ...) LOG_WRITE_RECORD(LOG_LEVEL_ERROR, msg __VA_OPT__(,) __VA_ARGS__)
+#else
+    #define LOG_ERROR(...) LOG_DISABLED()
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_FATAL
+    #define LOG_FATAL(msg, ...) LOG_WRITE_RECORD(LOG_LEVEL_FATAL, msg __VA_OPT__(,) __VA_ARGS__)
+#else
+    #define LOG_FATAL(...) LOG_DISABLED()
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// BINARY RECORDS AND PER-THREAD RINGS
+////////////////////////////////////////////////////////////////////////////////
+
+namespace logger {
+
+constexpr size_t max_args = 4;
+/// Records per thread. This must be a power of two.
+constexpr size_t ring_capacity = 1 << 12;
+
+enum class ArgType : uint8_t {
+    unsigned_integer,
+    signed_integer,
+    floating_point,
+    pointer,
+};
+
+/// @brief  A fixed-size log record. Everything but the arguments points to
+///         static storage, so writing one is a handful of stores.
+struct Record {
+    uint64_t timestamp_ns;
+    const char *file;
+    const char *function;
+    const char *message;
+    uint64_t args[max_args];
+    uint32_t line;
+    uint8_t level;
+    uint8_t num_args;
+    ArgType arg_types[max_args];
+};
+
+/// @brief  Single-producer (the owning thread), single-consumer (whoever holds
+///         the registry lock) ring of records.
+struct alignas(64) ThreadRing {
+    alignas(64) std::atomic<uint64_t> head = 0;     // Next record to read
+    alignas(64) std::atomic<uint64_t> tail = 0;     // Next record to write
+    std::atomic<uint64_t> num_dropped = 0;
+    uint64_t thread_index = 0;
+    Record records[ring_capacity];
+
+    /// @brief  Whether there is no room for another record. Only the owner
+    ///         may call this: the consumer can then only make room, so a
+    ///         false result holds until the owner pushes.
+    bool
+    full() const
+    {
+        return this->tail.load(std::memory_order_relaxed) - this->head.load(std::memory_order_acquire) >=
+               ring_capacity;
+    }
+
+    bool
+    try_push(const Record &r)
+    {
+        if (this->full()) {
+            this->num_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        const uint64_t t = this->tail.load(std::memory_order_relaxed);
+        this->records[t & (ring_capacity - 1)] = r;
+        this->tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+/// @brief  Every thread's ring. The rings are shared, so records of a thread
+///         that has exited can still be dumped.
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    uint64_t total_dropped = 0;
+
+    std::mutex flusher_mutex;
+    std::condition_variable flusher_cv;
+    std::thread flusher;
+    bool stop_flusher = false;
+
+    ~Registry();
+};
+
+inline Registry &
+registry()
+{
+    static Registry r;
+    return r;
+}
+
+inline ThreadRing &
+this_thread_ring()
+{
+    thread_local std::shared_ptr<ThreadRing> ring = [] {
+        auto r = std::make_shared<ThreadRing>();
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        r->thread_index = reg.rings.size();
+        reg.rings.push_back(r);
+        return r;
+    }();
+    return *ring;
+}
+
+template<typename T>
+inline void
+encode_arg(Record &r, const T &x)
+{
+    const size_t i = r.num_args;
+    if (i >= max_args) {
+        return;
+    }
+    if constexpr (std::is_enum_v<T>) {
+        encode_arg(r, static_cast<std::underlying_type_t<T>>(x));
+        return;
+    } else if constexpr (std::is_floating_point_v<T>) {
+        r.args[i] = std::bit_cast<uint64_t>(static_cast<double>(x));
+        r.arg_types[i] = ArgType::floating_point;
+    } else if constexpr (std::is_pointer_v<T>) {
+        r.args[i] = reinterpret_cast<uintptr_t>(x);
+        r.arg_types[i] = ArgType::pointer;
+    } else if constexpr (std::is_signed_v<T>) {
+        r.args[i] = static_cast<uint64_t>(static_cast<int64_t>(x));
+        r.arg_types[i] = ArgType::signed_integer;
+    } else {
+        static_assert(std::is_integral_v<T>, "log arguments must be numbers, enums, or pointers");
+        r.args[i] = static_cast<uint64_t>(x);
+        r.arg_types[i] = ArgType::unsigned_integer;
+    }
+    ++r.num_args;
+}
+
+template<typename... Args>
+inline void
+write_record(const int level, const char *file, const int line, const char *function,
+             const char *message, const Args &...args)
+{
+    static_assert(sizeof...(Args) <= max_args, "too many log arguments");
+    ThreadRing &ring = this_thread_ring();
+    // A full ring drops the record anyway, so do not pay for the clock first.
+    if (ring.full()) {
+        ring.num_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Record r;
+    r.timestamp_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    r.file = file;
+    r.function = function;
+    r.message = message;
+    r.line = static_cast<uint32_t>(line);
+    r.level = static_cast<uint8_t>(level);
+    r.num_args = 0;
+    (encode_arg(r, args), ...);
+    ring.try_push(r);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// FORMATTING (off the hot path)
+////////////////////////////////////////////////////////////////////////////////
+
+inline const char *
+level_name(const int level)
+{
+    switch (level) {
+    case LOG_LEVEL_TRACE: return "TRACE";
+    case LOG_LEVEL_DEBUG: return "DEBUG";
+    case LOG_LEVEL_INFO:  return "INFO";
+    case LOG_LEVEL_WARN:  return "WARN";
+    case LOG_LEVEL_ERROR: return "ERROR";
+    case LOG_LEVEL_FATAL: return "FATAL";
+    default:              return "?";
+    }
+}
+
+inline void
+format_arg(std::ostream &os, const Record &r, const size_t i)
+{
+    switch (r.arg_types[i]) {
+    case ArgType::unsigned_integer: os << r.args[i]; break;
+    case ArgType::signed_integer: os << static_cast<int64_t>(r.args[i]); break;
+    case ArgType::floating_point: os << std::bit_cast<double>(r.args[i]); break;
+    case ArgType::pointer: os << reinterpret_cast<const void *>(static_cast<uintptr_t>(r.args[i])); break;
+    }
+}
+
+/// @brief  Format a record in the same layout as the old std::cout logger.
+inline void
+format_record(std::ostream &os, const Record &r, const uint64_t thread_index)
+{
+    os << "[" << level_name(r.level) << "]\t[" << r.file << ":" << r.line << "]\t[" <<
+            r.function << "]\t[thread " << thread_index << " @ " << r.timestamp_ns << "ns]\t";
+    size_t next_arg = 0;
+    for (const char *p = r.message; *p != '\0'; ++p) {
+        if (p[0] == '{' && p[1] == '}' && next_arg < r.num_args) {
+            format_arg(os, r, next_arg++);
+            ++p;
+        } else {
+            os << *p;
+        }
+    }
+    // Arguments without a placeholder are appended.
+    for (; next_arg < r.num_args; ++next_arg) {
+        os << " ";
+        format_arg(os, r, next_arg);
+    }
+    os << "\n";
+}
+
+/// @brief  Drain every thread's ring and write the records, ordered by
+///         timestamp, to os.
+///
+/// @return the number of records written.
+inline size_t
+dump_registry(Registry &reg, std::ostream &os)
+{
+    struct Entry {
+        Record record;
+        uint64_t thread_index;
+    };
+    std::vector<Entry> entries;
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (auto &ring : reg.rings) {
+            const uint64_t h = ring->head.load(std::memory_order_relaxed);
+            const uint64_t t = ring->tail.load(std::memory_order_acquire);
+            for (uint64_t i = h; i < t; ++i) {
+                entries.push_back({ring->records[i & (ring_capacity - 1)], ring->thread_index});
+            }
+            ring->head.store(t, std::memory_order_release);
+            dropped += ring->num_dropped.exchange(0, std::memory_order_relaxed);
+        }
+        reg.total_dropped += dropped;
+    }
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.record.timestamp_ns < b.record.timestamp_ns;
+    });
+    for (const auto &e : entries) {
+        format_record(os, e.record, e.thread_index);
+    }
+    if (dropped != 0) {
+        os << "[WARN]\t[logger]\t" << dropped << " records dropped (ring full)\n";
+    }
+    os.flush();
+    return entries.size();
+}
+
+inline size_t
+dump(std::ostream &os = std::cout)
+{
+    return dump_registry(registry(), os);
+}
+
+/// @brief  Start a thread that dumps the rings every period. Without this,
+///         call dump() yourself; whatever is left is dumped at exit.
+inline void
+start_background_flusher(const std::chrono::milliseconds period = std::chrono::milliseconds(100),
+                         std::ostream &os = std::cout)
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.flusher_mutex);
+    if (reg.flusher.joinable()) {
+        return;
+    }
+    reg.stop_flusher = false;
+    reg.flusher = std::thread([&reg, period, &os] {
+        std::unique_lock<std::mutex> lock(reg.flusher_mutex);
+        while (!reg.stop_flusher) {
+            reg.flusher_cv.wait_for(lock, period, [&reg] { return reg.stop_flusher; });
+            lock.unlock();
+            dump_registry(reg, os);
+            lock.lock();
+        }
+    });
+}
+
+inline void
+stop_flusher_of(Registry &reg)
+{
+    std::thread flusher;
+    {
+        std::lock_guard<std::mutex> lock(reg.flusher_mutex);
+        reg.stop_flusher = true;
+        flusher = std::move(reg.flusher);
+    }
+    reg.flusher_cv.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+}
+
+inline void
+stop_background_flusher()
+{
+    stop_flusher_of(registry());
+}
+
+/// N.B.  This runs at exit, so nothing logged before then is lost.
+inline Registry::~Registry()
+{
+    stop_flusher_of(*this);
+    dump_registry(*this, std::cout);
+}
+
+}  // namespace logger
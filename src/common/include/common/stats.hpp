@@ -0,0 +1,247 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// TABLE STATISTICS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Whether the parallel engines count lock acquisitions, contention,
+///         and probe retries. Set with the MM_ENABLE_TABLE_COUNTERS CMake
+///         option; every target must agree, so it is defined on `common`.
+#if defined(MM_ENABLE_TABLE_COUNTERS)
+inline constexpr bool table_counters_enabled = true;
+#else
+inline constexpr bool table_counters_enabled = false;
+#endif
+
+/// @brief  A snapshot of a table's shape, returned by each engine's stats().
+///
+/// N.B.  For the parallel engines, the snapshot is weakly consistent: each
+///       bucket is read under its own lock, but the table may change while we
+///       walk it.
+struct TableStats {
+    size_t length = 0;
+    size_t capacity = 0;
+    double load_factor = 0.0;
+    /// probe_length_histogram[d] is the number of entries at offset d from
+    /// their home bucket.
+    std::vector<size_t> probe_length_histogram = {};
+    double mean_displacement = 0.0;
+    size_t max_displacement = 0;
+    /// cluster_length_histogram[n] is the number of maximal runs of exactly n
+    /// occupied buckets (with wrap-around).
+    std::vector<size_t> cluster_length_histogram = {};
+    size_t bytes_used = 0;
+
+    /// Only filled in by the parallel engines with MM_ENABLE_TABLE_COUNTERS.
+    bool counters_enabled = false;
+    uint64_t lock_acquisitions = 0;
+    uint64_t contended_locks = 0;
+    /// Operations that gave up their probe and started over: an optimistic
+    /// insert whose plan no longer fit, or a striped operation that had to
+    /// relock its segments in order. Only filled in by configurations that can
+    /// retry; the per-bucket walks block instead.
+    bool probe_retries_enabled = false;
+    uint64_t probe_retries = 0;
+
+    /// Only filled in by tables in cache mode (i.e. with a bounded capacity).
+    size_t cache_capacity = 0;
+    uint64_t evictions = 0;
+    /// Only filled in by tables with TTLs enabled.
+    bool ttl_enabled = false;
+    uint64_t expirations = 0;
+    /// Only filled in by tables with a miss filter: searches that it rejected
+    /// without probing.
+    bool miss_filter_enabled = false;
+    uint64_t filtered_misses = 0;
+
+    void
+    print(std::ostream &os) const
+    {
+        os << "Length: " << this->length << "/Capacity: " << this->capacity <<
+                " (load factor " << this->load_factor << "), Bytes: " << this->bytes_used << "\n";
+        os << "Displacement: mean " << this->mean_displacement << ", max " << this->max_displacement << "\n";
+        print_histogram(os, "Probe lengths", this->probe_length_histogram);
+        print_histogram(os, "Cluster lengths", this->cluster_length_histogram);
+        if (this->counters_enabled) {
+            os << "Locks: " << this->lock_acquisitions << " acquired, " << this->contended_locks << " contended";
+            if (this->probe_retries_enabled) {
+                os << "; probe retries: " << this->probe_retries;
+            }
+            os << "\n";
+        }
+        if (this->cache_capacity != 0) {
+            os << "Cache capacity: " << this->cache_capacity << ", Evictions: " << this->evictions << "\n";
+        }
+        if (this->ttl_enabled) {
+            os << "Expirations: " << this->expirations << "\n";
+        }
+        if (this->miss_filter_enabled) {
+            os << "Filtered misses: " << this->filtered_misses << "\n";
+        }
+    }
+
+private:
+    static void
+    print_histogram(std::ostream &os, const char *name, const std::vector<size_t> &histogram)
+    {
+        os << name << ": {";
+        bool first = true;
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            if (histogram[i] != 0) {
+                os << (first ? "" : ", ") << i << ": " << histogram[i];
+                first = false;
+            }
+        }
+        os << "}\n";
+    }
+};
+
+/// @brief  Build a TableStats by visiting the buckets in index order.
+class TableStatsCollector {
+public:
+    explicit TableStatsCollector(const size_t capacity)
+    {
+        this->stats_.capacity = capacity;
+    }
+
+    void
+    visit(const bool occupied, const size_t offset)
+    {
+        if (!occupied) {
+            this->end_cluster();
+            this->seen_hole_ = true;
+            return;
+        }
+        ++this->stats_.length;
+        if (this->stats_.probe_length_histogram.size() <= offset) {
+            this->stats_.probe_length_histogram.resize(offset + 1, 0);
+        }
+        ++this->stats_.probe_length_histogram[offset];
+        this->total_displacement_ += offset;
+        if (offset > this->stats_.max_displacement) {
+            this->stats_.max_displacement = offset;
+        }
+        // Runs before the first hole may continue from the end of the table.
+        if (!this->seen_hole_) {
+            ++this->leading_cluster_;
+        } else {
+            ++this->current_cluster_;
+        }
+    }
+
+    TableStats
+    finish(const size_t bytes_used)
+    {
+        // Join the trailing run with the leading one across the wrap-around.
+        if (this->seen_hole_) {
+            this->current_cluster_ += this->leading_cluster_;
+        } else {
+            this->current_cluster_ = this->leading_cluster_;
+        }
+        this->end_cluster();
+        this->stats_.bytes_used = bytes_used;
+        if (this->stats_.capacity != 0) {
+            this->stats_.load_factor = static_cast<double>(this->stats_.length) /
+                    static_cast<double>(this->stats_.capacity);
+        }
+        if (this->stats_.length != 0) {
+            this->stats_.mean_displacement = static_cast<double>(this->total_displacement_) /
+                    static_cast<double>(this->stats_.length);
+        }
+        return this->stats_;
+    }
+
+private:
+    void
+    end_cluster()
+    {
+        if (this->current_cluster_ == 0) {
+            return;
+        }
+        if (this->stats_.cluster_length_histogram.size() <= this->current_cluster_) {
+            this->stats_.cluster_length_histogram.resize(this->current_cluster_ + 1, 0);
+        }
+        ++this->stats_.cluster_length_histogram[this->current_cluster_];
+        this->current_cluster_ = 0;
+    }
+
+    TableStats stats_;
+    size_t total_displacement_ = 0;
+    size_t leading_cluster_ = 0;
+    size_t current_cluster_ = 0;
+    bool seen_hole_ = false;
+};
+
+/// @brief  Relaxed-atomic event counters for the parallel engines.
+///
+/// The counters are sharded by thread so that counting does not itself become
+/// a point of contention. Without MM_ENABLE_TABLE_COUNTERS, this is empty and
+/// every method is a no-op.
+class TableCounters {
+public:
+    void
+    add_lock_acquisition()
+    {
+#if defined(MM_ENABLE_TABLE_COUNTERS)
+        this->shard().lock_acquisitions.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    void
+    add_contended_lock()
+    {
+#if defined(MM_ENABLE_TABLE_COUNTERS)
+        this->shard().contended_locks.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    void
+    add_probe_retry()
+    {
+#if defined(MM_ENABLE_TABLE_COUNTERS)
+        this->shard().probe_retries.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    void
+    snapshot(TableStats &stats) const
+    {
+        stats.counters_enabled = table_counters_enabled;
+#if defined(MM_ENABLE_TABLE_COUNTERS)
+        for (const auto &s : this->shards_) {
+            stats.lock_acquisitions += s.lock_acquisitions.load(std::memory_order_relaxed);
+            stats.contended_locks += s.contended_locks.load(std::memory_order_relaxed);
+            stats.probe_retries += s.probe_retries.load(std::memory_order_relaxed);
+        }
+#else
+        (void)stats;
+#endif
+    }
+
+#if defined(MM_ENABLE_TABLE_COUNTERS)
+private:
+    static constexpr size_t num_shards = 16;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> lock_acquisitions = 0;
+        std::atomic<uint64_t> contended_locks = 0;
+        std::atomic<uint64_t> probe_retries = 0;
+    };
+
+    Shard &
+    shard()
+    {
+        static std::atomic<size_t> next_thread_index = 0;
+        thread_local const size_t thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+        return this->shards_[thread_index % num_shards];
+    }
+
+    std::array<Shard, num_shards> shards_;
+#endif
+};
@@ -15,3 +15,9 @@ enum class ErrorType {
     e_notfound,
     e_nohole,
 };
+
+/// What a read-modify-write visitor wants done with the entry it matched.
+enum class MatchAction {
+    keep,
+    erase,
+};
@@ -0,0 +1,399 @@
+#include <array>
+#include <bit>
+#include <cassert>
+
+#include "cuckoo/cuckoo.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// STATIC HELPER FUNCTIONS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Every slot is occupied.
+static constexpr uint32_t full_mask = (uint32_t{1} << cuckoo_slots_per_bucket) - 1;
+
+/// @brief  Derive the second hash function's seed from the first's.
+static uint64_t
+second_seed(const uint64_t hash_seed) {
+  return hash_seed ^ 0x9e3779b97f4a7c15ULL;
+}
+
+/// @brief  Read a bucket field that a writer may be changing concurrently.
+static uint32_t
+load_field(const uint32_t &field) {
+  return std::atomic_ref<uint32_t>(const_cast<uint32_t &>(field)).load(std::memory_order_relaxed);
+}
+
+/// @brief  Write a bucket field that a reader may be reading concurrently.
+static void
+store_field(uint32_t &field, const uint32_t value) {
+  std::atomic_ref<uint32_t>(field).store(value, std::memory_order_relaxed);
+}
+
+static uint32_t
+slot_bit(const size_t slot) {
+  return uint32_t{1} << slot;
+}
+
+/// @brief  Visit every slot, counting an entry outside of its first bucket as
+///         displaced by one.
+template<typename GetBuckets>
+static TableStats
+collect_cuckoo_stats(const std::vector<CuckooBucket> &buckets,
+                     GetBuckets get_buckets,
+                     const size_t bytes_used) {
+  TableStatsCollector collector(buckets.size() * cuckoo_slots_per_bucket);
+  for (size_t b = 0; b < buckets.size(); ++b) {
+    const CuckooBucket &bkt = buckets[b];
+    for (size_t i = 0; i < cuckoo_slots_per_bucket; ++i) {
+      const bool occupied = (bkt.occupied & slot_bit(i)) != 0;
+      collector.visit(occupied, occupied && get_buckets(bkt.keys[i]).first != b ? 1 : 0);
+    }
+  }
+  return collector.finish(bytes_used);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// HELPER CLASSES
+////////////////////////////////////////////////////////////////////////////////
+
+size_t
+CuckooBucket::find(KeyType key) const {
+  for (uint32_t mask = this->occupied; mask != 0; mask &= mask - 1) {
+    const auto slot = static_cast<size_t>(std::countr_zero(mask));
+    if (this->keys[slot] == key) {
+      return slot;
+    }
+  }
+  return SIZE_MAX;
+}
+
+size_t
+CuckooBucket::find_empty() const {
+  if (this->occupied == full_mask) {
+    return SIZE_MAX;
+  }
+  return static_cast<size_t>(std::countr_one(this->occupied));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// SEQUENTIAL HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+SequentialCuckooHashTable::SequentialCuckooHashTable(const uint64_t hash_seed)
+    : first_hasher_(hash_seed), second_hasher_(second_seed(hash_seed)) {}
+
+std::pair<size_t, size_t>
+SequentialCuckooHashTable::get_buckets(KeyType key) const {
+  return {get_home(this->first_hasher_(key), this->num_buckets_),
+          get_home(this->second_hasher_(key), this->num_buckets_)};
+}
+
+ErrorType
+SequentialCuckooHashTable::insert(KeyType key, ValueType value) {
+  LOG_TRACE("Enter");
+  const auto [first, second] = this->get_buckets(key);
+  for (const size_t b : {first, second}) {
+    CuckooBucket &bkt = this->buckets_[b];
+    const size_t slot = bkt.find(key);
+    if (slot != SIZE_MAX) {
+      bkt.values[slot] = value;
+      return ErrorType::ok;
+    }
+  }
+  ++this->length_;
+  for (const size_t b : {first, second}) {
+    CuckooBucket &bkt = this->buckets_[b];
+    const size_t slot = bkt.find_empty();
+    if (slot != SIZE_MAX) {
+      bkt.keys[slot] = key;
+      bkt.values[slot] = value;
+      bkt.occupied |= slot_bit(slot);
+      return ErrorType::ok;
+    }
+  }
+  // Random walk: put the entry in a full bucket, evict a random victim to its
+  // other bucket, and repeat until that bucket has an empty slot.
+  size_t b = first;
+  for (size_t i = 0; i < max_evictions; ++i) {
+    // Xorshift, so that the walk does not cycle between the same few entries.
+    this->victim_seed_ ^= this->victim_seed_ << 13;
+    this->victim_seed_ ^= this->victim_seed_ >> 17;
+    this->victim_seed_ ^= this->victim_seed_ << 5;
+    const size_t victim = this->victim_seed_ % cuckoo_slots_per_bucket;
+    std::swap(key, this->buckets_[b].keys[victim]);
+    std::swap(value, this->buckets_[b].values[victim]);
+    const auto [victim_first, victim_second] = this->get_buckets(key);
+    b = (b == victim_first) ? victim_second : victim_first;
+
+    CuckooBucket &bkt = this->buckets_[b];
+    const size_t slot = bkt.find_empty();
+    if (slot != SIZE_MAX) {
+      bkt.keys[slot] = key;
+      bkt.values[slot] = value;
+      bkt.occupied |= slot_bit(slot);
+      return ErrorType::ok;
+    }
+  }
+  // We still hold an evicted entry. It is counted already, so resize (which
+  // recounts what is in the table) and then insert it.
+  LOG_DEBUG("random walk failed, resizing");
+  [[maybe_unused]] ErrorType e = this->resize(2 * this->num_buckets_);
+  assert(e == ErrorType::ok && "error in resize");
+  return this->insert(key, value);
+}
+
+std::optional<ValueType>
+SequentialCuckooHashTable::search(KeyType key) const {
+  LOG_TRACE("Enter");
+  const auto [first, second] = this->get_buckets(key);
+  for (const size_t b : {first, second}) {
+    const CuckooBucket &bkt = this->buckets_[b];
+    const size_t slot = bkt.find(key);
+    if (slot != SIZE_MAX) {
+      return bkt.values[slot];
+    }
+  }
+  return std::nullopt;
+}
+
+ErrorType
+SequentialCuckooHashTable::remove(KeyType key) {
+  LOG_TRACE("Enter");
+  const auto [first, second] = this->get_buckets(key);
+  for (const size_t b : {first, second}) {
+    CuckooBucket &bkt = this->buckets_[b];
+    const size_t slot = bkt.find(key);
+    if (slot != SIZE_MAX) {
+      bkt.occupied &= ~slot_bit(slot);
+      --this->length_;
+      return ErrorType::ok;
+    }
+  }
+  return ErrorType::e_notfound;
+}
+
+size_t
+SequentialCuckooHashTable::size() const {
+  LOG_TRACE("Enter");
+  return this->length_;
+}
+
+TableStats
+SequentialCuckooHashTable::stats() const {
+  LOG_TRACE("Enter");
+  return collect_cuckoo_stats(this->buckets_,
+      [this](KeyType key) { return this->get_buckets(key); },
+      sizeof(*this) + this->buckets_.capacity() * sizeof(CuckooBucket));
+}
+
+ErrorType
+SequentialCuckooHashTable::resize(size_t new_num_buckets) {
+  LOG_TRACE("Enter");
+  std::vector<CuckooBucket> old_buckets(new_num_buckets);
+  std::swap(old_buckets, this->buckets_);
+  this->num_buckets_ = new_num_buckets;
+  this->length_ = 0;
+  // N.B. This may resize again (recursively) if a random walk fails.
+  for (const auto &bkt : old_buckets) {
+    for (uint32_t mask = bkt.occupied; mask != 0; mask &= mask - 1) {
+      const auto slot = static_cast<size_t>(std::countr_zero(mask));
+      [[maybe_unused]] ErrorType e = this->insert(bkt.keys[slot], bkt.values[slot]);
+      assert(e == ErrorType::ok && "should not have error in insert");
+    }
+  }
+  return ErrorType::ok;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// PARALLEL HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+ParallelCuckooHashTable::PairLock::PairLock(ParallelCuckooHashTable &table,
+                                            const size_t first_bucket,
+                                            const size_t second_bucket) {
+  VersionedLock *a = &table.get_stripe(first_bucket);
+  VersionedLock *b = &table.get_stripe(second_bucket);
+  // Lock in address order (i.e. stripe order) so that writers cannot deadlock.
+  this->low_ = std::min(a, b);
+  this->high_ = (a == b) ? nullptr : std::max(a, b);
+  this->low_->lock();
+  if (this->high_ != nullptr) {
+    this->high_->lock();
+  }
+}
+
+ParallelCuckooHashTable::PairLock::~PairLock() {
+  if (this->high_ != nullptr) {
+    this->high_->unlock();
+  }
+  this->low_->unlock();
+}
+
+ParallelCuckooHashTable::ParallelCuckooHashTable(const uint64_t hash_seed)
+    : first_hasher_(hash_seed), second_hasher_(second_seed(hash_seed)) {}
+
+std::pair<size_t, size_t>
+ParallelCuckooHashTable::get_buckets(KeyType key) const {
+  return {get_home(this->first_hasher_(key), this->num_buckets_),
+          get_home(this->second_hasher_(key), this->num_buckets_)};
+}
+
+VersionedLock &
+ParallelCuckooHashTable::get_stripe(const size_t bucket) {
+  return this->stripes_[bucket % num_stripes];
+}
+
+bool
+ParallelCuckooHashTable::try_insert(KeyType key, ValueType value, const size_t first, const size_t second) {
+  LOG_TRACE("Enter");
+  PairLock lock(*this, first, second);
+  for (const size_t b : {first, second}) {
+    CuckooBucket &bkt = this->buckets_[b];
+    const size_t slot = bkt.find(key);
+    if (slot != SIZE_MAX) {
+      store_field(bkt.values[slot], value);
+      return true;
+    }
+  }
+  for (const size_t b : {first, second}) {
+    CuckooBucket &bkt = this->buckets_[b];
+    const size_t slot = bkt.find_empty();
+    if (slot != SIZE_MAX) {
+      store_field(bkt.keys[slot], key);
+      store_field(bkt.values[slot], value);
+      store_field(bkt.occupied, bkt.occupied | slot_bit(slot));
+      this->length_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+ErrorType
+ParallelCuckooHashTable::make_room(const size_t first, const size_t second) {
+  LOG_TRACE("Enter");
+  // Breadth-first search for a bucket with an empty slot. This reads without
+  // locks, so the path may be stale; each move is checked when we make it.
+  std::array<PathNode, max_path_search> nodes;
+  size_t num_nodes = 0;
+  nodes[num_nodes++] = {first, SIZE_MAX, 0};
+  nodes[num_nodes++] = {second, SIZE_MAX, 0};
+  size_t leaf = SIZE_MAX;
+  for (size_t n = 0; n < num_nodes && leaf == SIZE_MAX; ++n) {
+    const CuckooBucket &bkt = this->buckets_[nodes[n].bucket];
+    if (load_field(bkt.occupied) != full_mask) {
+      leaf = n;
+      break;
+    }
+    for (size_t slot = 0; slot < cuckoo_slots_per_bucket && num_nodes < max_path_search; ++slot) {
+      const auto [victim_first, victim_second] = this->get_buckets(load_field(bkt.keys[slot]));
+      const size_t alternate = (nodes[n].bucket == victim_first) ? victim_second : victim_first;
+      nodes[num_nodes++] = {alternate, n, slot};
+    }
+  }
+  if (leaf == SIZE_MAX) {
+    return ErrorType::e_nohole;
+  }
+
+  // Walk back up the path, moving each parent's entry into its child's bucket.
+  for (size_t n = leaf; nodes[n].parent != SIZE_MAX; n = nodes[n].parent) {
+    const size_t from = nodes[nodes[n].parent].bucket;
+    const size_t to = nodes[n].bucket;
+    PairLock lock(*this, from, to);
+    CuckooBucket &src = this->buckets_[from];
+    CuckooBucket &dst = this->buckets_[to];
+    const size_t slot = nodes[n].slot;
+    const size_t empty = dst.find_empty();
+    if ((src.occupied & slot_bit(slot)) == 0 || empty == SIZE_MAX) {
+      return ErrorType::e_unknown;
+    }
+    const auto [victim_first, victim_second] = this->get_buckets(src.keys[slot]);
+    if (to != victim_first && to != victim_second) {
+      return ErrorType::e_unknown;
+    }
+    store_field(dst.keys[empty], src.keys[slot]);
+    store_field(dst.values[empty], src.values[slot]);
+    store_field(dst.occupied, dst.occupied | slot_bit(empty));
+    store_field(src.occupied, src.occupied & ~slot_bit(slot));
+  }
+  return ErrorType::ok;
+}
+
+ErrorType
+ParallelCuckooHashTable::insert(KeyType key, ValueType value) {
+  LOG_TRACE("Enter");
+  const auto [first, second] = this->get_buckets(key);
+  while (!this->try_insert(key, value, first, second)) {
+    // Someone may take the slot we free before we get to it, in which case we
+    // simply try again.
+    if (this->make_room(first, second) == ErrorType::e_nohole) {
+      return ErrorType::e_nohole;
+    }
+  }
+  return ErrorType::ok;
+}
+
+std::optional<ValueType>
+ParallelCuckooHashTable::search(KeyType key) {
+  LOG_TRACE("Enter");
+  const auto [first, second] = this->get_buckets(key);
+  const VersionedLock &first_stripe = this->get_stripe(first);
+  const VersionedLock &second_stripe = this->get_stripe(second);
+  while (true) {
+    const uint64_t first_version = first_stripe.read_begin();
+    const uint64_t second_version = second_stripe.read_begin();
+    std::optional<ValueType> result = std::nullopt;
+    for (const size_t b : {first, second}) {
+      const CuckooBucket &bkt = this->buckets_[b];
+      for (uint32_t mask = load_field(bkt.occupied); mask != 0; mask &= mask - 1) {
+        const auto slot = static_cast<size_t>(std::countr_zero(mask));
+        if (load_field(bkt.keys[slot]) == key) {
+          result = load_field(bkt.values[slot]);
+          break;
+        }
+      }
+      if (result.has_value()) {
+        break;
+      }
+    }
+    if (!first_stripe.read_retry(first_version) && !second_stripe.read_retry(second_version)) {
+      return result;
+    }
+  }
+}
+
+ErrorType
+ParallelCuckooHashTable::remove(KeyType key) {
+  LOG_TRACE("Enter");
+  const auto [first, second] = this->get_buckets(key);
+  PairLock lock(*this, first, second);
+  for (const size_t b : {first, second}) {
+    CuckooBucket &bkt = this->buckets_[b];
+    const size_t slot = bkt.find(key);
+    if (slot != SIZE_MAX) {
+      store_field(bkt.occupied, bkt.occupied & ~slot_bit(slot));
+      this->length_.fetch_sub(1, std::memory_order_relaxed);
+      return ErrorType::ok;
+    }
+  }
+  return ErrorType::e_notfound;
+}
+
+size_t
+ParallelCuckooHashTable::size() {
+  LOG_TRACE("Enter");
+  return this->length_.load(std::memory_order_relaxed);
+}
+
+TableStats
+ParallelCuckooHashTable::stats() {
+  LOG_TRACE("Enter");
+  return collect_cuckoo_stats(this->buckets_,
+      [this](KeyType key) { return this->get_buckets(key); },
+      sizeof(*this) + this->buckets_.capacity() * sizeof(CuckooBucket) +
+      this->stripes_.capacity() * sizeof(VersionedLock));
+}
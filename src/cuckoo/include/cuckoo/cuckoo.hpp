@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "common/engine.hpp"
+#include "common/logger.hpp"
+#include "common/stats.hpp"
+#include "common/status.hpp"
+#include "common/types.hpp"
+#include "utility/utility.hpp"
+#include "utility/versioned_lock.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// HELPER CLASSES
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Number of entries per bucket, chosen so a bucket fills a cache line.
+inline constexpr size_t cuckoo_slots_per_bucket = 7;
+
+/// @brief  Bucket for the cuckoo hash tables. Every key has two candidate
+///         buckets and may sit in any slot of either.
+struct alignas(64) CuckooBucket {
+  KeyType keys[cuckoo_slots_per_bucket] = {};
+  ValueType values[cuckoo_slots_per_bucket] = {};
+  /// Bit i is set if slot i holds an entry.
+  uint32_t occupied = 0;
+
+  /// @return the slot holding key, or SIZE_MAX.
+  size_t
+  find(KeyType key) const;
+
+  /// @return an empty slot, or SIZE_MAX if the bucket is full.
+  size_t
+  find_empty() const;
+};
+
+static_assert(sizeof(CuckooBucket) == 64, "a bucket should be one cache line");
+
+////////////////////////////////////////////////////////////////////////////////
+/// SEQUENTIAL HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  A bucketized cuckoo hash table: a search reads at most two buckets.
+///         An insert into two full buckets evicts an entry to its other
+///         bucket, and so on (a random walk), resizing if the walk is too long.
+class SequentialCuckooHashTable {
+public:
+  static constexpr EngineCapabilities capabilities = {.thread_safe = false, .resizable = true, .batched = false};
+
+  /// @brief  Construct with random hash seeds.
+  SequentialCuckooHashTable() = default;
+
+  /// @brief  Construct with fixed hash seeds (e.g. for reproducible layouts).
+  explicit SequentialCuckooHashTable(const uint64_t hash_seed);
+
+  /// @brief Insert <key, value> pair, resizing if there is no room.
+  ///
+  /// @return 0 on good; 1 on failure
+  ErrorType
+  insert(KeyType key, ValueType value);
+
+  /// @brief Search for <key, value>.
+  std::optional<ValueType>
+  search(KeyType key) const;
+
+  /// @brief Remove <key, value> pair.
+  ///
+  /// @return 0 on found; 1 otherwise.
+  ErrorType
+  remove(KeyType key);
+
+  /// @brief  Get the number of entries.
+  size_t
+  size() const;
+
+  /// @brief  Summarize the table's shape (see TableStats). An entry in its
+  ///         second bucket counts as displaced by one.
+  TableStats
+  stats() const;
+
+private:
+  /// Give up on a random walk after this many evictions.
+  static constexpr size_t max_evictions = 512;
+
+  std::vector<CuckooBucket> buckets_{1<<17};
+  size_t length_ = 0;
+  size_t num_buckets_ = 1<<17;
+  DefaultHash first_hasher_{random_hash_seed()};
+  DefaultHash second_hasher_{random_hash_seed()};
+  /// Picks the victim slot of each eviction.
+  uint32_t victim_seed_ = 1;
+
+  std::pair<size_t, size_t>
+  get_buckets(KeyType key) const;
+
+  ErrorType
+  resize(size_t new_num_buckets);
+};
+
+static_assert(HashTableEngine<SequentialCuckooHashTable>);
+
+////////////////////////////////////////////////////////////////////////////////
+/// PARALLEL HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  A concurrent bucketized cuckoo hash table with a fixed capacity.
+///
+/// The buckets are striped over VersionedLocks. A writer locks the stripes of
+/// both of a key's buckets (in index order). When both are full, it searches
+/// breadth-first for a short path of evictions that ends at an empty slot,
+/// without holding any locks, and then performs the path backwards one move
+/// at a time, locking only the two buckets of each move and checking that the
+/// move is still valid. Searches take no locks; they read both buckets and
+/// retry if a writer held either stripe, which also covers an entry moving
+/// between its two buckets.
+class ParallelCuckooHashTable {
+public:
+  static constexpr EngineCapabilities capabilities = {.thread_safe = true, .resizable = false, .batched = false};
+
+  /// @brief  Construct with random hash seeds.
+  ParallelCuckooHashTable() = default;
+
+  /// @brief  Construct with fixed hash seeds (e.g. for reproducible layouts).
+  explicit ParallelCuckooHashTable(const uint64_t hash_seed);
+
+  /// @brief Insert <key, value> pair.
+  ///
+  /// @return 0 on good; e_nohole if no eviction path was found.
+  ErrorType
+  insert(KeyType key, ValueType value);
+
+  /// @brief Search for <key, value>.
+  std::optional<ValueType>
+  search(KeyType key);
+
+  /// @brief Remove <key, value> pair.
+  ///
+  /// @return 0 on found; 1 otherwise.
+  ErrorType
+  remove(KeyType key);
+
+  /// @brief  Get the number of entries.
+  size_t
+  size();
+
+  /// @brief  Summarize the table's shape (see SequentialCuckooHashTable).
+  ///
+  /// N.B.  This is not synchronized with the writers, so it is only exact
+  ///       when the table is quiescent.
+  TableStats
+  stats();
+
+private:
+  static constexpr size_t num_stripes = 1<<14;
+  /// The breadth-first search visits at most this many buckets.
+  static constexpr size_t max_path_search = 256;
+
+  /// @brief  One bucket visited by the path search. Moving the entry in
+  ///         `slot` of the parent's bucket into this bucket frees that slot.
+  struct PathNode {
+    size_t bucket;
+    size_t parent;
+    size_t slot;
+  };
+
+  /// @brief  Locks the stripes of two buckets in order. Unlocks them when
+  ///         destroyed.
+  class PairLock {
+  public:
+    PairLock(ParallelCuckooHashTable &table, const size_t first_bucket, const size_t second_bucket);
+    ~PairLock();
+
+    PairLock(const PairLock &) = delete;
+    PairLock &operator=(const PairLock &) = delete;
+
+  private:
+    VersionedLock *low_;
+    VersionedLock *high_;
+  };
+
+  std::vector<CuckooBucket> buckets_{1<<17};
+  std::vector<VersionedLock> stripes_ = std::vector<VersionedLock>(num_stripes);
+  std::atomic<size_t> length_ = 0;
+  size_t num_buckets_ = 1<<17;
+  DefaultHash first_hasher_{random_hash_seed()};
+  DefaultHash second_hasher_{random_hash_seed()};
+
+  std::pair<size_t, size_t>
+  get_buckets(KeyType key) const;
+
+  VersionedLock &
+  get_stripe(const size_t bucket);
+
+  /// @brief  Insert into one of the two buckets if the key is there or there
+  ///         is an empty slot.
+  ///
+  /// @return whether it inserted.
+  bool
+  try_insert(KeyType key, ValueType value, const size_t first, const size_t second);
+
+  /// @brief  Search for and perform a path of evictions that empties a slot in
+  ///         first or second.
+  ///
+  /// @return e_nohole if there is no short path; e_unknown if a concurrent
+  ///         writer invalidated the path (so the caller should retry).
+  ErrorType
+  make_room(const size_t first, const size_t second);
+};
+
+static_assert(HashTableEngine<ParallelCuckooHashTable>);
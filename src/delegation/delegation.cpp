@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "common/logger.hpp"
+#include "common/stats.hpp"
+#include "common/status.hpp"
+#include "common/types.hpp"
+#include "utility/utility.hpp"
+
+#include "delegation/delegation.hpp"
+
+/// @brief  Add one partition's stats into the total. The mean displacement is
+///         weighted by length; the histograms and byte counts add up.
+static void
+merge_stats(TableStats &total, const TableStats &partition)
+{
+  const size_t length = total.length + partition.length;
+  if (length != 0) {
+    total.mean_displacement = (total.mean_displacement * static_cast<double>(total.length) +
+        partition.mean_displacement * static_cast<double>(partition.length)) / static_cast<double>(length);
+  }
+  total.length = length;
+  total.capacity += partition.capacity;
+  total.max_displacement = std::max(total.max_displacement, partition.max_displacement);
+  total.bytes_used += partition.bytes_used;
+  for (auto [histogram, other] : {std::pair{&total.probe_length_histogram, &partition.probe_length_histogram},
+                                  std::pair{&total.cluster_length_histogram, &partition.cluster_length_histogram}}) {
+    if (histogram->size() < other->size()) {
+      histogram->resize(other->size(), 0);
+    }
+    for (size_t i = 0; i < other->size(); ++i) {
+      (*histogram)[i] += (*other)[i];
+    }
+  }
+}
+
+DelegationHashTable::DelegationHashTable()
+    : DelegationHashTable(std::max<size_t>(1, std::thread::hardware_concurrency() / 2)) {}
+
+DelegationHashTable::DelegationHashTable(const size_t num_partitions)
+    : DelegationHashTable(num_partitions, default_initial_capacity) {}
+
+DelegationHashTable::DelegationHashTable(const size_t num_partitions, const size_t initial_capacity) {
+  LOG_TRACE("Enter");
+  assert(num_partitions != 0 && "a table needs at least one partition");
+  // Each partition grows on its own, so there is no need to give each one a
+  // full-sized table up front.
+  const SequentialTableOptions options = {.initial_capacity = std::max<size_t>(1, initial_capacity / num_partitions)};
+  for (size_t i = 0; i < num_partitions; ++i) {
+    this->partitions_.push_back(std::make_unique<Partition>(options));
+  }
+  // Start the owners only once partitions_ is complete, since they never
+  // look at it again.
+  for (auto &partition : this->partitions_) {
+    Partition &p = *partition;
+    p.owner = std::thread([this, &p] { this->serve(p); });
+  }
+}
+
+DelegationHashTable::~DelegationHashTable() {
+  LOG_TRACE("Enter");
+  this->stopping_.store(true, std::memory_order_seq_cst);
+  for (auto &partition : this->partitions_) {
+    partition->wake_epoch.fetch_add(1, std::memory_order_release);
+    partition->wake_epoch.notify_one();
+  }
+  for (auto &partition : this->partitions_) {
+    partition->owner.join();
+  }
+}
+
+DelegationHashTable::Partition &
+DelegationHashTable::get_partition(KeyType key) {
+  // Take the partition from the high bits, so that it does not depend on the
+  // low bits that the partition's own table uses for the home.
+  const uint64_t hashcode = this->hasher_(key);
+  return *this->partitions_[(hashcode * this->partitions_.size()) >> 32];
+}
+
+void
+DelegationHashTable::send(Partition &partition, const DelegatedRequest &request) {
+  while (!partition.ring.try_push(request)) {
+    std::this_thread::yield();
+  }
+  // Pairs with the fence in serve(): either the owner sees our request before
+  // it sleeps, or we see that it is sleeping.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (partition.sleeping.load(std::memory_order_relaxed)) {
+    partition.wake_epoch.fetch_add(1, std::memory_order_release);
+    partition.wake_epoch.notify_one();
+  }
+}
+
+void
+DelegationHashTable::wait(DelegationCompletion &completion) {
+  // N.B.  We never sleep on the completion: the owner would have to notify
+  //       after every request, and the completion may be gone by then.
+  for (size_t spins = 0; completion.done.load(std::memory_order_acquire) == 0; ++spins) {
+    if (spins >= 64) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+DelegationCompletion &
+DelegationHashTable::call(DelegatedOperator op, KeyType key, ValueType value) {
+  // A client has at most one request outstanding outside of search_batch(), so
+  // one completion per thread is enough.
+  thread_local DelegationCompletion completion;
+  completion.done.store(0, std::memory_order_relaxed);
+  this->send(this->get_partition(key), {op, key, value, &completion});
+  wait(completion);
+  return completion;
+}
+
+ErrorType
+DelegationHashTable::insert(KeyType key, ValueType value) {
+  LOG_TRACE("Enter");
+  return this->call(DelegatedOperator::insert, key, value).error;
+}
+
+std::optional<ValueType>
+DelegationHashTable::search(KeyType key) {
+  LOG_TRACE("Enter");
+  return this->call(DelegatedOperator::search, key, 0).value;
+}
+
+void
+DelegationHashTable::search_batch(const KeyType *keys, const size_t num_keys, std::optional<ValueType> *results) {
+  LOG_TRACE("Enter");
+  DelegationCompletion completions[max_batch];
+  for (size_t begin = 0; begin < num_keys; begin += max_batch) {
+    const size_t n = std::min(max_batch, num_keys - begin);
+    for (size_t i = 0; i < n; ++i) {
+      completions[i].done.store(0, std::memory_order_relaxed);
+      const KeyType key = keys[begin + i];
+      this->send(this->get_partition(key), {DelegatedOperator::search, key, 0, &completions[i]});
+    }
+    for (size_t i = 0; i < n; ++i) {
+      wait(completions[i]);
+      results[begin + i] = completions[i].value;
+    }
+  }
+}
+
+ErrorType
+DelegationHashTable::remove(KeyType key) {
+  LOG_TRACE("Enter");
+  return this->call(DelegatedOperator::remove, key, 0).error;
+}
+
+size_t
+DelegationHashTable::size() {
+  LOG_TRACE("Enter");
+  size_t length = 0;
+  for (const auto &partition : this->partitions_) {
+    length += partition->length.load(std::memory_order_relaxed);
+  }
+  return length;
+}
+
+size_t
+DelegationHashTable::num_partitions() const {
+  return this->partitions_.size();
+}
+
+TableStats
+DelegationHashTable::stats() {
+  LOG_TRACE("Enter");
+  TableStats total;
+  for (const auto &partition : this->partitions_) {
+    merge_stats(total, partition->table.stats());
+  }
+  if (total.capacity != 0) {
+    total.load_factor = static_cast<double>(total.length) / static_cast<double>(total.capacity);
+  }
+  // Each partition's table has already counted itself.
+  total.bytes_used += sizeof(*this) +
+      this->partitions_.size() * (sizeof(Partition) - sizeof(SequentialRobinHoodHashTable));
+  return total;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// OWNER THREADS
+////////////////////////////////////////////////////////////////////////////////
+
+void
+DelegationHashTable::serve(Partition &partition) {
+  DelegatedRequest batch[max_batch];
+  size_t idle_polls = 0;
+  while (true) {
+    const size_t n = partition.ring.pop_batch(batch, max_batch);
+    if (n != 0) {
+      this->execute_batch(partition, batch, n);
+      idle_polls = 0;
+      continue;
+    }
+    if (this->stopping_.load(std::memory_order_acquire)) {
+      return;
+    }
+    if (++idle_polls < owner_spin_limit) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // Sleep until a client bumps the epoch. Pairs with the fence in send().
+    const uint32_t epoch = partition.wake_epoch.load(std::memory_order_acquire);
+    partition.sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (partition.ring.empty() && !this->stopping_.load(std::memory_order_relaxed)) {
+      partition.wake_epoch.wait(epoch, std::memory_order_acquire);
+    }
+    partition.sleeping.store(false, std::memory_order_relaxed);
+    idle_polls = 0;
+  }
+}
+
+void
+DelegationHashTable::execute_batch(Partition &partition, DelegatedRequest *requests, const size_t num_requests) {
+  KeyType keys[max_batch];
+  std::optional<ValueType> values[max_batch];
+  size_t i = 0;
+  while (i < num_requests) {
+    DelegatedRequest &r = requests[i];
+    switch (r.op) {
+    case DelegatedOperator::insert: {
+      r.completion->error = partition.table.insert(r.key, r.value);
+      ++i;
+      break;
+    }
+    case DelegatedOperator::remove: {
+      r.completion->error = partition.table.remove(r.key);
+      ++i;
+      break;
+    }
+    case DelegatedOperator::search: {
+      // Search the whole run of consecutive searches at once.
+      size_t end = i;
+      while (end < num_requests && requests[end].op == DelegatedOperator::search) {
+        keys[end - i] = requests[end].key;
+        ++end;
+      }
+      partition.table.search_batch(keys, end - i, values);
+      for (size_t j = i; j < end; ++j) {
+        requests[j].completion->value = values[j - i];
+      }
+      i = end;
+      break;
+    }
+    default: {
+      assert(false && "impossible!");
+    }
+    }
+  }
+
+  // Publish the length first, so that a client sees its own operations in
+  // size() once they complete.
+  partition.length.store(partition.table.size(), std::memory_order_relaxed);
+  for (size_t j = 0; j < num_requests; ++j) {
+    requests[j].completion->done.store(1, std::memory_order_release);
+  }
+}
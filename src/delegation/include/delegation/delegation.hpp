@@ -0,0 +1,255 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "common/engine.hpp"
+#include "common/logger.hpp"
+#include "common/stats.hpp"
+#include "common/status.hpp"
+#include "common/types.hpp"
+#include "sequential/sequential.hpp"
+#include "utility/utility.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// HELPER CLASSES
+////////////////////////////////////////////////////////////////////////////////
+
+enum class DelegatedOperator : uint32_t {
+  insert,
+  search,
+  remove,
+};
+
+/// @brief  Where an owner thread writes the result of one request. The client
+///         that sent the request waits for `done` and then reads the rest.
+struct alignas(64) DelegationCompletion {
+  std::atomic<uint32_t> done = 0;
+  ErrorType error = ErrorType::ok;
+  std::optional<ValueType> value = std::nullopt;
+};
+
+/// @brief  One operation sent to a partition's owner.
+struct DelegatedRequest {
+  DelegatedOperator op = DelegatedOperator::search;
+  KeyType key = 0;
+  ValueType value = 0;
+  DelegationCompletion *completion = nullptr;
+};
+
+/// @brief  A bounded multi-producer, single-consumer ring buffer (Vyukov's
+///         bounded queue, with a single consumer). Each cell has a sequence
+///         number that says whether it is free for the producer of a given
+///         lap or full for the consumer, so producers only contend on the
+///         tail and never on the consumer's head.
+template<typename T, size_t Capacity>
+class MpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+  MpscRing()
+  {
+    for (size_t i = 0; i < Capacity; ++i) {
+      this->cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscRing(const MpscRing &) = delete;
+  MpscRing &operator=(const MpscRing &) = delete;
+
+  /// @return false if the ring is full.
+  bool
+  try_push(const T &item)
+  {
+    size_t tail = this->tail_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell &cell = this->cells_[tail & (Capacity - 1)];
+      const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      if (sequence == tail) {
+        if (this->tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+          cell.item = item;
+          cell.sequence.store(tail + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (sequence < tail) {
+        // The consumer has not freed this cell from the previous lap.
+        return false;
+      } else {
+        tail = this->tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// @brief  Pop up to max_items items into items. Only the owner may call
+  ///         this.
+  ///
+  /// @return the number of items popped.
+  size_t
+  pop_batch(T *items, const size_t max_items)
+  {
+    size_t n = 0;
+    while (n < max_items) {
+      Cell &cell = this->cells_[this->head_ & (Capacity - 1)];
+      if (cell.sequence.load(std::memory_order_acquire) != this->head_ + 1) {
+        break;
+      }
+      items[n++] = cell.item;
+      cell.sequence.store(this->head_ + Capacity, std::memory_order_release);
+      ++this->head_;
+    }
+    return n;
+  }
+
+  /// @brief  Whether the next cell holds an item. Only the owner may call this.
+  bool
+  empty() const
+  {
+    const Cell &cell = this->cells_[this->head_ & (Capacity - 1)];
+    return cell.sequence.load(std::memory_order_acquire) != this->head_ + 1;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  alignas(64) std::atomic<size_t> tail_ = 0;
+  alignas(64) size_t head_ = 0;
+  alignas(64) Cell cells_[Capacity];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  A hash table whose partitions are each owned by one thread.
+///
+/// Every key belongs to one partition, an unlocked SequentialRobinHoodHashTable
+/// that only its owner thread touches. Clients send operations to the owner
+/// through the partition's MPSC ring and wait on a DelegationCompletion for
+/// the result. The owner drains its ring in batches, so one wake-up (and one
+/// pass over the ring's cache lines) serves many requests, and it runs the
+/// batch's consecutive searches through search_batch. The table's buckets never
+/// leave the owner's cache, so hot keys cause no lock traffic and no cache-line
+/// ping-pong; the cost is a round trip through the ring per operation, which
+/// search_batch() and the owner's batching amortize.
+///
+/// N.B.  The owner threads spin for a while when their ring is empty, then
+///       sleep until a client wakes them. Give them their own cores.
+class DelegationHashTable {
+public:
+  static constexpr EngineCapabilities capabilities = {.thread_safe = true, .resizable = true, .batched = true};
+
+  /// @brief  Start one owner thread per partition, by default half of the
+  ///         hardware threads (at least one).
+  DelegationHashTable();
+
+  explicit DelegationHashTable(const size_t num_partitions);
+
+  /// @brief  Start num_partitions owner threads and split initial_capacity
+  ///         buckets evenly between their partitions.
+  DelegationHashTable(const size_t num_partitions, const size_t initial_capacity);
+
+  /// @brief  Stop and join the owner threads. No client may be waiting on the
+  ///         table.
+  ~DelegationHashTable();
+
+  DelegationHashTable(const DelegationHashTable &) = delete;
+  DelegationHashTable &operator=(const DelegationHashTable &) = delete;
+
+  /// @brief Insert <key, value> pair.
+  ///
+  /// @return 0 on good; 1 on failure
+  ErrorType
+  insert(KeyType key, ValueType value);
+
+  /// @brief Search for <key, value>.
+  std::optional<ValueType>
+  search(KeyType key);
+
+  /// @brief Search for a batch of keys. Every request is sent before waiting
+  ///         for any result, so the round trips to the owners overlap.
+  void
+  search_batch(const KeyType *keys, const size_t num_keys, std::optional<ValueType> *results);
+
+  /// @brief Remove <key, value> pair.
+  ///
+  /// @return 0 on found; 1 otherwise.
+  ErrorType
+  remove(KeyType key);
+
+  /// @brief  Get the number of entries, as of the owners' last batches.
+  size_t
+  size();
+
+  size_t
+  num_partitions() const;
+
+  /// @brief  Summarize the shape of all partitions together (see TableStats).
+  ///
+  /// N.B.  This reads the partitions from the calling thread, so it is only
+  ///       safe when no client is using the table.
+  TableStats
+  stats();
+
+private:
+  static constexpr size_t ring_capacity = 1024;
+  /// The most requests an owner takes from its ring at once.
+  static constexpr size_t max_batch = 64;
+  /// How many empty polls an owner makes before it goes to sleep.
+  static constexpr size_t owner_spin_limit = 4096;
+
+  /// As many buckets in all as a single SequentialRobinHoodHashTable starts
+  /// with.
+  static constexpr size_t default_initial_capacity = SequentialTableOptions{}.initial_capacity;
+
+  struct alignas(64) Partition {
+    explicit Partition(const SequentialTableOptions &options) : table(options) {}
+
+    SequentialRobinHoodHashTable table;
+    MpscRing<DelegatedRequest, ring_capacity> ring;
+    /// Written only by the owner, after each batch.
+    alignas(64) std::atomic<size_t> length = 0;
+    /// The owner sets this before it sleeps on wake_epoch; a client that
+    /// sees it bumps wake_epoch and notifies.
+    alignas(64) std::atomic<bool> sleeping = false;
+    std::atomic<uint32_t> wake_epoch = 0;
+    std::thread owner;
+  };
+
+  std::vector<std::unique_ptr<Partition>> partitions_;
+  std::atomic<bool> stopping_ = false;
+  DefaultHash hasher_{random_hash_seed()};
+
+  Partition &
+  get_partition(KeyType key);
+
+  /// @brief  Push request onto partition's ring (waiting while it is full)
+  ///         and wake the owner if it is asleep.
+  void
+  send(Partition &partition, const DelegatedRequest &request);
+
+  /// @brief  Wait until the owner has filled in completion.
+  static void
+  wait(DelegationCompletion &completion);
+
+  /// @brief  Send one request and wait for its result.
+  DelegationCompletion &
+  call(DelegatedOperator op, KeyType key, ValueType value);
+
+  /// @brief  The owner thread's loop: serve batches until stopping_ is set and
+  ///         the ring is empty.
+  void
+  serve(Partition &partition);
+
+  void
+  execute_batch(Partition &partition, DelegatedRequest *requests, const size_t num_requests);
+};
+
+static_assert(HashTableEngine<DelegationHashTable>);
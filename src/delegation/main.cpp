@@ -0,0 +1,59 @@
+#include <iostream>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "delegation/delegation.hpp"
+
+
+int main() {
+  LOG_TRACE("Enter");
+  DelegationHashTable a(4);
+  std::cout << "Partitions: " << a.num_partitions() << "\n";
+  // Insert
+  for (KeyType i = 0; i < 10; ++i) {
+    ErrorType e = a.insert(i, i);
+    std::cout << "Insert (" << static_cast<int>(e) << "): <" << i << ", " << i << ">\n";
+  }
+
+  // Search
+  for (KeyType i = 0; i < 11; ++i) {
+    std::optional<ValueType> value = a.search(i);
+    if (value.has_value()) {
+      std::cout << "Lookup (" << value.has_value() << ") " << i << ": " << value.value() << "\n";
+    } else {
+      std::cout << "Lookup (" << value.has_value() << ") " << i << ": ?\n";
+    }
+  }
+
+  // Batched search
+  const KeyType keys[] = {3, 7, 42};
+  std::optional<ValueType> results[3];
+  a.search_batch(keys, 3, results);
+  for (size_t i = 0; i < 3; ++i) {
+    std::cout << "Batched lookup (" << results[i].has_value() << ") " << keys[i] << "\n";
+  }
+
+  // Remove
+  for (KeyType i = 0; i < 11; ++i) {
+    ErrorType e = a.remove(i);
+    std::cout << "Remove (" << static_cast<int>(e) << "): " << i << "\n";
+  }
+  std::cout << "Size: " << a.size() << "\n";
+
+  // Insert disjoint ranges from 4 threads.
+  std::vector<std::thread> threads;
+  for (KeyType t = 0; t < 4; ++t) {
+    threads.emplace_back([&a, t]() {
+      for (KeyType i = t * 100000; i < (t + 1) * 100000; ++i) {
+        a.insert(i, i);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  std::cout << "Size after 4 threads inserted 100000 keys each: " << a.size() << "\n";
+  a.stats().print(std::cout);
+  return 0;
+}
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "common/logger.hpp"
+#include "common/stats.hpp"
+#include "common/status.hpp"
+#include "common/types.hpp"
+
+#include "flat_combining/flat_combining.hpp"
+
+FlatCombiningHashTable::FlatCombiningHashTable(const uint64_t hash_seed)
+    : table_(hash_seed) {}
+
+CombiningSlot &
+FlatCombiningHashTable::claim_slot() {
+  // Start where this thread last succeeded: once the threads have spread out,
+  // each one finds its own slot free on the first try.
+  thread_local size_t hint = 0;
+  for (size_t i = hint % num_slots; ; i = (i + 1) % num_slots) {
+    CombiningSlot &slot = this->slots_[i];
+    if (!slot.claimed.load(std::memory_order_relaxed) &&
+        !slot.claimed.exchange(true, std::memory_order_acquire)) {
+      hint = i;
+      size_t in_use = this->slots_in_use_.load(std::memory_order_relaxed);
+      while (in_use <= i && !this->slots_in_use_.compare_exchange_weak(in_use, i + 1, std::memory_order_relaxed)) {
+      }
+      return slot;
+    }
+    if (i + 1 == num_slots) {
+      // Every slot is busy; let their owners finish.
+      std::this_thread::yield();
+    }
+  }
+}
+
+void
+FlatCombiningHashTable::release(CombiningSlot &slot) {
+  slot.state.store(CombiningSlot::idle, std::memory_order_relaxed);
+  slot.claimed.store(false, std::memory_order_release);
+}
+
+bool
+FlatCombiningHashTable::try_lock_combiner() {
+  return !this->combiner_locked_.load(std::memory_order_relaxed) &&
+         !this->combiner_locked_.exchange(true, std::memory_order_acquire);
+}
+
+void
+FlatCombiningHashTable::unlock_combiner() {
+  this->combiner_locked_.store(false, std::memory_order_release);
+}
+
+CombiningSlot &
+FlatCombiningHashTable::execute(CombinedOperator op, KeyType key, ValueType value) {
+  CombiningSlot &slot = this->claim_slot();
+  slot.op = op;
+  slot.key = key;
+  slot.value = value;
+  // A combiner that read slots_in_use_ before we claimed a new slot may miss
+  // it; then a later pass, or we ourselves, will apply it.
+  slot.state.store(CombiningSlot::pending, std::memory_order_release);
+
+  for (size_t spins = 0; slot.state.load(std::memory_order_acquire) != CombiningSlot::done; ++spins) {
+    if (this->try_lock_combiner()) {
+      this->combine();
+      this->unlock_combiner();
+      // Our own operation was pending before we took the lock, so the pass
+      // applied it.
+      assert(slot.state.load(std::memory_order_relaxed) == CombiningSlot::done);
+      break;
+    }
+    if (spins >= 64) {
+      std::this_thread::yield();
+    }
+  }
+  return slot;
+}
+
+ErrorType
+FlatCombiningHashTable::insert(KeyType key, ValueType value) {
+  LOG_TRACE("Enter");
+  CombiningSlot &slot = this->execute(CombinedOperator::insert, key, value);
+  const ErrorType e = slot.error;
+  release(slot);
+  return e;
+}
+
+std::optional<ValueType>
+FlatCombiningHashTable::search(KeyType key) {
+  LOG_TRACE("Enter");
+  CombiningSlot &slot = this->execute(CombinedOperator::search, key, 0);
+  const std::optional<ValueType> r = slot.result;
+  release(slot);
+  return r;
+}
+
+ErrorType
+FlatCombiningHashTable::remove(KeyType key) {
+  LOG_TRACE("Enter");
+  CombiningSlot &slot = this->execute(CombinedOperator::remove, key, 0);
+  const ErrorType e = slot.error;
+  release(slot);
+  return e;
+}
+
+size_t
+FlatCombiningHashTable::size() {
+  LOG_TRACE("Enter");
+  return this->length_.load(std::memory_order_relaxed);
+}
+
+TableStats
+FlatCombiningHashTable::stats() {
+  LOG_TRACE("Enter");
+  while (!this->try_lock_combiner()) {
+    std::this_thread::yield();
+  }
+  TableStats stats = this->table_.stats();
+  this->unlock_combiner();
+  stats.bytes_used += sizeof(*this) - sizeof(this->table_);
+  return stats;
+}
+
+void
+FlatCombiningHashTable::combine() {
+  // (home, slot index) of each pending operation.
+  std::pair<size_t, size_t> pending[num_slots];
+  for (size_t pass = 0; pass < max_combining_passes; ++pass) {
+    const size_t end = this->slots_in_use_.load(std::memory_order_relaxed);
+    size_t n = 0;
+    for (size_t i = 0; i < end; ++i) {
+      const CombiningSlot &slot = this->slots_[i];
+      if (slot.state.load(std::memory_order_acquire) == CombiningSlot::pending) {
+        pending[n++] = {this->table_.home_of(slot.key), i};
+      }
+    }
+    if (n == 0) {
+      return;
+    }
+
+    // The pending operations are concurrent (each thread has at most one), so
+    // any order is linearizable. Home order walks the buckets forwards.
+    std::sort(pending, pending + n);
+    for (size_t j = 0; j < n; ++j) {
+      CombiningSlot &slot = this->slots_[pending[j].second];
+      switch (slot.op) {
+      case CombinedOperator::insert: {
+        slot.error = this->table_.insert(slot.key, slot.value);
+        break;
+      }
+      case CombinedOperator::search: {
+        slot.result = this->table_.search(slot.key);
+        break;
+      }
+      case CombinedOperator::remove: {
+        slot.error = this->table_.remove(slot.key);
+        break;
+      }
+      default: {
+        assert(false && "impossible!");
+      }
+      }
+    }
+
+    // Publish the length first, so that a thread sees its own operation in
+    // size() once it is done.
+    this->length_.store(this->table_.size(), std::memory_order_relaxed);
+    for (size_t j = 0; j < n; ++j) {
+      this->slots_[pending[j].second].state.store(CombiningSlot::done, std::memory_order_release);
+    }
+  }
+}
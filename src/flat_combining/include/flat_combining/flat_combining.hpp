@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "common/engine.hpp"
+#include "common/logger.hpp"
+#include "common/stats.hpp"
+#include "common/status.hpp"
+#include "common/types.hpp"
+#include "sequential/sequential.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// HELPER CLASSES
+////////////////////////////////////////////////////////////////////////////////
+
+enum class CombinedOperator : uint32_t {
+  insert,
+  search,
+  remove,
+};
+
+/// @brief  A publication slot: a thread claims one for the duration of an
+///         operation, writes its request, and marks it pending. The combiner
+///         writes the result and marks it done.
+struct alignas(64) CombiningSlot {
+  enum State : uint32_t {
+    idle,
+    pending,
+    done,
+  };
+
+  std::atomic<bool> claimed = false;
+  std::atomic<uint32_t> state = idle;
+  CombinedOperator op = CombinedOperator::search;
+  KeyType key = 0;
+  ValueType value = 0;
+  ErrorType error = ErrorType::ok;
+  std::optional<ValueType> result = std::nullopt;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  A flat-combining front end for SequentialRobinHoodHashTable.
+///
+/// A thread publishes its operation in a slot and then either waits for it to
+/// be done or, if nobody holds the combiner lock, takes the lock and applies
+/// every pending operation itself, in order of home bucket, before releasing
+/// it. The table is only ever touched by the lock holder, so it runs the
+/// unchanged sequential code, and under high contention one thread does the
+/// work of many with its caches warm rather than the buckets' cache lines
+/// bouncing between cores.
+class FlatCombiningHashTable {
+public:
+  static constexpr EngineCapabilities capabilities = {.thread_safe = true, .resizable = true, .batched = false};
+
+  FlatCombiningHashTable() = default;
+
+  /// @brief  Construct with a fixed hash seed (e.g. for reproducible layouts).
+  explicit FlatCombiningHashTable(const uint64_t hash_seed);
+
+  FlatCombiningHashTable(const FlatCombiningHashTable &) = delete;
+  FlatCombiningHashTable &operator=(const FlatCombiningHashTable &) = delete;
+
+  /// @brief Insert <key, value> pair.
+  ///
+  /// @return 0 on good; 1 on failure
+  ErrorType
+  insert(KeyType key, ValueType value);
+
+  /// @brief Search for <key, value>.
+  std::optional<ValueType>
+  search(KeyType key);
+
+  /// @brief Remove <key, value> pair.
+  ///
+  /// @return 0 on found; 1 otherwise.
+  ErrorType
+  remove(KeyType key);
+
+  /// @brief  Get the number of entries, as of the last combining pass.
+  size_t
+  size();
+
+  /// @brief  Summarize the table's shape (see TableStats). This takes the
+  ///         combiner lock, so it is exact.
+  TableStats
+  stats();
+
+private:
+  /// At most this many operations can be in flight at once; any more wait for
+  /// a free slot.
+  static constexpr size_t num_slots = 128;
+  /// A combiner gives up the lock after this many passes over the slots, even
+  /// if more operations keep arriving.
+  static constexpr size_t max_combining_passes = 4;
+
+  CombiningSlot slots_[num_slots];
+  /// One past the highest slot ever claimed, so the combiner need not scan the
+  /// rest.
+  alignas(64) std::atomic<size_t> slots_in_use_ = 0;
+  alignas(64) std::atomic<bool> combiner_locked_ = false;
+  alignas(64) std::atomic<size_t> length_ = 0;
+  /// Only touched by the combiner lock's holder.
+  SequentialRobinHoodHashTable table_;
+
+  /// @brief  Publish an operation, wait for it to be applied (combining if
+  ///         possible), and return its slot, still claimed.
+  CombiningSlot &
+  execute(CombinedOperator op, KeyType key, ValueType value);
+
+  /// @brief  Mark slot as free for another operation.
+  static void
+  release(CombiningSlot &slot);
+
+  CombiningSlot &
+  claim_slot();
+
+  bool
+  try_lock_combiner();
+
+  void
+  unlock_combiner();
+
+  /// @brief  Apply the pending operations. The caller must hold the combiner
+  ///         lock.
+  void
+  combine();
+};
+
+static_assert(HashTableEngine<FlatCombiningHashTable>);
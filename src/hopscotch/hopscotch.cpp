@@ -0,0 +1,336 @@
+#include <bit>
+#include <cassert>
+
+#include "hopscotch/hopscotch.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// STATIC HELPER FUNCTIONS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Read a bucket field that a writer may be changing concurrently.
+static uint32_t
+load_field(const uint32_t &field) {
+  return std::atomic_ref<uint32_t>(const_cast<uint32_t &>(field)).load(std::memory_order_relaxed);
+}
+
+/// @brief  Write a bucket field that a reader may be reading concurrently.
+static void
+store_field(uint32_t &field, const uint32_t value) {
+  std::atomic_ref<uint32_t>(field).store(value, std::memory_order_relaxed);
+}
+
+static uint32_t
+hop_bit(const size_t distance) {
+  assert(distance < hopscotch_neighbourhood_size && "outside of the neighbourhood");
+  return uint32_t{1} << distance;
+}
+
+/// @brief  Visit the buckets in the table's shape, with each entry's distance
+///         from its home as its offset.
+static TableStats
+collect_hopscotch_stats(const std::vector<HopscotchBucket> &buckets,
+                        const size_t capacity,
+                        const size_t bytes_used) {
+  std::vector<size_t> offsets(buckets.size(), 0);
+  for (size_t home = 0; home < capacity; ++home) {
+    for (uint32_t hop = buckets[home].hop_info; hop != 0; hop &= hop - 1) {
+      offsets[home + static_cast<size_t>(std::countr_zero(hop))] = static_cast<size_t>(std::countr_zero(hop));
+    }
+  }
+  TableStatsCollector collector(capacity);
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    collector.visit(buckets[i].occupied != 0, offsets[i]);
+  }
+  return collector.finish(bytes_used);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// SEQUENTIAL HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+SequentialHopscotchHashTable::SequentialHopscotchHashTable(const uint64_t hash_seed)
+    : hasher_(hash_seed) {}
+
+size_t
+SequentialHopscotchHashTable::find_index(KeyType key, const size_t home) const {
+  for (uint32_t hop = this->buckets_[home].hop_info; hop != 0; hop &= hop - 1) {
+    const size_t index = home + static_cast<size_t>(std::countr_zero(hop));
+    if (this->buckets_[index].key == key) {
+      return index;
+    }
+  }
+  return SIZE_MAX;
+}
+
+size_t
+SequentialHopscotchHashTable::make_room(const size_t home) {
+  LOG_TRACE("Enter");
+  size_t free = home;
+  const size_t end = home + hopscotch_max_probe;
+  while (free < end && this->buckets_[free].occupied) {
+    ++free;
+  }
+  if (free == end) {
+    return SIZE_MAX;
+  }
+  // Hop the empty bucket backwards until it is within home's neighbourhood.
+  // Each hop moves the nearest-to-its-home entry that may legally move to it.
+  while (free - home >= hopscotch_neighbourhood_size) {
+    size_t from = SIZE_MAX;
+    for (size_t h = free - (hopscotch_neighbourhood_size - 1); h < free && from == SIZE_MAX; ++h) {
+      const uint32_t hop = this->buckets_[h].hop_info;
+      if (hop != 0 && h + static_cast<size_t>(std::countr_zero(hop)) < free) {
+        from = h + static_cast<size_t>(std::countr_zero(hop));
+        HopscotchBucket &dst = this->buckets_[free];
+        dst.key = this->buckets_[from].key;
+        dst.value = this->buckets_[from].value;
+        dst.occupied = 1;
+        this->buckets_[h].hop_info = (hop & ~hop_bit(from - h)) | hop_bit(free - h);
+        this->buckets_[from].occupied = 0;
+      }
+    }
+    if (from == SIZE_MAX) {
+      return SIZE_MAX;
+    }
+    free = from;
+  }
+  return free;
+}
+
+ErrorType
+SequentialHopscotchHashTable::insert(KeyType key, ValueType value) {
+  LOG_TRACE("Enter");
+  const size_t home = get_home(this->hasher_(key), this->capacity_);
+  const size_t found = this->find_index(key, home);
+  if (found != SIZE_MAX) {
+    this->buckets_[found].value = value;
+    return ErrorType::ok;
+  }
+  const size_t index = this->make_room(home);
+  if (index == SIZE_MAX) {
+    LOG_DEBUG("no room near home {}, resizing", home);
+    [[maybe_unused]] ErrorType e = this->resize(2 * this->capacity_);
+    assert(e == ErrorType::ok && "error in resize");
+    return this->insert(key, value);
+  }
+  HopscotchBucket &bkt = this->buckets_[index];
+  bkt.key = key;
+  bkt.value = value;
+  bkt.occupied = 1;
+  this->buckets_[home].hop_info |= hop_bit(index - home);
+  ++this->length_;
+  return ErrorType::ok;
+}
+
+std::optional<ValueType>
+SequentialHopscotchHashTable::search(KeyType key) const {
+  LOG_TRACE("Enter");
+  const size_t home = get_home(this->hasher_(key), this->capacity_);
+  const size_t index = this->find_index(key, home);
+  if (index == SIZE_MAX) {
+    return std::nullopt;
+  }
+  return this->buckets_[index].value;
+}
+
+ErrorType
+SequentialHopscotchHashTable::remove(KeyType key) {
+  LOG_TRACE("Enter");
+  const size_t home = get_home(this->hasher_(key), this->capacity_);
+  const size_t index = this->find_index(key, home);
+  if (index == SIZE_MAX) {
+    return ErrorType::e_notfound;
+  }
+  this->buckets_[index].occupied = 0;
+  this->buckets_[home].hop_info &= ~hop_bit(index - home);
+  --this->length_;
+  return ErrorType::ok;
+}
+
+size_t
+SequentialHopscotchHashTable::size() const {
+  LOG_TRACE("Enter");
+  return this->length_;
+}
+
+TableStats
+SequentialHopscotchHashTable::stats() const {
+  LOG_TRACE("Enter");
+  return collect_hopscotch_stats(this->buckets_, this->capacity_,
+      sizeof(*this) + this->buckets_.capacity() * sizeof(HopscotchBucket));
+}
+
+ErrorType
+SequentialHopscotchHashTable::resize(size_t new_size) {
+  LOG_TRACE("Enter");
+  std::vector<HopscotchBucket> old_buckets(new_size + hopscotch_max_probe);
+  std::swap(old_buckets, this->buckets_);
+  this->capacity_ = new_size;
+  this->length_ = 0;
+  // N.B. This may resize again (recursively) if a neighbourhood overflows.
+  for (const auto &bkt : old_buckets) {
+    if (bkt.occupied) {
+      [[maybe_unused]] ErrorType e = this->insert(bkt.key, bkt.value);
+      assert(e == ErrorType::ok && "should not have error in insert");
+    }
+  }
+  return ErrorType::ok;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// PARALLEL HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+ParallelHopscotchHashTable::SegmentRange::SegmentRange(ParallelHopscotchHashTable &table,
+                                                       const size_t index)
+    : table_(table), first_(get_segment(index)), end_(get_segment(index)) {}
+
+ParallelHopscotchHashTable::SegmentRange::~SegmentRange() {
+  for (size_t s = this->first_; s < this->end_; ++s) {
+    this->table_.segments_[s].unlock();
+  }
+}
+
+void
+ParallelHopscotchHashTable::SegmentRange::extend_to(const size_t index) {
+  const size_t last = get_segment(index);
+  for (; this->end_ <= last; ++this->end_) {
+    this->table_.segments_[this->end_].lock();
+  }
+}
+
+ParallelHopscotchHashTable::ParallelHopscotchHashTable(const uint64_t hash_seed)
+    : hasher_(hash_seed) {}
+
+size_t
+ParallelHopscotchHashTable::get_segment(const size_t index) {
+  return index / segment_size;
+}
+
+size_t
+ParallelHopscotchHashTable::find_index_locked(KeyType key, const size_t home) const {
+  for (uint32_t hop = this->buckets_[home].hop_info; hop != 0; hop &= hop - 1) {
+    const size_t index = home + static_cast<size_t>(std::countr_zero(hop));
+    if (this->buckets_[index].key == key) {
+      return index;
+    }
+  }
+  return SIZE_MAX;
+}
+
+size_t
+ParallelHopscotchHashTable::make_room_locked(const size_t home, SegmentRange &range) {
+  LOG_TRACE("Enter");
+  size_t free = home;
+  const size_t end = home + hopscotch_max_probe;
+  for (; free < end; ++free) {
+    range.extend_to(free);
+    if (!this->buckets_[free].occupied) {
+      break;
+    }
+  }
+  if (free == end) {
+    return SIZE_MAX;
+  }
+  // Every bucket we touch from here on is in [home, free], which we hold.
+  while (free - home >= hopscotch_neighbourhood_size) {
+    size_t from = SIZE_MAX;
+    for (size_t h = free - (hopscotch_neighbourhood_size - 1); h < free && from == SIZE_MAX; ++h) {
+      const uint32_t hop = this->buckets_[h].hop_info;
+      if (hop != 0 && h + static_cast<size_t>(std::countr_zero(hop)) < free) {
+        from = h + static_cast<size_t>(std::countr_zero(hop));
+        HopscotchBucket &dst = this->buckets_[free];
+        store_field(dst.key, this->buckets_[from].key);
+        store_field(dst.value, this->buckets_[from].value);
+        store_field(dst.occupied, 1);
+        store_field(this->buckets_[h].hop_info, (hop & ~hop_bit(from - h)) | hop_bit(free - h));
+        store_field(this->buckets_[from].occupied, 0);
+      }
+    }
+    if (from == SIZE_MAX) {
+      return SIZE_MAX;
+    }
+    free = from;
+  }
+  return free;
+}
+
+ErrorType
+ParallelHopscotchHashTable::insert(KeyType key, ValueType value) {
+  LOG_TRACE("Enter");
+  const size_t home = get_home(this->hasher_(key), this->capacity_);
+  SegmentRange range(*this, home);
+  range.extend_to(home + hopscotch_neighbourhood_size - 1);
+  const size_t found = this->find_index_locked(key, home);
+  if (found != SIZE_MAX) {
+    store_field(this->buckets_[found].value, value);
+    return ErrorType::ok;
+  }
+  const size_t index = this->make_room_locked(home, range);
+  if (index == SIZE_MAX) {
+    return ErrorType::e_nohole;
+  }
+  HopscotchBucket &bkt = this->buckets_[index];
+  store_field(bkt.key, key);
+  store_field(bkt.value, value);
+  store_field(bkt.occupied, 1);
+  store_field(this->buckets_[home].hop_info, this->buckets_[home].hop_info | hop_bit(index - home));
+  this->length_.fetch_add(1, std::memory_order_relaxed);
+  return ErrorType::ok;
+}
+
+std::optional<ValueType>
+ParallelHopscotchHashTable::search(KeyType key) {
+  LOG_TRACE("Enter");
+  const size_t home = get_home(this->hasher_(key), this->capacity_);
+  const VersionedLock &first = this->segments_[get_segment(home)];
+  const VersionedLock &last = this->segments_[get_segment(home + hopscotch_neighbourhood_size - 1)];
+  while (true) {
+    const uint64_t first_version = first.read_begin();
+    const uint64_t last_version = last.read_begin();
+    std::optional<ValueType> result = std::nullopt;
+    for (uint32_t hop = load_field(this->buckets_[home].hop_info); hop != 0; hop &= hop - 1) {
+      const HopscotchBucket &bkt = this->buckets_[home + static_cast<size_t>(std::countr_zero(hop))];
+      if (load_field(bkt.occupied) && load_field(bkt.key) == key) {
+        result = load_field(bkt.value);
+        break;
+      }
+    }
+    if (!first.read_retry(first_version) && !last.read_retry(last_version)) {
+      return result;
+    }
+  }
+}
+
+ErrorType
+ParallelHopscotchHashTable::remove(KeyType key) {
+  LOG_TRACE("Enter");
+  const size_t home = get_home(this->hasher_(key), this->capacity_);
+  SegmentRange range(*this, home);
+  range.extend_to(home + hopscotch_neighbourhood_size - 1);
+  const size_t index = this->find_index_locked(key, home);
+  if (index == SIZE_MAX) {
+    return ErrorType::e_notfound;
+  }
+  store_field(this->buckets_[index].occupied, 0);
+  store_field(this->buckets_[home].hop_info, this->buckets_[home].hop_info & ~hop_bit(index - home));
+  this->length_.fetch_sub(1, std::memory_order_relaxed);
+  return ErrorType::ok;
+}
+
+size_t
+ParallelHopscotchHashTable::size() {
+  LOG_TRACE("Enter");
+  return this->length_.load(std::memory_order_relaxed);
+}
+
+TableStats
+ParallelHopscotchHashTable::stats() {
+  LOG_TRACE("Enter");
+  return collect_hopscotch_stats(this->buckets_, this->capacity_,
+      sizeof(*this) + this->buckets_.capacity() * sizeof(HopscotchBucket) +
+      this->segments_.capacity() * sizeof(VersionedLock));
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "common/engine.hpp"
+#include "common/logger.hpp"
+#include "common/stats.hpp"
+#include "common/status.hpp"
+#include "common/types.hpp"
+#include "utility/utility.hpp"
+#include "utility/versioned_lock.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// HELPER CLASSES
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Every entry lives within this many buckets of its home bucket.
+inline constexpr size_t hopscotch_neighbourhood_size = 32;
+/// @brief  How far past its home an insert looks for an empty bucket before it
+///         gives up (and the sequential table resizes).
+inline constexpr size_t hopscotch_max_probe = 512;
+
+/// @brief  Bucket for the hopscotch hash tables.
+///
+/// N.B.  The bucket array has hopscotch_max_probe extra buckets after the last
+///       home, so that a neighbourhood never wraps around.
+struct HopscotchBucket {
+  KeyType key = 0;
+  ValueType value = 0;
+  /// Bit i is set if bucket (this + i) holds an entry whose home is this one.
+  /// This belongs to the bucket's index, not to the entry stored in it.
+  uint32_t hop_info = 0;
+  uint32_t occupied = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// SEQUENTIAL HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  A hopscotch hash table: an entry is always within a fixed-size
+///         neighbourhood of its home, so a search reads at most one bitmap and
+///         the buckets it points to. An insert that finds an empty bucket too
+///         far away moves other entries (within their own neighbourhoods)
+///         towards it.
+class SequentialHopscotchHashTable {
+public:
+  static constexpr EngineCapabilities capabilities = {.thread_safe = false, .resizable = true, .batched = false};
+
+  /// @brief  Construct with a random hash seed.
+  SequentialHopscotchHashTable() = default;
+
+  /// @brief  Construct with a fixed hash seed (e.g. for reproducible layouts).
+  explicit SequentialHopscotchHashTable(const uint64_t hash_seed);
+
+  /// @brief Insert <key, value> pair, resizing if there is no room.
+  ///
+  /// @return 0 on good; 1 on failure
+  ErrorType
+  insert(KeyType key, ValueType value);
+
+  /// @brief Search for <key, value>.
+  std::optional<ValueType>
+  search(KeyType key) const;
+
+  /// @brief Remove <key, value> pair.
+  ///
+  /// @return 0 on found; 1 otherwise.
+  ErrorType
+  remove(KeyType key);
+
+  /// @brief  Get the number of entries.
+  size_t
+  size() const;
+
+  /// @brief  Summarize the table's shape (see TableStats).
+  TableStats
+  stats() const;
+
+private:
+  std::vector<HopscotchBucket> buckets_ = std::vector<HopscotchBucket>((1<<20) + hopscotch_max_probe);
+  size_t length_ = 0;
+  size_t capacity_ = 1<<20;
+  DefaultHash hasher_{random_hash_seed()};
+
+  /// @brief  Get the index of key's bucket, or SIZE_MAX if it is absent.
+  size_t
+  find_index(KeyType key, const size_t home) const;
+
+  /// @brief  Find an empty bucket within home's neighbourhood, moving entries
+  ///         closer to their homes if necessary.
+  ///
+  /// @return its index, or SIZE_MAX if there is none.
+  size_t
+  make_room(const size_t home);
+
+  ErrorType
+  resize(size_t new_size);
+};
+
+static_assert(HashTableEngine<SequentialHopscotchHashTable>);
+
+////////////////////////////////////////////////////////////////////////////////
+/// PARALLEL HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  A concurrent hopscotch hash table with a fixed capacity.
+///
+/// The buckets are split into segments, each with a VersionedLock. A writer
+/// locks the segments it touches in increasing order: those covering its
+/// home's neighbourhood and then, as it probes for an empty bucket, the ones
+/// after. Every bucket that displacement touches lies between the home and the
+/// empty bucket, so it is already locked. Searches take no locks; they read
+/// the home's neighbourhood and retry if a writer held either of the (at most
+/// two) segments that cover it.
+class ParallelHopscotchHashTable {
+public:
+  static constexpr EngineCapabilities capabilities = {.thread_safe = true, .resizable = false, .batched = false};
+
+  /// @brief  Construct with a random hash seed.
+  ParallelHopscotchHashTable() = default;
+
+  /// @brief  Construct with a fixed hash seed (e.g. for reproducible layouts).
+  explicit ParallelHopscotchHashTable(const uint64_t hash_seed);
+
+  /// @brief Insert <key, value> pair.
+  ///
+  /// @return 0 on good; e_nohole if there is no room near key's home.
+  ErrorType
+  insert(KeyType key, ValueType value);
+
+  /// @brief Search for <key, value>.
+  std::optional<ValueType>
+  search(KeyType key);
+
+  /// @brief Remove <key, value> pair.
+  ///
+  /// @return 0 on found; 1 otherwise.
+  ErrorType
+  remove(KeyType key);
+
+  /// @brief  Get the number of entries.
+  size_t
+  size();
+
+  /// @brief  Summarize the table's shape (see TableStats).
+  ///
+  /// N.B.  This is not synchronized with the writers, so it is only exact
+  ///       when the table is quiescent.
+  TableStats
+  stats();
+
+private:
+  /// A neighbourhood spans at most two segments.
+  static constexpr size_t segment_size = 64;
+  static_assert(segment_size >= hopscotch_neighbourhood_size);
+
+  /// @brief  The segments an operation has locked, always a contiguous range
+  ///         that grows upwards. Unlocks them when destroyed.
+  class SegmentRange {
+  public:
+    SegmentRange(ParallelHopscotchHashTable &table, const size_t index);
+    ~SegmentRange();
+
+    SegmentRange(const SegmentRange &) = delete;
+    SegmentRange &operator=(const SegmentRange &) = delete;
+
+    /// @brief  Lock every segment up to and including the one with index.
+    void
+    extend_to(const size_t index);
+
+  private:
+    ParallelHopscotchHashTable &table_;
+    size_t first_;
+    size_t end_;
+  };
+
+  std::vector<HopscotchBucket> buckets_ = std::vector<HopscotchBucket>((1<<20) + hopscotch_max_probe);
+  std::vector<VersionedLock> segments_ =
+      std::vector<VersionedLock>(((1<<20) + hopscotch_max_probe) / segment_size);
+  std::atomic<size_t> length_ = 0;
+  size_t capacity_ = 1<<20;
+  DefaultHash hasher_{random_hash_seed()};
+
+  static size_t
+  get_segment(const size_t index);
+
+  /// @brief  Get the index of key's bucket, or SIZE_MAX if it is absent. The
+  ///         caller must hold the neighbourhood's segments.
+  size_t
+  find_index_locked(KeyType key, const size_t home) const;
+
+  /// @brief  As SequentialHopscotchHashTable::make_room(), extending range to
+  ///         cover every bucket it probes.
+  size_t
+  make_room_locked(const size_t home, SegmentRange &range);
+};
+
+static_assert(HashTableEngine<ParallelHopscotchHashTable>);
@@ -0,0 +1,65 @@
+#include <iostream>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "hopscotch/hopscotch.hpp"
+
+
+template<typename HashTable>
+void
+run_sanity_check(HashTable &a) {
+  // Insert
+  for (KeyType i = 0; i < 10; ++i) {
+    ErrorType e = a.insert(i, i);
+    std::cout << "Insert (" << static_cast<int>(e) << "): <" << i << ", " << i << ">\n";
+  }
+
+  // Search
+  for (KeyType i = 0; i < 11; ++i) {
+    std::optional<ValueType> value = a.search(i);
+    if (value.has_value()) {
+      std::cout << "Lookup (" << value.has_value() << ") " << i << ": " << value.value() << "\n";
+    } else {
+      std::cout << "Lookup (" << value.has_value() << ") " << i << ": ?\n";
+    }
+  }
+
+  // Remove
+  for (KeyType i = 0; i < 11; ++i) {
+    ErrorType e = a.remove(i);
+    std::cout << "Remove (" << static_cast<int>(e) << "): " << i << "\n";
+  }
+  std::cout << "Size: " << a.size() << "\n";
+}
+
+int main() {
+  LOG_TRACE("Enter");
+  std::cout << "=== Sequential ===\n";
+  SequentialHopscotchHashTable a;
+  run_sanity_check(a);
+  // Fill well past the initial capacity to force a resize.
+  for (KeyType i = 0; i < 2000000; ++i) {
+    a.insert(i, i);
+  }
+  a.stats().print(std::cout);
+
+  std::cout << "=== Parallel ===\n";
+  ParallelHopscotchHashTable b;
+  run_sanity_check(b);
+  // Insert disjoint ranges from 4 threads.
+  std::vector<std::thread> threads;
+  for (KeyType t = 0; t < 4; ++t) {
+    threads.emplace_back([&b, t]() {
+      for (KeyType i = t * 100000; i < (t + 1) * 100000; ++i) {
+        b.insert(i, i);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  std::cout << "Size after 4 threads inserted 100000 keys each: " << b.size() << "\n";
+  b.stats().print(std::cout);
+  return 0;
+}
@@ -9,9 +9,13 @@
 #include <tuple>
 #include <vector>
 
+#include "common/engine.hpp"
 #include "common/logger.hpp"
+#include "common/stats.hpp"
 #include "common/status.hpp"
 #include "common/types.hpp"
+#include "utility/function_ref.hpp"
+#include "utility/parallel_for.hpp"
 #include "utility/utility.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -54,7 +58,48 @@ class NaiveParallelRobinHoodHashTable {
   std::mutex meta_mutex_;
   size_t length_ = 0;
   size_t capacity_ = 1<<20;
+  DefaultHash hasher_{random_hash_seed()};
+  [[no_unique_address]] TableCounters counters_;
 public:
+  static constexpr EngineCapabilities capabilities = {.thread_safe = true, .resizable = false, .batched = false};
+
+  /// @brief  Cursor over the (key, value) pairs.
+  ///
+  /// N.B.  This locks one bucket at a time, so it may run alongside writers,
+  ///       but an entry that a concurrent insert or remove shifts across the
+  ///       cursor may be missed or seen twice.
+  class Cursor {
+  public:
+    explicit Cursor(NaiveParallelRobinHoodHashTable &table) : table_(table) {}
+
+    /// @brief  Advance to the next pair.
+    ///
+    /// @return false once every bucket has been visited.
+    bool
+    next(KeyType &key, ValueType &value)
+    {
+      while (this->index_ < this->table_.capacity_) {
+        const NaiveParallelBucket bkt = this->table_.copy_bucket(this->index_++);
+        if (!bkt.is_empty()) {
+          key = bkt.key;
+          value = bkt.value;
+          return true;
+        }
+      }
+      return false;
+    }
+
+  private:
+    NaiveParallelRobinHoodHashTable &table_;
+    size_t index_ = 0;
+  };
+
+  /// @brief  Construct with a random hash seed.
+  NaiveParallelRobinHoodHashTable() = default;
+
+  /// @brief  Construct with a fixed hash seed (e.g. for reproducible layouts).
+  explicit NaiveParallelRobinHoodHashTable(const uint64_t hash_seed);
+
   void
   print();
 
@@ -62,8 +107,7 @@ public:
   get_wouldbe_offset(
     const KeyType key,
     const HashCodeType hashcode,
-    const size_t home,
-    const std::vector<size_t> &locked_buckets
+    const size_t home
   );
 
   /// @brief Insert <key, value> pair.
@@ -86,10 +130,136 @@ public:
   ErrorType
   remove(KeyType key);
 
+  /// @brief  If key is present, replace its value with update(value);
+  ///         otherwise, insert <key, value>. This walks the probe path once.
+  ///
+  /// @return the value now stored for key.
+  /// N.B.  update runs with the bucket's lock held, so it must not use the table.
+  template<typename Fn>
+  ValueType
+  upsert(KeyType key, ValueType value, Fn &&update)
+  {
+    ValueType result = value;
+    this->visit(key,
+        [&update, &result](ValueType &v) { v = update(v); result = v; return MatchAction::keep; },
+        [value]() -> std::optional<ValueType> { return value; });
+    return result;
+  }
+
+  /// @brief  Add delta to key's value, inserting <key, delta> if it is absent.
+  ///
+  /// @return the previous value (or 0 if key was absent).
+  ValueType
+  fetch_add(KeyType key, ValueType delta);
+
+  /// @brief  If key's value equals expected, replace it with desired.
+  ///         Otherwise, load the current value into expected.
+  ///
+  /// @return whether the value was replaced (false if key is absent).
+  bool
+  compare_exchange(KeyType key, ValueType &expected, ValueType desired);
+
+  /// @brief  Return key's value, inserting <key, fn()> if it is absent.
+  /// N.B.  fn runs with the bucket's lock held, so it must not use the table.
+  template<typename Fn>
+  ValueType
+  compute_if_absent(KeyType key, Fn &&fn)
+  {
+    ValueType result = 0;
+    this->visit(key,
+        [&result](ValueType &v) { result = v; return MatchAction::keep; },
+        [&fn, &result]() -> std::optional<ValueType> { result = fn(); return result; });
+    return result;
+  }
+
+  /// @brief  Remove key if pred(value) is true.
+  /// N.B.  pred runs with the bucket's lock held, so it must not use the table.
+  ///
+  /// @return 0 if removed; 1 otherwise.
+  template<typename Pred>
+  ErrorType
+  erase_if(KeyType key, Pred &&pred)
+  {
+    bool erased = false;
+    this->visit(key,
+        [&pred, &erased](ValueType &v) {
+          erased = pred(static_cast<const ValueType &>(v));
+          return erased ? MatchAction::erase : MatchAction::keep;
+        },
+        []() -> std::optional<ValueType> { return std::nullopt; });
+    return erased ? ErrorType::ok : ErrorType::e_notfound;
+  }
+
   std::vector<ValueType>
   getElements();
 
+  /// @brief  Summarize the table's shape (see TableStats). Unlike print(),
+  ///         this is safe to call while other threads use the table.
+  TableStats
+  stats();
+
+  /// @brief  Get the number of entries.
+  size_t
+  size();
+
+  /// @brief  Get the index of key's home bucket (e.g. to pick keys that
+  ///         collide, for a stress test). The capacity is fixed, so this is
+  ///         stable.
+  size_t
+  home_of(KeyType key) const;
+
+  Cursor
+  cursor()
+  {
+    return Cursor(*this);
+  }
+
+  /// @brief  Call fn(key, value) on every pair, with the same consistency as
+  ///         Cursor. No lock is held while fn runs.
+  template<typename Fn>
+  void
+  for_each(Fn &&fn)
+  {
+    this->for_each_in_range(0, this->capacity_, fn);
+  }
+
+  /// @brief  Call fn(key, value) on every pair, splitting the bucket array
+  ///         into num_threads ranges. fn must be safe to call concurrently.
+  template<typename Fn>
+  void
+  parallel_for_each(Fn &&fn, const size_t num_threads)
+  {
+    parallel_for_ranges(this->capacity_, num_threads, [this, &fn](const size_t begin, const size_t end) {
+      this->for_each_in_range(begin, end, fn);
+    });
+  }
+
 private:
+  /// @brief  Find key in a single pass over its probe path. If it is present,
+  ///         call on_match(value) with its bucket locked; on_match may modify
+  ///         value in place or ask for the entry to be erased. Otherwise, call
+  ///         on_miss() and, if it returns a value, insert it before the probe
+  ///         path's locks are released.
+  ///
+  /// @return whether key was present.
+  bool
+  visit(KeyType key,
+        FunctionRef<MatchAction(ValueType &)> on_match,
+        FunctionRef<std::optional<ValueType>()> on_miss);
+
+  /// @brief  Finish inserting tmp, whose probe returned (status, offset) with
+  ///         the bucket at that offset locked.
+  ErrorType
+  insert_locked(NaiveParallelBucket tmp,
+                size_t home,
+                SearchStatus status,
+                OffsetType offset);
+
+  /// @brief  Remove the entry at (home, offset), whose bucket is locked, by
+  ///         shifting its successors back.
+  void
+  erase_locked(const size_t home, const OffsetType offset);
+
   __attribute__((always_inline)) NaiveParallelBucket &
   get_bucket(const size_t index)
   {
@@ -97,11 +267,40 @@ private:
     return std::get<0>(r);
   }
 
+  /// @brief  Copy a bucket under its lock (bypassing the counters).
+  NaiveParallelBucket
+  copy_bucket(const size_t index)
+  {
+    std::lock_guard<std::mutex> lock(std::get<1>(this->buckets_[index]));
+    return this->get_bucket(index);
+  }
+
+  template<typename Fn>
+  void
+  for_each_in_range(const size_t begin, const size_t end, Fn &fn)
+  {
+    for (size_t i = begin; i < end; ++i) {
+      const NaiveParallelBucket bkt = this->copy_bucket(i);
+      if (!bkt.is_empty()) {
+        fn(bkt.key, bkt.value);
+      }
+    }
+  }
+
   __attribute__((always_inline)) void
   lock_index(const size_t index)
   {
     std::tuple<NaiveParallelBucket, std::mutex> &r = this->buckets_[index];
-    std::get<1>(r).lock();
+    std::mutex &mutex = std::get<1>(r);
+    if constexpr (table_counters_enabled) {
+      if (!mutex.try_lock()) {
+        this->counters_.add_contended_lock();
+        mutex.lock();
+      }
+      this->counters_.add_lock_acquisition();
+    } else {
+      mutex.lock();
+    }
   }
 
   __attribute__((always_inline)) void
@@ -112,3 +311,4 @@ private:
   }
 };
 
+static_assert(HashTableEngine<NaiveParallelRobinHoodHashTable>);
@@ -1,5 +1,8 @@
+#include <atomic>
 #include <iostream>
 #include <optional>
+#include <thread>
+#include <vector>
 
 #include "naive_parallel/naive_parallel.hpp"
 
@@ -23,6 +26,44 @@ int main() {
     }
   }
 
+  // Read-modify-write
+  std::cout << "Fetch-add (" << a.fetch_add(10, 5) << "): 10 += 5\n";
+  ValueType expected = 5;
+  bool exchanged = a.compare_exchange(10, expected, 7);
+  std::cout << "Compare-exchange (" << exchanged << "): 10: 5 -> 7\n";
+  std::cout << "Compute-if-absent: 11: " << a.compute_if_absent(11, []() { return ValueType{11}; }) << "\n";
+  std::cout << "Upsert: 11: " << a.upsert(11, 0, [](ValueType v) { return v * 2; }) << "\n";
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&a]() {
+      for (size_t i = 0; i < 1000; ++i) {
+        a.fetch_add(11, 1);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::cout << "Concurrent fetch-add: 11: " << a.search(11).value() << "\n";
+  a.upsert(11, 0, [](ValueType) { return ValueType{22}; });
+  std::cout << "Erase-if (" << static_cast<int>(a.erase_if(11, [](ValueType v) { return v == 22; })) << "): 11\n";
+
+  // Iterate
+  std::atomic<size_t> num_visited = 0;
+  a.parallel_for_each([&num_visited](const KeyType, const ValueType) {
+    num_visited.fetch_add(1, std::memory_order_relaxed);
+  }, 4);
+  std::cout << "Visited " << num_visited.load() << " pairs with 4 threads\n";
+  auto cursor = a.cursor();
+  KeyType key = 0;
+  ValueType value = 0;
+  while (cursor.next(key, value)) {
+    std::cout << "Cursor: <" << key << ", " << value << ">\n";
+  }
+
+  // Statistics
+  a.stats().print(std::cout);
+
   // Remove
   for (uint64_t i = 0; i < 11; ++i) {
     ErrorType e = a.remove(i);
@@ -57,6 +57,9 @@ get_real_index(const size_t home, const size_t offset, const size_t capacity) {
 /// HASH TABLE CLASS
 ////////////////////////////////////////////////////////////////////////////////
 
+NaiveParallelRobinHoodHashTable::NaiveParallelRobinHoodHashTable(const uint64_t hash_seed)
+    : hasher_(hash_seed) {}
+
 /// NOTE: NOT THREAD SAFE!!!
 void
 NaiveParallelRobinHoodHashTable::print() {
@@ -72,22 +75,55 @@ NaiveParallelRobinHoodHashTable::print() {
 }
 
 
-#define UNLOCK_ALL(vec) for (auto idx : vec) { this->unlock_index(idx); }
+TableStats
+NaiveParallelRobinHoodHashTable::stats() {
+  LOG_TRACE("Enter");
+  TableStatsCollector collector(this->capacity_);
+  for (size_t i = 0; i < this->capacity_; ++i) {
+    // NOTE We bypass lock_index() so that taking stats is not itself counted.
+    std::lock_guard<std::mutex> lock(std::get<1>(this->buckets_[i]));
+    const NaiveParallelBucket &bkt = this->get_bucket(i);
+    collector.visit(!bkt.is_empty(), bkt.offset);
+  }
+  TableStats s = collector.finish(sizeof(*this) + this->buckets_.capacity() * sizeof(std::tuple<NaiveParallelBucket, std::mutex>));
+  this->counters_.snapshot(s);
+  return s;
+}
+
+size_t
+NaiveParallelRobinHoodHashTable::size() {
+  LOG_TRACE("Enter");
+  std::lock_guard<std::mutex> lock(this->meta_mutex_);
+  return this->length_;
+}
+
+size_t
+NaiveParallelRobinHoodHashTable::home_of(KeyType key) const {
+  return get_home(this->hasher_(key), this->capacity_);
+}
+
+std::vector<ValueType>
+NaiveParallelRobinHoodHashTable::getElements() {
+  LOG_TRACE("Enter");
+  std::vector<ValueType> values;
+  this->for_each([&values](const KeyType, const ValueType value) {
+    values.push_back(value);
+  });
+  return values;
+}
+
 
 std::pair<SearchStatus, OffsetType>
 NaiveParallelRobinHoodHashTable::get_wouldbe_offset(
   const KeyType key,
   const HashCodeType hashcode,
-  const size_t home,
-  const std::vector<size_t> &locked_buckets
+  const size_t home
 ) {
   LOG_TRACE("Enter");
   size_t capacity = this->buckets_.size();
+  this->lock_index(home);
   for (OffsetType i = 0; i < capacity; ++i) {
     size_t real_index = get_real_index(home, i, capacity);
-    if (std::find(locked_buckets.begin(), locked_buckets.end(), real_index) == locked_buckets.end()) {
-      this->lock_index(real_index);
-    }
     const NaiveParallelBucket &bkt = this->get_bucket(real_index);
     // If not found
     if (bkt.is_empty()) {
@@ -99,6 +135,15 @@ NaiveParallelRobinHoodHashTable::get_wouldbe_offset(
     } else if (bkt.equal_by_key(key, hashcode)) {
       return {SearchStatus::found_match, i};
     }
+    if (i + 1 == capacity) {
+      this->unlock_index(real_index);
+      break;
+    }
+    // Lock the next bucket before letting go of this one. erase_locked()
+    // shifts entries back one bucket at a time in the same way, so it can
+    // never move an entry from the next bucket into this one behind our back
+    // (and we would walk past it).
+    this->lock_index(get_real_index(home, i + 1, capacity));
     this->unlock_index(real_index);
   }
   // If no hole found, then we hold no locks!
@@ -114,69 +159,76 @@ NaiveParallelRobinHoodHashTable::insert(KeyType key, ValueType value) {
   // 3.   If not, check if room to insert
   // 4.     If not, resize
   // 5. Insert (with swapping if necessary)
-  HashCodeType hashcode = hash(key);
-  std::vector<size_t> locked_buckets;
+  HashCodeType hashcode = this->hasher_(key);
+  size_t home = get_home(hashcode, this->capacity_);
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
   NaiveParallelBucket tmp = {.key = key,
                           .value = value,
                           .hashcode = hashcode,
                           .offset = /*arbitrary value*/0,};
+  return this->insert_locked(tmp, home, status, offset);
+}
+
+ErrorType
+NaiveParallelRobinHoodHashTable::insert_locked(NaiveParallelBucket tmp,
+                                               size_t home,
+                                               SearchStatus status,
+                                               OffsetType offset) {
+  LOG_TRACE("Enter");
   const size_t capacity = this->buckets_.size();
-  // This could also be upper-bounded by the number of valid elements (num_elem)
-  // in this->buckets_. This is because you need to bump at most num_elem elements
-  // (if they are all sitting in a row) to insert something.
+  size_t real_index = get_real_index(home, offset, capacity);
+  switch (status) {
+    case SearchStatus::found_match: {
+      LOG_TRACE("SearchStatus::found_match");
+      NaiveParallelBucket &bkt = this->get_bucket(real_index);
+      bkt.value = tmp.value;
+      this->unlock_index(real_index);
+      return ErrorType::ok;
+    }
+    case SearchStatus::found_swap:
+    case SearchStatus::found_hole:
+      break;
+    case SearchStatus::found_nohole:
+      assert(0 && "should not call this function if we need to resize!");
+    default:
+      assert(0 && "impossible!");
+  }
+
+  // Carry the entry forwards, swapping it with any entry nearer its home,
+  // until a hole takes it. We keep every bucket we pass locked, so the locks
+  // we hold are always the run [first_locked, real_index] and need no list.
+  const size_t first_locked = real_index;
+  size_t num_locked = 1;
+  tmp.offset = offset;
   while (true) {
-    size_t home = get_home(tmp.hashcode, capacity);
-    const auto [status, offset] = this->get_wouldbe_offset(tmp.key, tmp.hashcode, home, locked_buckets);
-    switch (status) {
-      case SearchStatus::found_match: {
-        LOG_DEBUG("SearchStatus::found_match");
-        size_t real_index = get_real_index(home, offset, capacity);
-        NaiveParallelBucket &bkt = this->get_bucket(real_index);
-        bkt.value = tmp.value;
-        this->unlock_index(real_index);
-        UNLOCK_ALL(locked_buckets);
-        return ErrorType::ok;
-      }
-      case SearchStatus::found_swap: {
-        LOG_DEBUG("SearchStatus::found_swap");
-        // NOTE(dchu): could be buggy
-        size_t real_index = get_real_index(home, offset, capacity);
-        NaiveParallelBucket &bkt = this->get_bucket(real_index);
-        tmp.offset = offset;
-        std::swap(bkt, tmp);
-        locked_buckets.push_back(real_index);
-        continue;
-      }
-      case SearchStatus::found_hole: {
-        LOG_DEBUG("SearchStatus::found_hole");
-        // NOTE(dchu): could be buggy
-        size_t real_index = get_real_index(home, offset, capacity);
-        NaiveParallelBucket &bkt = this->get_bucket(real_index);
-        tmp.offset = offset;
-        std::swap(bkt, tmp);
-        this->unlock_index(real_index);
-        this->meta_mutex_.lock();
-        ++this->length_;
-        this->meta_mutex_.unlock();
-        UNLOCK_ALL(locked_buckets);
-        return ErrorType::ok;
-      }
-      case SearchStatus::found_nohole:
-        assert(0 && "should not call this function if we need to resize!");
-      default:
-        assert(0 && "impossible!");
+    NaiveParallelBucket &bkt = this->get_bucket(real_index);
+    if (bkt.is_empty()) {
+      bkt = tmp;
+      break;
+    } else if (bkt.offset < tmp.offset) {
+      std::swap(bkt, tmp);
     }
+    real_index = get_real_index(real_index, 1, capacity);
+    ++tmp.offset;
+    this->lock_index(real_index);
+    ++num_locked;
+  }
+  this->meta_mutex_.lock();
+  ++this->length_;
+  this->meta_mutex_.unlock();
+  for (size_t i = 0; i < num_locked; ++i) {
+    this->unlock_index(get_real_index(first_locked, i, capacity));
   }
-  assert(0 && "impossible!");
+  return ErrorType::ok;
 }
 
 std::optional<ValueType>
 NaiveParallelRobinHoodHashTable::search(KeyType key) {
   LOG_TRACE("Enter");
-  HashCodeType hashcode = hash(key);
+  HashCodeType hashcode = this->hasher_(key);
   size_t home = get_home(hashcode, this->capacity_);
 
-  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home, {});
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
   switch (status) {
     case SearchStatus::found_match: {
       size_t real_index = get_real_index(home, offset, this->capacity_);
@@ -202,38 +254,14 @@ NaiveParallelRobinHoodHashTable::search(KeyType key) {
 ErrorType
 NaiveParallelRobinHoodHashTable::remove(KeyType key) {
   LOG_TRACE("Enter");
-  HashCodeType hashcode = hash(key);
+  HashCodeType hashcode = this->hasher_(key);
   size_t home = get_home(hashcode, this->capacity_);
 
-  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home, {});
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
   switch (status) {
-    case SearchStatus::found_match: {
-      for (size_t i = 0; i < this->capacity_; ++i) {
-        // NOTE(dchu): real_index is the previous iteration's next_real_index
-        size_t real_index = get_real_index(home, offset + i, this->capacity_);
-        NaiveParallelBucket &bkt = this->get_bucket(real_index);
-        size_t next_real_index = get_real_index(home, offset + i + 1, this->capacity_);
-        NaiveParallelBucket &next_bkt = this->get_bucket(next_real_index);
-        this->lock_index(next_real_index);
-        // Next element is empty or already in its home bucket
-        if (next_bkt.is_empty() || next_bkt.offset == 0) {
-          bkt.invalidate();
-          this->unlock_index(real_index);
-          this->unlock_index(next_real_index);
-          this->meta_mutex_.lock();
-          --this->length_;
-          this->meta_mutex_.unlock();
-          return ErrorType::ok;
-        }
-        // I argue that this sliding is efficient if the average home has only a
-        // single element belonging to it. In this case, it would not have any
-        // elements belonging to the same home, over which it may leap-frog.
-        bkt = std::move(next_bkt);
-        --bkt.offset;
-        this->unlock_index(real_index);
-      }
-      assert(0 && "impossible! Should have a hole");
-    }
+    case SearchStatus::found_match:
+      this->erase_locked(home, offset);
+      return ErrorType::ok;
     // Not found
     case SearchStatus::found_hole:
     case SearchStatus::found_swap: {
@@ -249,3 +277,104 @@ NaiveParallelRobinHoodHashTable::remove(KeyType key) {
   assert(0 && "unreachable");
 }
 
+void
+NaiveParallelRobinHoodHashTable::erase_locked(const size_t home, const OffsetType offset) {
+  LOG_TRACE("Enter");
+  for (size_t i = 0; i < this->capacity_; ++i) {
+    // NOTE(dchu): real_index is the previous iteration's next_real_index
+    size_t real_index = get_real_index(home, offset + i, this->capacity_);
+    NaiveParallelBucket &bkt = this->get_bucket(real_index);
+    size_t next_real_index = get_real_index(home, offset + i + 1, this->capacity_);
+    NaiveParallelBucket &next_bkt = this->get_bucket(next_real_index);
+    this->lock_index(next_real_index);
+    // Next element is empty or already in its home bucket
+    if (next_bkt.is_empty() || next_bkt.offset == 0) {
+      bkt.invalidate();
+      this->unlock_index(real_index);
+      this->unlock_index(next_real_index);
+      this->meta_mutex_.lock();
+      --this->length_;
+      this->meta_mutex_.unlock();
+      return;
+    }
+    // I argue that this sliding is efficient if the average home has only a
+    // single element belonging to it. In this case, it would not have any
+    // elements belonging to the same home, over which it may leap-frog.
+    bkt = std::move(next_bkt);
+    --bkt.offset;
+    this->unlock_index(real_index);
+  }
+  assert(0 && "impossible! Should have a hole");
+}
+
+bool
+NaiveParallelRobinHoodHashTable::visit(KeyType key,
+                                       FunctionRef<MatchAction(ValueType &)> on_match,
+                                       FunctionRef<std::optional<ValueType>()> on_miss) {
+  LOG_TRACE("Enter");
+  HashCodeType hashcode = this->hasher_(key);
+  size_t home = get_home(hashcode, this->capacity_);
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
+  switch (status) {
+    case SearchStatus::found_match: {
+      size_t real_index = get_real_index(home, offset, this->capacity_);
+      if (on_match(this->get_bucket(real_index).value) == MatchAction::erase) {
+        this->erase_locked(home, offset);
+      } else {
+        this->unlock_index(real_index);
+      }
+      return true;
+    }
+    case SearchStatus::found_hole:
+    case SearchStatus::found_swap: {
+      const std::optional<ValueType> value = on_miss();
+      if (!value.has_value()) {
+        this->unlock_index(get_real_index(home, offset, this->capacity_));
+        return false;
+      }
+      // We still hold the lock on the bucket we stopped at, and the walk
+      // coupled its locks to get here, so key cannot be behind us and nobody
+      // can insert it in between.
+      NaiveParallelBucket tmp = {.key = key,
+                          .value = value.value(),
+                          .hashcode = hashcode,
+                          .offset = /*arbitrary value*/0,};
+      [[maybe_unused]] ErrorType e = this->insert_locked(tmp, home, status, offset);
+      assert(e == ErrorType::ok && "error in insert_locked");
+      return false;
+    }
+    case SearchStatus::found_nohole:
+      assert(0 && "should not call this function if we need to resize!");
+    default:
+      assert(0 && "impossible");
+  }
+  assert(0 && "unreachable");
+}
+
+ValueType
+NaiveParallelRobinHoodHashTable::fetch_add(KeyType key, ValueType delta) {
+  LOG_TRACE("Enter");
+  ValueType old = 0;
+  this->visit(key,
+      [&old, delta](ValueType &value) { old = value; value += delta; return MatchAction::keep; },
+      [delta]() -> std::optional<ValueType> { return delta; });
+  return old;
+}
+
+bool
+NaiveParallelRobinHoodHashTable::compare_exchange(KeyType key, ValueType &expected, ValueType desired) {
+  LOG_TRACE("Enter");
+  bool exchanged = false;
+  this->visit(key,
+      [&expected, desired, &exchanged](ValueType &value) {
+        if (value == expected) {
+          value = desired;
+          exchanged = true;
+        } else {
+          expected = value;
+        }
+        return MatchAction::keep;
+      },
+      []() -> std::optional<ValueType> { return std::nullopt; });
+  return exchanged;
+}
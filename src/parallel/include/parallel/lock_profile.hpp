@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// LOCK-CONTENTION PROFILING
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Whether ParallelRobinHoodHashTable profiles its bucket locks. Set
+///         with the MM_PARALLEL_LOCK_PROFILING CMake option.
+#if defined(MM_PARALLEL_LOCK_PROFILING)
+inline constexpr bool lock_profiling_enabled = true;
+#else
+inline constexpr bool lock_profiling_enabled = false;
+#endif
+
+/// @brief  Lock statistics of one region of consecutive buckets.
+struct LockProfileRegion {
+  uint64_t acquisitions = 0;
+  /// Acquisitions where try_lock failed and we had to block.
+  uint64_t contended = 0;
+  /// Total time spent blocked in those contended acquisitions.
+  uint64_t wait_ns = 0;
+  /// Operations whose home bucket is in this region (i.e. key hotness).
+  uint64_t home_hits = 0;
+};
+
+/// @brief  A snapshot of the lock profile, i.e. a heat map over bucket index.
+struct LockProfile {
+  bool enabled = false;
+  size_t region_size = 0;
+  std::vector<LockProfileRegion> regions = {};
+
+  /// @brief  Pearson correlation across regions of the home hits (hotness)
+  ///         with the given metric. Returns 0 if either is constant.
+  double
+  correlation_with_hotness(uint64_t LockProfileRegion::*metric) const
+  {
+    const double n = static_cast<double>(this->regions.size());
+    if (this->regions.empty()) {
+      return 0.0;
+    }
+    double mean_x = 0.0, mean_y = 0.0;
+    for (const auto &r : this->regions) {
+      mean_x += static_cast<double>(r.home_hits);
+      mean_y += static_cast<double>(r.*metric);
+    }
+    mean_x /= n;
+    mean_y /= n;
+    double cov = 0.0, var_x = 0.0, var_y = 0.0;
+    for (const auto &r : this->regions) {
+      const double dx = static_cast<double>(r.home_hits) - mean_x;
+      const double dy = static_cast<double>(r.*metric) - mean_y;
+      cov += dx * dy;
+      var_x += dx * dx;
+      var_y += dy * dy;
+    }
+    if (var_x == 0.0 || var_y == 0.0) {
+      return 0.0;
+    }
+    return cov / std::sqrt(var_x * var_y);
+  }
+};
+
+/// @brief  Per-region relaxed-atomic lock counters.
+///
+/// N.B.  Regions are cache-line aligned so that counting in one region does not
+///       false-share with its neighbours. Without MM_PARALLEL_LOCK_PROFILING,
+///       this holds no storage and every method is a no-op.
+class LockProfiler {
+public:
+  static constexpr size_t region_size = 256;
+
+  explicit LockProfiler(const size_t capacity)
+#if defined(MM_PARALLEL_LOCK_PROFILING)
+      : regions_((capacity + region_size - 1) / region_size)
+#endif
+  {
+    (void)capacity;
+  }
+
+  /// @brief  Block on a mutex whose try_lock already failed, timing the wait.
+  void
+  lock_contended(std::mutex &mutex, const size_t index)
+  {
+#if defined(MM_PARALLEL_LOCK_PROFILING)
+    const auto start = std::chrono::steady_clock::now();
+    mutex.lock();
+    const auto wait = std::chrono::steady_clock::now() - start;
+    AtomicRegion &r = this->regions_[index / region_size];
+    r.contended.fetch_add(1, std::memory_order_relaxed);
+    r.wait_ns.fetch_add(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count()), std::memory_order_relaxed);
+#else
+    (void)index;
+    mutex.lock();
+#endif
+  }
+
+  void
+  record_acquisition(const size_t index)
+  {
+#if defined(MM_PARALLEL_LOCK_PROFILING)
+    this->regions_[index / region_size].acquisitions.fetch_add(1, std::memory_order_relaxed);
+#else
+    (void)index;
+#endif
+  }
+
+  void
+  record_home(const size_t home)
+  {
+#if defined(MM_PARALLEL_LOCK_PROFILING)
+    this->regions_[home / region_size].home_hits.fetch_add(1, std::memory_order_relaxed);
+#else
+    (void)home;
+#endif
+  }
+
+  LockProfile
+  snapshot() const
+  {
+    LockProfile p;
+    p.enabled = lock_profiling_enabled;
+#if defined(MM_PARALLEL_LOCK_PROFILING)
+    p.region_size = region_size;
+    for (const auto &r : this->regions_) {
+      p.regions.push_back({r.acquisitions.load(std::memory_order_relaxed),
+                           r.contended.load(std::memory_order_relaxed),
+                           r.wait_ns.load(std::memory_order_relaxed),
+                           r.home_hits.load(std::memory_order_relaxed)});
+    }
+#endif
+    return p;
+  }
+
+#if defined(MM_PARALLEL_LOCK_PROFILING)
+private:
+  struct alignas(64) AtomicRegion {
+    std::atomic<uint64_t> acquisitions = 0;
+    std::atomic<uint64_t> contended = 0;
+    std::atomic<uint64_t> wait_ns = 0;
+    std::atomic<uint64_t> home_hits = 0;
+  };
+
+  std::vector<AtomicRegion> regions_;
+#endif
+};
@@ -1,18 +1,27 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <iostream>
 #include <mutex>
 #include <optional>
 #include <utility>
+#include <thread>
 #include <tuple>
 #include <vector>
 
+#include "common/engine.hpp"
 #include "common/logger.hpp"
+#include "common/stats.hpp"
 #include "common/status.hpp"
 #include "common/types.hpp"
+#include "utility/function_ref.hpp"
+#include "utility/parallel_for.hpp"
 #include "utility/utility.hpp"
+#include "parallel/lock_profile.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 /// HELPER CLASSES
@@ -45,12 +54,91 @@ struct ParallelBucket {
   print(const size_t capacity) const;
 };
 
+/// @brief  Construction options for ParallelRobinHoodHashTable.
+struct ParallelTableOptions {
+  /// If nonzero, the table is a bounded cache: once it holds more than this
+  /// many entries, inserting a new key evicts another one (with CLOCK) instead
+  /// of growing. This must leave some headroom below the bucket array's size.
+  size_t cache_capacity = 0;
+  /// Each slot's reference counter saturates at this value. With 1, this is
+  /// plain CLOCK (a reference bit); larger values let frequently used keys
+  /// survive more passes of the hand (i.e. GCLOCK).
+  uint8_t max_frequency = 1;
+  /// Keep an expiry time per entry so that insert_with_ttl() can be used.
+  bool enable_ttl = false;
+  /// If nonzero, lock segments of this many buckets (a power of two that
+  /// divides the capacity) instead of single buckets. An operation then locks
+  /// the segments along its probe path in ascending order and holds them until
+  /// it is done, so a long displacement chain takes a few locks, not one per
+  /// bucket.
+  size_t lock_segment_size = 0;
+  /// Plan each insert without locks (where the key lands and where the first
+  /// hole after it is), then lock that window once, check the plan, and shift
+  /// the entries in one block. Locks are then held for the shift only, not
+  /// the probe walk.
+  bool optimistic_insert = false;
+  /// Keep a small direct-mapped cache of recently read keys in each thread.
+  /// An entry remembers the version of the region of buckets it was read
+  /// from, which every write to the region bumps, so a hit on a hot key costs
+  /// one load of a rarely written counter instead of its bucket and lock.
+  bool front_cache = false;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 /// HASH TABLE CLASS
 ////////////////////////////////////////////////////////////////////////////////
 
 class ParallelRobinHoodHashTable {
 public:
+  static constexpr EngineCapabilities capabilities = {.thread_safe = true, .resizable = false, .batched = false};
+
+  /// @brief  Weakly consistent cursor over the (key, value) pairs.
+  ///
+  /// N.B.  This takes no locks, so it may run alongside writers. Each bucket
+  ///       is read atomically, so every pair it yields was in the table at
+  ///       some point during the walk. However, an entry that a concurrent
+  ///       insert or remove shifts across the cursor may be missed or seen
+  ///       twice. Entries that are not moved during the walk are seen exactly
+  ///       once.
+  class Cursor {
+  public:
+    explicit Cursor(ParallelRobinHoodHashTable &table) : table_(table) {}
+
+    /// @brief  Advance to the next pair.
+    ///
+    /// @return false once every bucket has been visited.
+    bool
+    next(KeyType &key, ValueType &value)
+    {
+      while (this->index_ < this->table_.capacity_) {
+        const size_t index = this->index_++;
+        const ParallelBucket bkt = this->table_.load_bucket(index);
+        if (!bkt.is_empty() && !this->table_.is_expired(index)) {
+          key = bkt.key;
+          value = bkt.value;
+          return true;
+        }
+      }
+      return false;
+    }
+
+  private:
+    ParallelRobinHoodHashTable &table_;
+    size_t index_ = 0;
+  };
+
+  /// @brief  Construct with a random hash seed.
+  ParallelRobinHoodHashTable() = default;
+
+  /// @brief  Construct with a fixed hash seed (e.g. for reproducible layouts).
+  explicit ParallelRobinHoodHashTable(const uint64_t hash_seed);
+
+  /// @brief  Construct with a random hash seed and the given options.
+  explicit ParallelRobinHoodHashTable(const ParallelTableOptions &options);
+
+  /// @brief  Stops the expiry sweeper, if it is running.
+  ~ParallelRobinHoodHashTable();
+
   /// @brief Insert <key, value> pair.
   ///
   /// @return 0 on good; 1 on failure
@@ -58,6 +146,31 @@ public:
   ErrorType
   insert(KeyType key, ValueType value);
 
+  /// @brief  Insert <key, value> pair that expires after ttl. Once expired,
+  ///         the entry is treated as absent. It is removed when it or a key
+  ///         whose probe passes it is next looked up, or by expire_tick(). A
+  ///         plain insert() of the same key clears the expiry.
+  /// N.B.  The table must have been constructed with enable_ttl.
+  ErrorType
+  insert_with_ttl(KeyType key, ValueType value, std::chrono::nanoseconds ttl);
+
+  /// @brief  Remove the expired entries in the next max_slots slots of an
+  ///         incremental sweep over the bucket array.
+  ///
+  /// @return the number of entries removed.
+  size_t
+  expire_tick(size_t max_slots);
+
+  /// @brief  Call expire_tick(slots_per_tick) every period from a background
+  ///         thread, so that expired entries that are never looked up again
+  ///         do not linger.
+  void
+  start_expiry_sweeper(std::chrono::milliseconds period = std::chrono::milliseconds(100),
+                       size_t slots_per_tick = 4096);
+
+  void
+  stop_expiry_sweeper();
+
   /// @brief Search for <key, value>.
   ///
   /// @return 0 on found; 1 otherwise.
@@ -71,9 +184,115 @@ public:
   ErrorType
   remove(KeyType key);
 
+  /// @brief  If key is present, replace its value with update(value);
+  ///         otherwise, insert <key, value>. This walks the probe path once.
+  ///
+  /// @return the value now stored for key.
+  /// N.B.  update runs with the bucket's lock held, so it must not use the table.
+  template<typename Fn>
+  ValueType
+  upsert(KeyType key, ValueType value, Fn &&update)
+  {
+    ValueType result = value;
+    this->visit(key,
+        [&update, &result](ValueType &v) { v = update(v); result = v; return MatchAction::keep; },
+        [value]() -> std::optional<ValueType> { return value; });
+    return result;
+  }
+
+  /// @brief  Add delta to key's value, inserting <key, delta> if it is absent.
+  ///
+  /// @return the previous value (or 0 if key was absent).
+  ValueType
+  fetch_add(KeyType key, ValueType delta);
+
+  /// @brief  If key's value equals expected, replace it with desired.
+  ///         Otherwise, load the current value into expected.
+  ///
+  /// @return whether the value was replaced (false if key is absent).
+  bool
+  compare_exchange(KeyType key, ValueType &expected, ValueType desired);
+
+  /// @brief  Return key's value, inserting <key, fn()> if it is absent.
+  /// N.B.  fn runs with the bucket's lock held, so it must not use the table.
+  template<typename Fn>
+  ValueType
+  compute_if_absent(KeyType key, Fn &&fn)
+  {
+    ValueType result = 0;
+    this->visit(key,
+        [&result](ValueType &v) { result = v; return MatchAction::keep; },
+        [&fn, &result]() -> std::optional<ValueType> { result = fn(); return result; });
+    return result;
+  }
+
+  /// @brief  Remove key if pred(value) is true.
+  /// N.B.  pred runs with the bucket's lock held, so it must not use the table.
+  ///
+  /// @return 0 if removed; 1 otherwise.
+  template<typename Pred>
+  ErrorType
+  erase_if(KeyType key, Pred &&pred)
+  {
+    bool erased = false;
+    this->visit(key,
+        [&pred, &erased](ValueType &v) {
+          erased = pred(static_cast<const ValueType &>(v));
+          return erased ? MatchAction::erase : MatchAction::keep;
+        },
+        []() -> std::optional<ValueType> { return std::nullopt; });
+    return erased ? ErrorType::ok : ErrorType::e_notfound;
+  }
+
   void
   print();
 
+  /// @brief  Summarize the table's shape (see TableStats). Unlike print(),
+  ///         this is safe to call while other threads use the table.
+  TableStats
+  stats();
+
+  /// @brief  Get the number of entries.
+  size_t
+  size();
+
+  /// @brief  Get the index of key's home bucket (e.g. to pick keys that
+  ///         collide, for a stress test). The capacity is fixed, so this is
+  ///         stable.
+  size_t
+  home_of(KeyType key) const;
+
+  /// @brief  Per-region lock contention and key hotness. This is only filled
+  ///         in when built with MM_PARALLEL_LOCK_PROFILING.
+  LockProfile
+  lock_profile() const;
+
+  Cursor
+  cursor()
+  {
+    return Cursor(*this);
+  }
+
+  /// @brief  Call fn(key, value) on every pair, with the same weak
+  ///         consistency as Cursor.
+  template<typename Fn>
+  void
+  for_each(Fn &&fn)
+  {
+    this->for_each_in_range(0, this->capacity_, fn);
+  }
+
+  /// @brief  Call fn(key, value) on every pair, splitting the bucket array
+  ///         into num_threads ranges. fn must be safe to call concurrently.
+  template<typename Fn>
+  void
+  parallel_for_each(Fn &&fn, const size_t num_threads)
+  {
+    parallel_for_ranges(this->capacity_, num_threads, [this, &fn](const size_t begin, const size_t end) {
+      this->for_each_in_range(begin, end, fn);
+    });
+  }
+
 private:
   struct alignas(16) UnderlyingBucket
   {
@@ -81,12 +300,236 @@ private:
     std::mutex mutex;
   };
 
+  /// @brief  Find key in a single pass over its probe path. If it is present,
+  ///         call on_match(value) with its bucket locked; on_match may modify
+  ///         value in place or ask for the entry to be erased. Otherwise, call
+  ///         on_miss() and, if it returns a value, insert it before the probe
+  ///         path's locks are released.
+  ///
+  /// @return whether key was present.
+  bool
+  visit(KeyType key,
+        FunctionRef<MatchAction(ValueType &)> on_match,
+        FunctionRef<std::optional<ValueType>()> on_miss);
+
+  /// @brief  Finish inserting tmp, whose probe returned (status, offset) with
+  ///         the bucket at that offset locked.
+  ErrorType
+  insert_locked(ParallelBucket tmp,
+                uint64_t expiry,
+                size_t home,
+                SearchStatus status,
+                OffsetType offset);
+
+  /// @brief  Remove the entry at (home, offset), whose bucket is locked, by
+  ///         shifting its successors back. With keep_locked, the bucket stays
+  ///         locked (e.g. for a probe that is passing through it).
+  void
+  erase_locked(const size_t home, const OffsetType offset, const bool keep_locked = false);
+
+  ////////////////////////////////////////////////////////////////////////////
+  /// OPTIMISTIC INSERTS (see ParallelTableOptions::optimistic_insert)
+  ////////////////////////////////////////////////////////////////////////////
+
+  /// Give up on the optimistic path (and walk with locks) after this many
+  /// plans fail validation.
+  static constexpr size_t max_optimistic_attempts = 4;
+
+  /// @brief  Where an insert lands (offset from its home) and the offset of
+  ///         the last bucket it changes: the same bucket for a match or a
+  ///         hole, the first hole after it for a swap.
+  struct InsertPlan {
+    SearchStatus status;
+    OffsetType offset;
+    OffsetType end;
+  };
+
+  /// @brief  Plan an insert by reading the buckets atomically, without locks.
+  InsertPlan
+  plan_insert(const KeyType key, const HashCodeType hashcode, const size_t home);
+
+  /// @brief  Lock the window [home, home + plan.end], plan again, and if the
+  ///         new plan still fits in the window, carry it out.
+  ///
+  /// @return std::nullopt if the window wraps around the end of the table or
+  ///         the plans kept failing validation; the caller should take the
+  ///         locked walk instead.
+  std::optional<ErrorType>
+  try_insert_optimistic(KeyType key, ValueType value, uint64_t expiry,
+                        const HashCodeType hashcode, const size_t home);
+
+  /// @brief  With the window [home, home + window_end] locked, plan again and
+  ///         carry the plan out if it fits in the window.
+  ///
+  /// @return whether it inserted.
+  bool
+  commit_insert_plan(KeyType key, ValueType value, uint64_t expiry,
+                     const HashCodeType hashcode, const size_t home, const OffsetType window_end);
+
+  ////////////////////////////////////////////////////////////////////////////
+  /// FRONT CACHE (see ParallelTableOptions::front_cache)
+  ////////////////////////////////////////////////////////////////////////////
+
+  /// Buckets per version counter, as a power of two.
+  static constexpr size_t version_region_shift = 6;
+
+  struct alignas(64) RegionVersion {
+    std::atomic<uint64_t> value = 0;
+  };
+
+  static uint64_t
+  next_table_id();
+
+  /// @brief  Note that the bucket at index changed. Writers call this with
+  ///         the bucket still locked.
+  __attribute__((always_inline)) void
+  bump_version(const size_t index)
+  {
+    if (!this->region_versions_.empty()) {
+      this->region_versions_[index >> version_region_shift].value.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  __attribute__((always_inline)) uint64_t
+  region_version(const size_t index) const
+  {
+    return this->region_versions_.empty() ? 0 :
+        this->region_versions_[index >> version_region_shift].value.load(std::memory_order_acquire);
+  }
+
+  /// @brief  Look key up in this thread's front cache.
+  ///
+  /// @return std::nullopt if it is absent or stale.
+  std::optional<ValueType>
+  front_cache_lookup(const KeyType key, const HashCodeType hashcode);
+
+  /// @brief  Remember that key had value in the bucket at index, as of the
+  ///         bucket's region version.
+  void
+  front_cache_fill(const KeyType key,
+                   const HashCodeType hashcode,
+                   const ValueType value,
+                   const size_t index,
+                   const uint64_t version);
+
+  ////////////////////////////////////////////////////////////////////////////
+  /// STRIPED MODE (see ParallelTableOptions::lock_segment_size)
+  ////////////////////////////////////////////////////////////////////////////
+
+  struct alignas(64) SegmentLock {
+    std::mutex mutex;
+  };
+
+  /// @brief  The segments an operation holds: a run [first_, end_) that grows
+  ///         upwards from the segment it started in and, once its probe path
+  ///         wraps around the end of the table, a run [0, wrapped_end_).
+  ///         Unlocks them when destroyed.
+  class SegmentGuard {
+  public:
+    SegmentGuard(ParallelRobinHoodHashTable &table, const size_t index);
+    ~SegmentGuard();
+
+    SegmentGuard(const SegmentGuard &) = delete;
+    SegmentGuard &operator=(const SegmentGuard &) = delete;
+
+    /// @brief  Make sure that the segment of index (the next bucket along the
+    ///         probe path) is held. Growing the upper run keeps the locks in
+    ///         ascending order, so it waits; growing the wrapped run does not,
+    ///         so it only tries the lock.
+    ///
+    /// @return false if the lock was busy. Nothing was locked; call relock()
+    ///         and start the operation over.
+    bool
+    cover(const size_t index);
+
+    /// @brief  Release every segment and lock them again in ascending order,
+    ///         now including the wrapped segment that cover() failed to take.
+    void
+    relock();
+
+  private:
+    ParallelRobinHoodHashTable &table_;
+    size_t first_;
+    size_t end_;
+    size_t wrapped_end_ = 0;
+  };
+
+  __attribute__((always_inline)) bool
+  is_striped() const
+  {
+    return !this->segment_locks_.empty();
+  }
+
+  void
+  lock_segment(const size_t segment);
+
+  bool
+  try_lock_segment(const size_t segment);
+
+  void
+  unlock_segment(const size_t segment);
+
+  /// @brief  As get_wouldbe_offset(), but covering the probe path with guard.
+  ///
+  /// @return std::nullopt if guard needs to relock.
+  std::optional<std::pair<SearchStatus, OffsetType>>
+  probe_striped(SegmentGuard &guard, const KeyType key, const HashCodeType hashcode, const size_t home);
+
+  /// @brief  Cover the buckets after index up to the next hole, i.e. an
+  ///         insert's displacement chain from index.
+  ///
+  /// @return false if guard needs to relock.
+  bool
+  cover_to_hole(SegmentGuard &guard, const size_t index);
+
+  /// @brief  Cover the entries that erasing index would shift back. last is
+  ///         set to the last of them (or index if there are none).
+  ///
+  /// @return false if guard needs to relock.
+  bool
+  cover_shift_back(SegmentGuard &guard, const size_t index, size_t &last);
+
+  /// @brief  As insert_locked(), but covering the displacement chain with
+  ///         guard before changing anything.
+  ///
+  /// @return false (having changed nothing) if guard needs to relock.
+  bool
+  insert_striped_locked(ParallelBucket tmp, uint64_t expiry, const size_t home,
+                        const SearchStatus status, const OffsetType offset, SegmentGuard &guard);
+
+  /// @brief  As erase_locked(), but covering the shifted entries with guard
+  ///         before changing anything.
+  ///
+  /// @return false (having changed nothing) if guard needs to relock.
+  bool
+  erase_striped_locked(const size_t home, const OffsetType offset, SegmentGuard &guard);
+
+  /// @brief  Lock the segment of index and erase its entry if pred still
+  ///         holds for it (for the CLOCK hand and the expiry sweep).
+  ///
+  /// @return whether it erased.
+  bool
+  erase_index_if_striped(const size_t index, FunctionRef<bool(const ParallelBucket &)> pred);
+
+  ErrorType
+  insert_striped(KeyType key, ValueType value, uint64_t expiry, const HashCodeType hashcode, const size_t home);
+
+  std::optional<ValueType>
+  search_striped(KeyType key, const HashCodeType hashcode, const size_t home);
+
+  ErrorType
+  remove_striped(KeyType key, const HashCodeType hashcode, const size_t home);
+
+  bool
+  visit_striped(KeyType key, const HashCodeType hashcode, const size_t home,
+                FunctionRef<MatchAction(ValueType &)> on_match,
+                FunctionRef<std::optional<ValueType>()> on_miss);
+
   std::pair<SearchStatus, OffsetType>
   get_wouldbe_offset(
     const KeyType key,
     const HashCodeType hashcode,
-    const size_t home,
-    const std::vector<size_t> &locked_buckets
+    const size_t home
   );
 
   __attribute__((always_inline)) ParallelBucket &
@@ -95,10 +538,128 @@ private:
     return this->buckets_[index].bucket;
   }
 
+  /// @brief  Read a bucket without its lock (see search()'s fast path).
+  __attribute__((always_inline)) ParallelBucket
+  load_bucket(const size_t index)
+  {
+    const std::atomic_ref<ParallelBucket> bkt(this->get_bucket(index));
+    return bkt.load();
+  }
+
+  template<typename Fn>
+  void
+  for_each_in_range(const size_t begin, const size_t end, Fn &fn)
+  {
+    for (size_t i = begin; i < end; ++i) {
+      const ParallelBucket bkt = this->load_bucket(i);
+      if (!bkt.is_empty() && !this->is_expired(i)) {
+        fn(bkt.key, bkt.value);
+      }
+    }
+  }
+
+  static constexpr uint8_t clock_empty = 0;
+  static constexpr uint8_t clock_unreferenced = 1;
+  /// The CLOCK hand claims this many slots at a time so that it does not
+  /// bounce its cache line on every step.
+  static constexpr size_t clock_batch_size = 64;
+
+  __attribute__((always_inline)) bool
+  is_cache() const
+  {
+    return this->options_.cache_capacity != 0;
+  }
+
+  /// @brief  Mark the entry in slot index as recently used (in cache mode).
+  __attribute__((always_inline)) void
+  touch(const size_t index)
+  {
+    if (this->is_cache()) {
+      std::atomic<uint8_t> &f = this->frequencies_[index];
+      const uint8_t old = f.load(std::memory_order_relaxed);
+      // Skip the store (and dirtying the cache line) once it is saturated.
+      if (old != clock_empty && old < clock_unreferenced + this->options_.max_frequency) {
+        f.store(static_cast<uint8_t>(old + 1), std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// @brief  The reference counters move with their entries, so these are
+  ///         called (with the slot locked) wherever a bucket is moved.
+  __attribute__((always_inline)) uint8_t
+  get_frequency(const size_t index) const
+  {
+    return this->is_cache() ? this->frequencies_[index].load(std::memory_order_relaxed) : 0;
+  }
+
+  __attribute__((always_inline)) void
+  set_frequency(const size_t index, const uint8_t frequency)
+  {
+    if (this->is_cache()) {
+      this->frequencies_[index].store(frequency, std::memory_order_relaxed);
+    }
+  }
+
+  /// @brief  Nanoseconds on the steady clock. Expiry times use this.
+  static uint64_t
+  now_ns()
+  {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  /// @brief  Like the reference counters, expiry times move with their
+  ///         entries. Zero means the entry never expires.
+  __attribute__((always_inline)) uint64_t
+  get_expiry(const size_t index) const
+  {
+    return this->options_.enable_ttl ? this->expiries_[index].load(std::memory_order_relaxed) : 0;
+  }
+
+  __attribute__((always_inline)) void
+  set_expiry(const size_t index, const uint64_t expiry)
+  {
+    if (this->options_.enable_ttl) {
+      this->expiries_[index].store(expiry, std::memory_order_relaxed);
+    }
+  }
+
+  /// @brief  Whether the entry in slot index has expired. We only read the
+  ///         clock if the entry has an expiry time at all.
+  __attribute__((always_inline)) bool
+  is_expired(const size_t index) const
+  {
+    const uint64_t expiry = this->get_expiry(index);
+    return expiry != 0 && expiry <= now_ns();
+  }
+
+  ErrorType
+  insert_with_expiry(KeyType key, ValueType value, uint64_t expiry);
+
+  /// @brief  Evict entries until we are within the cache capacity. We call
+  ///         this with no locks held.
+  void
+  evict_to_capacity();
+
+  /// @brief  Advance the CLOCK hand until it finds an unreferenced entry and
+  ///         evict it.
+  void
+  evict_one();
+
   __attribute__((always_inline)) void
   lock_index(const size_t index)
   {
-    this->buckets_[index].mutex.lock();
+    std::mutex &mutex = this->buckets_[index].mutex;
+    if constexpr (table_counters_enabled || lock_profiling_enabled) {
+      if (!mutex.try_lock()) {
+        this->counters_.add_contended_lock();
+        this->lock_profiler_.lock_contended(mutex, index);
+      }
+      this->counters_.add_lock_acquisition();
+      this->lock_profiler_.record_acquisition(index);
+    } else {
+      mutex.lock();
+    }
   }
 
   __attribute__((always_inline)) void
@@ -112,4 +673,33 @@ private:
   std::mutex meta_mutex_;
   size_t length_ = 0;
   size_t capacity_ = 1<<20;
+  DefaultHash hasher_{random_hash_seed()};
+  [[no_unique_address]] TableCounters counters_;
+  [[no_unique_address]] LockProfiler lock_profiler_{this->capacity_};
+  ParallelTableOptions options_ = {};
+  /// Per-slot CLOCK reference counters, only allocated in cache mode. These
+  /// live in a side array so that a bucket still fits in 16 bytes.
+  ///
+  /// N.B.  We store the reference count plus one so that the hand can skip
+  ///       holes by looking at this array alone.
+  std::vector<std::atomic<uint8_t>> frequencies_;
+  std::atomic<size_t> clock_hand_ = 0;
+  std::atomic<uint64_t> evictions_ = 0;
+  /// Per-slot expiry times, only allocated if TTLs are enabled.
+  std::vector<std::atomic<uint64_t>> expiries_;
+  std::atomic<size_t> sweep_cursor_ = 0;
+  std::atomic<uint64_t> expirations_ = 0;
+  std::mutex sweeper_mutex_;
+  std::condition_variable sweeper_cv_;
+  std::thread sweeper_;
+  bool stop_sweeper_ = false;
+  /// Only allocated in striped mode.
+  std::vector<SegmentLock> segment_locks_;
+  size_t segment_shift_ = 0;
+  /// Tells this table's front cache entries apart from other tables'.
+  const uint64_t id_ = next_table_id();
+  /// Per-region write counters, only allocated with the front cache.
+  std::vector<RegionVersion> region_versions_;
 };
+
+static_assert(HashTableEngine<ParallelRobinHoodHashTable>);
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "common/status.hpp"
+#include "common/types.hpp"
+#include "parallel/parallel.hpp"
+#include "reclamation/epoch.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// POINTER-VALUED HASH TABLE
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  A concurrent map from keys to heap-allocated values of type T.
+///
+/// The buckets only have room for a 32-bit value, so the underlying
+/// ParallelRobinHoodHashTable maps each key to a handle, i.e. an index into an
+/// array of pointers. A replaced or removed value is retired into an epoch
+/// domain rather than freed, and so is a removed handle (so that a reader
+/// holding a stale handle cannot see another key's value). Thus, a pointer
+/// returned by search() stays valid for as long as the caller stays pinned.
+///
+/// Example:
+///     ParallelPointerTable<std::string> t;
+///     t.insert(1, std::make_unique<std::string>("one"));
+///     {
+///       auto guard = t.pin();
+///       const std::string *s = t.search(1, guard);
+///       // *s is safe to read here, even if another thread removes key 1.
+///     }
+template<typename T>
+class ParallelPointerTable {
+public:
+  using Guard = EpochDomain::Guard;
+
+  static constexpr size_t default_num_handles = 1 << 20;
+
+  ParallelPointerTable() : ParallelPointerTable(default_num_handles) {}
+
+  /// @brief  Construct with room for num_handles values at once (counting
+  ///         removed and replaced ones until they are reclaimed).
+  explicit ParallelPointerTable(const size_t num_handles)
+      : slots_(num_handles)
+  {
+  }
+
+  ~ParallelPointerTable()
+  {
+    // The retired values are freed by the domain's destructor.
+    for (auto &slot : this->slots_) {
+      delete slot.load(std::memory_order_relaxed);
+    }
+  }
+
+  ParallelPointerTable(const ParallelPointerTable &) = delete;
+  ParallelPointerTable &operator=(const ParallelPointerTable &) = delete;
+
+  /// @brief  Pin the calling thread. Pointers returned by search() are valid
+  ///         until the guard is destroyed.
+  Guard
+  pin()
+  {
+    return this->domain_.pin();
+  }
+
+  /// @brief  Insert <key, value> pair, taking ownership of value. If key is
+  ///         present, its old value is retired.
+  ///
+  /// @return e_oom if every handle is in use (even if key is present, since
+  ///         the new value takes a handle before the old one is found). The
+  ///         value is then freed.
+  ErrorType
+  insert(KeyType key, std::unique_ptr<T> value)
+  {
+    const std::optional<ValueType> maybe_handle = this->allocate_handle();
+    if (!maybe_handle.has_value()) {
+      return ErrorType::e_oom;
+    }
+    const ValueType handle = maybe_handle.value();
+    T *raw = value.release();
+    this->slots_[handle].store(raw, std::memory_order_release);
+    T *replaced = nullptr;
+    bool found = false;
+    // NOTE The update runs with the key's bucket locked, so a concurrent
+    //      remove() cannot take the old handle from under us.
+    this->table_.upsert(key, handle, [this, raw, &replaced, &found](ValueType old_handle) {
+      replaced = this->slots_[old_handle].exchange(raw, std::memory_order_acq_rel);
+      found = true;
+      return old_handle;
+    });
+    if (found) {
+      // Our new handle was never published, so it can be reused immediately.
+      this->slots_[handle].store(nullptr, std::memory_order_relaxed);
+      this->release_handle(handle);
+      this->domain_.retire(replaced);
+    }
+    return ErrorType::ok;
+  }
+
+  /// @brief  Search for key.
+  ///
+  /// @return its value, or nullptr if it is absent. The value may be retired
+  ///         at any time, but is not freed while guard is alive.
+  const T *
+  search(KeyType key, const Guard &guard)
+  {
+    (void)guard;
+    const std::optional<ValueType> handle = this->table_.search(key);
+    if (!handle.has_value()) {
+      return nullptr;
+    }
+    return this->slots_[handle.value()].load(std::memory_order_acquire);
+  }
+
+  /// @brief  Remove key, retiring its value.
+  ///
+  /// @return 0 on found; 1 otherwise.
+  ErrorType
+  remove(KeyType key)
+  {
+    ValueType handle = 0;
+    const ErrorType e = this->table_.erase_if(key, [&handle](ValueType h) {
+      handle = h;
+      return true;
+    });
+    if (e != ErrorType::ok) {
+      return e;
+    }
+    this->domain_.retire(this->slots_[handle].exchange(nullptr, std::memory_order_acq_rel));
+    this->domain_.retire(handle_to_object(handle), [](void *object, void *context) {
+      static_cast<ParallelPointerTable *>(context)->release_handle(object_to_handle(object));
+    }, this);
+    return ErrorType::ok;
+  }
+
+  EpochDomain &
+  domain()
+  {
+    return this->domain_;
+  }
+
+  TableStats
+  stats()
+  {
+    return this->table_.stats();
+  }
+
+private:
+  static void *
+  handle_to_object(const ValueType handle)
+  {
+    return reinterpret_cast<void *>(static_cast<uintptr_t>(handle));
+  }
+
+  static ValueType
+  object_to_handle(void *object)
+  {
+    return static_cast<ValueType>(reinterpret_cast<uintptr_t>(object));
+  }
+
+  /// @return std::nullopt if every handle is in use.
+  std::optional<ValueType>
+  allocate_handle()
+  {
+    const std::optional<ValueType> free_handle = this->pop_free_handle();
+    if (free_handle.has_value()) {
+      return free_handle;
+    }
+    size_t handle = this->next_handle_.load(std::memory_order_relaxed);
+    while (handle < this->slots_.size()) {
+      if (this->next_handle_.compare_exchange_weak(handle, handle + 1, std::memory_order_relaxed)) {
+        return static_cast<ValueType>(handle);
+      }
+    }
+    // Removed keys' handles are only freed two epochs after they were
+    // retired, so try to get there before giving up. (This only reclaims what
+    // this thread retired.)
+    this->domain_.collect();
+    this->domain_.collect();
+    return this->pop_free_handle();
+  }
+
+  std::optional<ValueType>
+  pop_free_handle()
+  {
+    std::lock_guard<std::mutex> lock(this->free_handles_mutex_);
+    if (this->free_handles_.empty()) {
+      return std::nullopt;
+    }
+    const ValueType handle = this->free_handles_.back();
+    this->free_handles_.pop_back();
+    return handle;
+  }
+
+  void
+  release_handle(const ValueType handle)
+  {
+    std::lock_guard<std::mutex> lock(this->free_handles_mutex_);
+    this->free_handles_.push_back(handle);
+  }
+
+  ParallelRobinHoodHashTable table_;
+  std::vector<std::atomic<T *>> slots_;
+  std::atomic<size_t> next_handle_ = 0;
+  std::mutex free_handles_mutex_;
+  std::vector<ValueType> free_handles_;
+  /// This is declared last so that it is destroyed first, while the handle
+  /// free list its reclaimers use is still alive.
+  EpochDomain domain_;
+};
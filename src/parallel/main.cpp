@@ -1,7 +1,14 @@
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "parallel/parallel.hpp"
+#include "parallel/pointer_table.hpp"
 
 
 int main() {
@@ -23,6 +30,75 @@ int main() {
     }
   }
 
+  // Read-modify-write
+  std::cout << "Fetch-add (" << a.fetch_add(10, 5) << "): 10 += 5\n";
+  ValueType expected = 5;
+  bool exchanged = a.compare_exchange(10, expected, 7);
+  std::cout << "Compare-exchange (" << exchanged << "): 10: 5 -> 7\n";
+  std::cout << "Compute-if-absent: 11: " << a.compute_if_absent(11, []() { return ValueType{11}; }) << "\n";
+  std::cout << "Upsert: 11: " << a.upsert(11, 0, [](ValueType v) { return v * 2; }) << "\n";
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&a]() {
+      for (size_t i = 0; i < 1000; ++i) {
+        a.fetch_add(11, 1);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::cout << "Concurrent fetch-add: 11: " << a.search(11).value() << "\n";
+  a.upsert(11, 0, [](ValueType) { return ValueType{22}; });
+  std::cout << "Erase-if (" << static_cast<int>(a.erase_if(11, [](ValueType v) { return v == 22; })) << "): 11\n";
+
+  // Iterate
+  std::atomic<size_t> num_visited = 0;
+  a.parallel_for_each([&num_visited](const KeyType, const ValueType) {
+    num_visited.fetch_add(1, std::memory_order_relaxed);
+  }, 4);
+  std::cout << "Visited " << num_visited.load() << " pairs with 4 threads\n";
+  auto cursor = a.cursor();
+  KeyType key = 0;
+  ValueType value = 0;
+  while (cursor.next(key, value)) {
+    std::cout << "Cursor: <" << key << ", " << value << ">\n";
+  }
+
+  // Statistics
+  a.stats().print(std::cout);
+
+  // Expiry
+  ParallelTableOptions ttl_options;
+  ttl_options.enable_ttl = true;
+  ParallelRobinHoodHashTable b(ttl_options);
+  for (KeyType i = 0; i < 10; ++i) {
+    b.insert_with_ttl(i, i, std::chrono::milliseconds(i < 5 ? 1 : 1000));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  std::cout << "Lookup after 2ms (" << b.search(0).has_value() << ") 0, (" <<
+      b.search(9).has_value() << ") 9\n";
+  std::cout << "Expire tick: " << b.expire_tick(1 << 20) << " expired\n";
+  b.start_expiry_sweeper(std::chrono::milliseconds(1));
+  b.stop_expiry_sweeper();
+  b.stats().print(std::cout);
+
+  // Pointer values
+  ParallelPointerTable<std::string> c;
+  c.insert(1, std::make_unique<std::string>("one"));
+  {
+    auto guard = c.pin();
+    const std::string *one = c.search(1, guard);
+    // The old value is retired, but stays valid while we are pinned.
+    c.insert(1, std::make_unique<std::string>("uno"));
+    std::cout << "Pinned lookup: 1: " << *one << ", now: " << *c.search(1, guard) << "\n";
+  }
+  c.remove(1);
+  // Two epochs must pass before the retired values can be freed.
+  c.domain().collect();
+  c.domain().collect();
+  std::cout << "Retired: " << c.domain().num_retired() << ", Reclaimed: " << c.domain().num_reclaimed() << "\n";
+
   // Remove
   for (uint64_t i = 0; i < 11; ++i) {
     ErrorType e = a.remove(i);
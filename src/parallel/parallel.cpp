@@ -1,5 +1,6 @@
 #include <algorithm>  // std::swap
 #include <atomic>
+#include <bit>
 #include <optional>
 #include <tuple>
 
@@ -58,6 +59,36 @@ get_real_index(const size_t home, const size_t offset, const size_t capacity) {
 /// HASH TABLE CLASS
 ////////////////////////////////////////////////////////////////////////////////
 
+ParallelRobinHoodHashTable::ParallelRobinHoodHashTable(const uint64_t hash_seed)
+    : hasher_(hash_seed) {}
+
+ParallelRobinHoodHashTable::ParallelRobinHoodHashTable(const ParallelTableOptions &options)
+    : options_(options) {
+  // Concurrent inserts may each overshoot the capacity by one before they
+  // evict, and we cannot resize, so leave plenty of holes.
+  assert(options.cache_capacity <= this->capacity_ / 10 * 9 && "cache capacity too close to the table's size");
+  assert(options.max_frequency >= 1 && "need at least a reference bit");
+  if (this->is_cache()) {
+    this->frequencies_ = std::vector<std::atomic<uint8_t>>(this->capacity_);
+  }
+  if (options.enable_ttl) {
+    this->expiries_ = std::vector<std::atomic<uint64_t>>(this->capacity_);
+  }
+  if (options.lock_segment_size != 0) {
+    assert(std::has_single_bit(options.lock_segment_size) && options.lock_segment_size <= this->capacity_ &&
+           "lock segment size should be a power of two that divides the capacity");
+    this->segment_shift_ = static_cast<size_t>(std::countr_zero(options.lock_segment_size));
+    this->segment_locks_ = std::vector<SegmentLock>(this->capacity_ >> this->segment_shift_);
+  }
+  if (options.front_cache) {
+    this->region_versions_ = std::vector<RegionVersion>(this->capacity_ >> version_region_shift);
+  }
+}
+
+ParallelRobinHoodHashTable::~ParallelRobinHoodHashTable() {
+  this->stop_expiry_sweeper();
+}
+
 /// NOTE: NOT THREAD SAFE!!!
 void
 ParallelRobinHoodHashTable::print() {
@@ -73,33 +104,98 @@ ParallelRobinHoodHashTable::print() {
 }
 
 
-#define UNLOCK_ALL(vec) for (auto idx : vec) { this->unlock_index(idx); }
+TableStats
+ParallelRobinHoodHashTable::stats() {
+  LOG_TRACE("Enter");
+  TableStatsCollector collector(this->capacity_);
+  if (this->is_striped()) {
+    const size_t segment_size = size_t{1} << this->segment_shift_;
+    for (size_t segment = 0; segment < this->segment_locks_.size(); ++segment) {
+      std::lock_guard<std::mutex> lock(this->segment_locks_[segment].mutex);
+      for (size_t i = segment * segment_size; i < (segment + 1) * segment_size; ++i) {
+        const ParallelBucket &bkt = this->get_bucket(i);
+        collector.visit(!bkt.is_empty(), bkt.offset);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < this->capacity_; ++i) {
+      // NOTE We bypass lock_index() so that taking stats is not itself counted.
+      std::lock_guard<std::mutex> lock(this->buckets_[i].mutex);
+      const ParallelBucket &bkt = this->get_bucket(i);
+      collector.visit(!bkt.is_empty(), bkt.offset);
+    }
+  }
+  TableStats s = collector.finish(sizeof(*this) + this->buckets_.capacity() * sizeof(UnderlyingBucket) +
+                                  this->frequencies_.capacity() * sizeof(std::atomic<uint8_t>) +
+                                  this->expiries_.capacity() * sizeof(std::atomic<uint64_t>) +
+                                  this->segment_locks_.capacity() * sizeof(SegmentLock));
+  this->counters_.snapshot(s);
+  s.probe_retries_enabled = this->options_.optimistic_insert || this->is_striped();
+  s.cache_capacity = this->options_.cache_capacity;
+  s.evictions = this->evictions_.load(std::memory_order_relaxed);
+  s.ttl_enabled = this->options_.enable_ttl;
+  s.expirations = this->expirations_.load(std::memory_order_relaxed);
+  return s;
+}
+
+size_t
+ParallelRobinHoodHashTable::size() {
+  LOG_TRACE("Enter");
+  std::lock_guard<std::mutex> lock(this->meta_mutex_);
+  return this->length_;
+}
+
+size_t
+ParallelRobinHoodHashTable::home_of(KeyType key) const {
+  return get_home(this->hasher_(key), this->capacity_);
+}
+
+LockProfile
+ParallelRobinHoodHashTable::lock_profile() const {
+  LOG_TRACE("Enter");
+  return this->lock_profiler_.snapshot();
+}
+
 
 std::pair<SearchStatus, OffsetType>
 ParallelRobinHoodHashTable::get_wouldbe_offset(
   const KeyType key,
   const HashCodeType hashcode,
-  const size_t home,
-  const std::vector<size_t> &locked_buckets
+  const size_t home
 ) {
   LOG_TRACE("Enter");
   size_t capacity = this->buckets_.size();
+  this->lock_index(home);
   for (OffsetType i = 0; i < capacity; ++i) {
     size_t real_index = get_real_index(home, i, capacity);
-    if (std::find(locked_buckets.begin(), locked_buckets.end(), real_index) == locked_buckets.end()) {
-      this->lock_index(real_index);
-    }
     const ParallelBucket &bkt = this->get_bucket(real_index);
     // If not found
     if (bkt.is_empty()) {
       // This is first, because equality on an empty bucket is not well defined.
       return {SearchStatus::found_hole, i};
+    } else if (!bkt.equal_by_key(key, hashcode) && this->is_expired(real_index)) {
+      // Reclaim another key's expired entry as we pass it. The shift keeps
+      // this bucket locked (and only locks the ones after it, like us), so
+      // look at it again. Our own key is left to the caller.
+      this->erase_locked(home, i, /*keep_locked=*/true);
+      this->expirations_.fetch_add(1, std::memory_order_relaxed);
+      --i;
+      continue;
     } else if (bkt.offset < i) { // This means that bkt belongs to a nearer home
       return {SearchStatus::found_swap, i};
     // If found
     } else if (bkt.equal_by_key(key, hashcode)) {
       return {SearchStatus::found_match, i};
     }
+    if (i + 1 == capacity) {
+      this->unlock_index(real_index);
+      break;
+    }
+    // Lock the next bucket before letting go of this one. erase_locked()
+    // shifts entries back one bucket at a time in the same way, so it can
+    // never move an entry from the next bucket into this one behind our back
+    // (and we would walk past it).
+    this->lock_index(get_real_index(home, i + 1, capacity));
     this->unlock_index(real_index);
   }
   // If no hole found, then we hold no locks!
@@ -108,6 +204,20 @@ ParallelRobinHoodHashTable::get_wouldbe_offset(
 
 ErrorType
 ParallelRobinHoodHashTable::insert(KeyType key, ValueType value) {
+  LOG_TRACE("Enter");
+  return this->insert_with_expiry(key, value, 0);
+}
+
+ErrorType
+ParallelRobinHoodHashTable::insert_with_ttl(KeyType key, ValueType value, std::chrono::nanoseconds ttl) {
+  LOG_TRACE("Enter");
+  assert(this->options_.enable_ttl && "construct with enable_ttl to use TTLs");
+  assert(ttl.count() >= 0 && "negative TTL");
+  return this->insert_with_expiry(key, value, now_ns() + static_cast<uint64_t>(ttl.count()));
+}
+
+ErrorType
+ParallelRobinHoodHashTable::insert_with_expiry(KeyType key, ValueType value, uint64_t expiry) {
   LOG_TRACE("Enter");
   // TODO: ensure key and value are valid
   // 1. Error check arguments
@@ -115,79 +225,143 @@ ParallelRobinHoodHashTable::insert(KeyType key, ValueType value) {
   // 3.   If not, check if room to insert
   // 4.     If not, resize
   // 5. Insert (with swapping if necessary)
-  HashCodeType hashcode = hash(key);
-  std::vector<size_t> locked_buckets;
+  HashCodeType hashcode = this->hasher_(key);
+  size_t home = get_home(hashcode, this->capacity_);
+  this->lock_profiler_.record_home(home);
+  if (this->options_.optimistic_insert) {
+    const std::optional<ErrorType> e = this->try_insert_optimistic(key, value, expiry, hashcode, home);
+    if (e.has_value()) {
+      if (this->is_cache()) {
+        this->evict_to_capacity();
+      }
+      return e.value();
+    }
+  }
+  if (this->is_striped()) {
+    return this->insert_striped(key, value, expiry, hashcode, home);
+  }
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
   ParallelBucket tmp = {.key = key,
                           .value = value,
                           .hashcode = hashcode,
                           .offset = /*arbitrary value*/0,};
+  ErrorType e = this->insert_locked(tmp, expiry, home, status, offset);
+  if (this->is_cache()) {
+    this->evict_to_capacity();
+  }
+  return e;
+}
+
+ErrorType
+ParallelRobinHoodHashTable::insert_locked(ParallelBucket tmp,
+                                          uint64_t expiry,
+                                          size_t home,
+                                          SearchStatus status,
+                                          OffsetType offset) {
+  LOG_TRACE("Enter");
   const size_t capacity = this->buckets_.size();
-  // This could also be upper-bounded by the number of valid elements (num_elem)
-  // in this->buckets_. This is because you need to bump at most num_elem elements
-  // (if they are all sitting in a row) to insert something.
+  size_t real_index = get_real_index(home, offset, capacity);
+  switch (status) {
+    case SearchStatus::found_match: {
+      LOG_TRACE("SearchStatus::found_match");
+      ParallelBucket &bkt = this->get_bucket(real_index);
+      bkt.value = tmp.value;
+      this->set_expiry(real_index, expiry);
+      this->touch(real_index);
+      this->bump_version(real_index);
+      this->unlock_index(real_index);
+      return ErrorType::ok;
+    }
+    case SearchStatus::found_swap:
+    case SearchStatus::found_hole:
+      break;
+    case SearchStatus::found_nohole:
+      assert(0 && "should not call this function if we need to resize!");
+    default:
+      assert(0 && "impossible!");
+  }
+
+  // Carry the entry forwards, swapping it with any entry nearer its home,
+  // until a hole takes it. We keep every bucket we pass locked, so the locks
+  // we hold are always the run [first_locked, real_index] and need no list.
+  const size_t first_locked = real_index;
+  size_t num_locked = 1;
+  // A new entry starts out referenced once, so the hand skips it once.
+  uint8_t frequency = clock_unreferenced + 1;
+  tmp.offset = offset;
   while (true) {
-    size_t home = get_home(tmp.hashcode, capacity);
-    const auto [status, offset] = this->get_wouldbe_offset(tmp.key, tmp.hashcode, home, locked_buckets);
-    switch (status) {
-      case SearchStatus::found_match: {
-        LOG_DEBUG("SearchStatus::found_match");
-        size_t real_index = get_real_index(home, offset, capacity);
-        ParallelBucket &bkt = this->get_bucket(real_index);
-        bkt.value = tmp.value;
-        this->unlock_index(real_index);
-        UNLOCK_ALL(locked_buckets);
-        return ErrorType::ok;
-      }
-      case SearchStatus::found_swap: {
-        LOG_DEBUG("SearchStatus::found_swap");
-        // NOTE(dchu): could be buggy
-        size_t real_index = get_real_index(home, offset, capacity);
-        ParallelBucket &bkt = this->get_bucket(real_index);
-        tmp.offset = offset;
-        std::swap(bkt, tmp);
-        locked_buckets.push_back(real_index);
-        continue;
-      }
-      case SearchStatus::found_hole: {
-        LOG_DEBUG("SearchStatus::found_hole");
-        // NOTE(dchu): could be buggy
-        size_t real_index = get_real_index(home, offset, capacity);
-        ParallelBucket &bkt = this->get_bucket(real_index);
-        tmp.offset = offset;
-        std::swap(bkt, tmp);
-        this->unlock_index(real_index);
-        this->meta_mutex_.lock();
-        ++this->length_;
-        this->meta_mutex_.unlock();
-        UNLOCK_ALL(locked_buckets);
-        return ErrorType::ok;
-      }
-      case SearchStatus::found_nohole:
-        assert(0 && "should not call this function if we need to resize!");
-      default:
-        assert(0 && "impossible!");
+    ParallelBucket &bkt = this->get_bucket(real_index);
+    if (bkt.is_empty()) {
+      bkt = tmp;
+      this->set_frequency(real_index, frequency);
+      this->set_expiry(real_index, expiry);
+      this->bump_version(real_index);
+      break;
+    } else if (bkt.offset < tmp.offset) {
+      std::swap(bkt, tmp);
+      const uint8_t displaced_frequency = this->get_frequency(real_index);
+      this->set_frequency(real_index, frequency);
+      frequency = displaced_frequency;
+      const uint64_t displaced_expiry = this->get_expiry(real_index);
+      this->set_expiry(real_index, expiry);
+      expiry = displaced_expiry;
+      this->bump_version(real_index);
     }
+    real_index = get_real_index(real_index, 1, capacity);
+    ++tmp.offset;
+    this->lock_index(real_index);
+    ++num_locked;
+  }
+  this->meta_mutex_.lock();
+  ++this->length_;
+  this->meta_mutex_.unlock();
+  for (size_t i = 0; i < num_locked; ++i) {
+    this->unlock_index(get_real_index(first_locked, i, capacity));
   }
-  assert(0 && "impossible!");
+  return ErrorType::ok;
 }
 
 std::optional<ValueType>
 ParallelRobinHoodHashTable::search(KeyType key) {
   LOG_TRACE("Enter");
-  HashCodeType hashcode = hash(key);
+  HashCodeType hashcode = this->hasher_(key);
   size_t home = get_home(hashcode, this->capacity_);
+  this->lock_profiler_.record_home(home);
+  if (this->options_.front_cache) {
+    const std::optional<ValueType> cached = this->front_cache_lookup(key, hashcode);
+    if (cached.has_value()) {
+      return cached;
+    }
+  }
+  // Read the version first, so that if the bucket changes after it, the
+  // entry we cache is already stale.
+  const uint64_t home_version = this->region_version(home);
   const std::atomic_ref atomic_home_bucket(this->get_bucket(home));
   const ParallelBucket home_bucket = atomic_home_bucket.load();
-  if (!home_bucket.is_empty() && home_bucket.equal_by_key(key, hashcode)) {
+  // An expired match falls through to the locked path, which removes it.
+  if (!home_bucket.is_empty() && home_bucket.equal_by_key(key, hashcode) && !this->is_expired(home)) {
+    this->touch(home);
+    this->front_cache_fill(key, hashcode, home_bucket.value, home, home_version);
     return home_bucket.value;
   }
+  if (this->is_striped()) {
+    return this->search_striped(key, hashcode, home);
+  }
 
-  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home, {});
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
   switch (status) {
     case SearchStatus::found_match: {
       size_t real_index = get_real_index(home, offset, this->capacity_);
+      if (this->is_expired(real_index)) {
+        this->erase_locked(home, offset);
+        this->expirations_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+      }
       const ParallelBucket &bkt = this->get_bucket(real_index);
       ValueType v = bkt.value;
+      this->touch(real_index);
+      // Writers bump the version before they unlock, so it is stable here.
+      this->front_cache_fill(key, hashcode, v, real_index, this->region_version(real_index));
       this->unlock_index(real_index);
       return v;
     }
@@ -208,37 +382,23 @@ ParallelRobinHoodHashTable::search(KeyType key) {
 ErrorType
 ParallelRobinHoodHashTable::remove(KeyType key) {
   LOG_TRACE("Enter");
-  HashCodeType hashcode = hash(key);
+  HashCodeType hashcode = this->hasher_(key);
   size_t home = get_home(hashcode, this->capacity_);
+  this->lock_profiler_.record_home(home);
+  if (this->is_striped()) {
+    return this->remove_striped(key, hashcode, home);
+  }
 
-  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home, {});
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
   switch (status) {
     case SearchStatus::found_match: {
-      for (size_t i = 0; i < this->capacity_; ++i) {
-        // NOTE(dchu): real_index is the previous iteration's next_real_index
-        size_t real_index = get_real_index(home, offset + i, this->capacity_);
-        ParallelBucket &bkt = this->get_bucket(real_index);
-        size_t next_real_index = get_real_index(home, offset + i + 1, this->capacity_);
-        ParallelBucket &next_bkt = this->get_bucket(next_real_index);
-        this->lock_index(next_real_index);
-        // Next element is empty or already in its home bucket
-        if (next_bkt.is_empty() || next_bkt.offset == 0) {
-          bkt.invalidate();
-          this->unlock_index(real_index);
-          this->unlock_index(next_real_index);
-          this->meta_mutex_.lock();
-          --this->length_;
-          this->meta_mutex_.unlock();
-          return ErrorType::ok;
-        }
-        // I argue that this sliding is efficient if the average home has only a
-        // single element belonging to it. In this case, it would not have any
-        // elements belonging to the same home, over which it may leap-frog.
-        bkt = std::move(next_bkt);
-        --bkt.offset;
-        this->unlock_index(real_index);
+      const bool expired = this->is_expired(get_real_index(home, offset, this->capacity_));
+      this->erase_locked(home, offset);
+      if (expired) {
+        this->expirations_.fetch_add(1, std::memory_order_relaxed);
+        return ErrorType::e_notfound;
       }
-      assert(0 && "impossible! Should have a hole");
+      return ErrorType::ok;
     }
     // Not found
     case SearchStatus::found_hole:
@@ -254,3 +414,866 @@ ParallelRobinHoodHashTable::remove(KeyType key) {
   }
   assert(0 && "unreachable");
 }
+
+void
+ParallelRobinHoodHashTable::erase_locked(const size_t home, const OffsetType offset, const bool keep_locked) {
+  LOG_TRACE("Enter");
+  for (size_t i = 0; i < this->capacity_; ++i) {
+    // NOTE(dchu): real_index is the previous iteration's next_real_index
+    size_t real_index = get_real_index(home, offset + i, this->capacity_);
+    ParallelBucket &bkt = this->get_bucket(real_index);
+    size_t next_real_index = get_real_index(home, offset + i + 1, this->capacity_);
+    ParallelBucket &next_bkt = this->get_bucket(next_real_index);
+    this->lock_index(next_real_index);
+    // Next element is empty or already in its home bucket
+    if (next_bkt.is_empty() || next_bkt.offset == 0) {
+      bkt.invalidate();
+      this->set_frequency(real_index, clock_empty);
+      this->set_expiry(real_index, 0);
+      this->bump_version(real_index);
+      if (i != 0 || !keep_locked) {
+        this->unlock_index(real_index);
+      }
+      this->unlock_index(next_real_index);
+      this->meta_mutex_.lock();
+      --this->length_;
+      this->meta_mutex_.unlock();
+      return;
+    }
+    // I argue that this sliding is efficient if the average home has only a
+    // single element belonging to it. In this case, it would not have any
+    // elements belonging to the same home, over which it may leap-frog.
+    bkt = std::move(next_bkt);
+    --bkt.offset;
+    this->set_frequency(real_index, this->get_frequency(next_real_index));
+    this->set_expiry(real_index, this->get_expiry(next_real_index));
+    this->bump_version(real_index);
+    if (i != 0 || !keep_locked) {
+      this->unlock_index(real_index);
+    }
+  }
+  assert(0 && "impossible! Should have a hole");
+}
+
+bool
+ParallelRobinHoodHashTable::visit(KeyType key,
+                                  FunctionRef<MatchAction(ValueType &)> on_match,
+                                  FunctionRef<std::optional<ValueType>()> on_miss) {
+  LOG_TRACE("Enter");
+  HashCodeType hashcode = this->hasher_(key);
+  size_t home = get_home(hashcode, this->capacity_);
+  this->lock_profiler_.record_home(home);
+  if (this->is_striped()) {
+    return this->visit_striped(key, hashcode, home, on_match, on_miss);
+  }
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
+  switch (status) {
+    case SearchStatus::found_match: {
+      size_t real_index = get_real_index(home, offset, this->capacity_);
+      if (this->is_expired(real_index)) {
+        // Treat it as a miss, but reuse its slot if on_miss inserts.
+        this->expirations_.fetch_add(1, std::memory_order_relaxed);
+        const std::optional<ValueType> value = on_miss();
+        if (value.has_value()) {
+          this->get_bucket(real_index).value = value.value();
+          this->set_expiry(real_index, 0);
+          this->touch(real_index);
+          this->bump_version(real_index);
+          this->unlock_index(real_index);
+        } else {
+          this->erase_locked(home, offset);
+        }
+        return false;
+      }
+      if (on_match(this->get_bucket(real_index).value) == MatchAction::erase) {
+        this->erase_locked(home, offset);
+      } else {
+        // on_match may have changed the value.
+        this->touch(real_index);
+        this->bump_version(real_index);
+        this->unlock_index(real_index);
+      }
+      return true;
+    }
+    case SearchStatus::found_hole:
+    case SearchStatus::found_swap: {
+      const std::optional<ValueType> value = on_miss();
+      if (!value.has_value()) {
+        this->unlock_index(get_real_index(home, offset, this->capacity_));
+        return false;
+      }
+      // We still hold the lock on the bucket we stopped at, so nobody can
+      // insert key in between.
+      ParallelBucket tmp = {.key = key,
+                          .value = value.value(),
+                          .hashcode = hashcode,
+                          .offset = /*arbitrary value*/0,};
+      [[maybe_unused]] ErrorType e = this->insert_locked(tmp, 0, home, status, offset);
+      assert(e == ErrorType::ok && "error in insert_locked");
+      if (this->is_cache()) {
+        this->evict_to_capacity();
+      }
+      return false;
+    }
+    case SearchStatus::found_nohole:
+      assert(0 && "should not call this function if we need to resize!");
+    default:
+      assert(0 && "impossible");
+  }
+  assert(0 && "unreachable");
+}
+
+ValueType
+ParallelRobinHoodHashTable::fetch_add(KeyType key, ValueType delta) {
+  LOG_TRACE("Enter");
+  ValueType old = 0;
+  this->visit(key,
+      [&old, delta](ValueType &value) { old = value; value += delta; return MatchAction::keep; },
+      [delta]() -> std::optional<ValueType> { return delta; });
+  return old;
+}
+
+bool
+ParallelRobinHoodHashTable::compare_exchange(KeyType key, ValueType &expected, ValueType desired) {
+  LOG_TRACE("Enter");
+  bool exchanged = false;
+  this->visit(key,
+      [&expected, desired, &exchanged](ValueType &value) {
+        if (value == expected) {
+          value = desired;
+          exchanged = true;
+        } else {
+          expected = value;
+        }
+        return MatchAction::keep;
+      },
+      []() -> std::optional<ValueType> { return std::nullopt; });
+  return exchanged;
+}
+
+void
+ParallelRobinHoodHashTable::evict_to_capacity() {
+  LOG_TRACE("Enter");
+  while (true) {
+    this->meta_mutex_.lock();
+    const size_t length = this->length_;
+    this->meta_mutex_.unlock();
+    if (length <= this->options_.cache_capacity) {
+      return;
+    }
+    this->evict_one();
+  }
+}
+
+void
+ParallelRobinHoodHashTable::evict_one() {
+  LOG_TRACE("Enter");
+  while (true) {
+    const size_t begin = this->clock_hand_.fetch_add(clock_batch_size, std::memory_order_relaxed);
+    for (size_t i = begin; i < begin + clock_batch_size; ++i) {
+      const size_t index = i % this->capacity_;
+      std::atomic<uint8_t> &frequency = this->frequencies_[index];
+      const uint8_t f = frequency.load(std::memory_order_relaxed);
+      if (f == clock_empty) {
+        continue;
+      } else if (f != clock_unreferenced) {
+        // Give it another pass of the hand.
+        frequency.store(static_cast<uint8_t>(f - 1), std::memory_order_relaxed);
+        continue;
+      }
+      if (this->is_striped()) {
+        const bool evicted = this->erase_index_if_striped(index, [this, index](const ParallelBucket &bkt) {
+          return !bkt.is_empty() && this->get_frequency(index) == clock_unreferenced;
+        });
+        if (!evicted) {
+          continue;
+        }
+        this->evictions_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      this->lock_index(index);
+      const ParallelBucket &bkt = this->get_bucket(index);
+      // Re-check now that it cannot move: it may have been removed or
+      // referenced since we looked.
+      if (bkt.is_empty() || frequency.load(std::memory_order_relaxed) != clock_unreferenced) {
+        this->unlock_index(index);
+        continue;
+      }
+      LOG_TRACE("Evict {} from {}", bkt.key, index);
+      this->erase_locked(get_home(bkt.hashcode, this->capacity_), bkt.offset);
+      this->evictions_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+}
+
+size_t
+ParallelRobinHoodHashTable::expire_tick(const size_t max_slots) {
+  LOG_TRACE("Enter");
+  if (!this->options_.enable_ttl) {
+    return 0;
+  }
+  size_t num_expired = 0;
+  const size_t begin = this->sweep_cursor_.fetch_add(max_slots, std::memory_order_relaxed);
+  for (size_t i = begin; i < begin + max_slots; ++i) {
+    const size_t index = i % this->capacity_;
+    // Erasing shifts the next entry back into this slot, so look again.
+    while (this->is_expired(index)) {
+      if (this->is_striped()) {
+        const bool erased = this->erase_index_if_striped(index, [this, index](const ParallelBucket &bkt) {
+          return !bkt.is_empty() && this->is_expired(index);
+        });
+        if (!erased) {
+          break;
+        }
+        ++num_expired;
+        continue;
+      }
+      this->lock_index(index);
+      const ParallelBucket &bkt = this->get_bucket(index);
+      // Re-check now that it cannot move.
+      if (bkt.is_empty() || !this->is_expired(index)) {
+        this->unlock_index(index);
+        break;
+      }
+      this->erase_locked(get_home(bkt.hashcode, this->capacity_), bkt.offset);
+      ++num_expired;
+    }
+  }
+  this->expirations_.fetch_add(num_expired, std::memory_order_relaxed);
+  return num_expired;
+}
+
+void
+ParallelRobinHoodHashTable::start_expiry_sweeper(const std::chrono::milliseconds period,
+                                                 const size_t slots_per_tick) {
+  LOG_TRACE("Enter");
+  std::lock_guard<std::mutex> lock(this->sweeper_mutex_);
+  if (this->sweeper_.joinable()) {
+    return;
+  }
+  this->stop_sweeper_ = false;
+  this->sweeper_ = std::thread([this, period, slots_per_tick] {
+    std::unique_lock<std::mutex> lock(this->sweeper_mutex_);
+    while (!this->stop_sweeper_) {
+      this->sweeper_cv_.wait_for(lock, period, [this] { return this->stop_sweeper_; });
+      lock.unlock();
+      this->expire_tick(slots_per_tick);
+      lock.lock();
+    }
+  });
+}
+
+void
+ParallelRobinHoodHashTable::stop_expiry_sweeper() {
+  LOG_TRACE("Enter");
+  std::thread sweeper;
+  {
+    std::lock_guard<std::mutex> lock(this->sweeper_mutex_);
+    this->stop_sweeper_ = true;
+    sweeper = std::move(this->sweeper_);
+  }
+  this->sweeper_cv_.notify_all();
+  if (sweeper.joinable()) {
+    sweeper.join();
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// OPTIMISTIC INSERTS
+////////////////////////////////////////////////////////////////////////////////
+
+ParallelRobinHoodHashTable::InsertPlan
+ParallelRobinHoodHashTable::plan_insert(const KeyType key, const HashCodeType hashcode, const size_t home) {
+  LOG_TRACE("Enter");
+  for (OffsetType i = 0; i < this->capacity_; ++i) {
+    const ParallelBucket bkt = this->load_bucket(get_real_index(home, i, this->capacity_));
+    if (bkt.is_empty()) {
+      return {SearchStatus::found_hole, i, i};
+    } else if (bkt.offset < i) {
+      for (OffsetType j = i + 1; j < this->capacity_; ++j) {
+        if (this->load_bucket(get_real_index(home, j, this->capacity_)).is_empty()) {
+          return {SearchStatus::found_swap, i, j};
+        }
+      }
+      break;
+    } else if (bkt.equal_by_key(key, hashcode)) {
+      return {SearchStatus::found_match, i, i};
+    }
+  }
+  return {SearchStatus::found_nohole, offset_invalid, offset_invalid};
+}
+
+std::optional<ErrorType>
+ParallelRobinHoodHashTable::try_insert_optimistic(KeyType key,
+                                                  ValueType value,
+                                                  uint64_t expiry,
+                                                  const HashCodeType hashcode,
+                                                  const size_t home) {
+  LOG_TRACE("Enter");
+  for (size_t attempt = 0; attempt < max_optimistic_attempts; ++attempt) {
+    const InsertPlan plan = this->plan_insert(key, hashcode, home);
+    // Locking a window that wraps around would take the locks out of order.
+    if (plan.status == SearchStatus::found_nohole || home + plan.end >= this->capacity_) {
+      return std::nullopt;
+    }
+
+    const size_t last = home + plan.end;
+    bool inserted = false;
+    if (this->is_striped()) {
+      SegmentGuard guard(*this, home);
+      const size_t segment_size = size_t{1} << this->segment_shift_;
+      for (size_t i = home; i < last; i += segment_size) {
+        guard.cover(i);
+      }
+      guard.cover(last);
+      inserted = this->commit_insert_plan(key, value, expiry, hashcode, home, plan.end);
+    } else {
+      for (size_t i = home; i <= last; ++i) {
+        this->lock_index(i);
+      }
+      inserted = this->commit_insert_plan(key, value, expiry, hashcode, home, plan.end);
+      for (size_t i = home; i <= last; ++i) {
+        this->unlock_index(i);
+      }
+    }
+    if (inserted) {
+      return ErrorType::ok;
+    }
+    this->counters_.add_probe_retry();
+  }
+  return std::nullopt;
+}
+
+bool
+ParallelRobinHoodHashTable::commit_insert_plan(KeyType key,
+                                               ValueType value,
+                                               uint64_t expiry,
+                                               const HashCodeType hashcode,
+                                               const size_t home,
+                                               const OffsetType window_end) {
+  LOG_TRACE("Enter");
+  // The plan may have changed since we made it, but now that the window is
+  // locked, any plan that fits in it is exact.
+  const InsertPlan plan = this->plan_insert(key, hashcode, home);
+  if (plan.status == SearchStatus::found_nohole || plan.end > window_end) {
+    return false;
+  }
+  const size_t land = home + plan.offset;
+  if (plan.status == SearchStatus::found_match) {
+    this->get_bucket(land).value = value;
+    this->set_expiry(land, expiry);
+    this->touch(land);
+    this->bump_version(land);
+    return true;
+  }
+
+  // Shift [land, hole) up by one in a block. The entries after land belong to
+  // later homes, so each stays in order one bucket further from its home.
+  for (size_t i = home + plan.end; i > land; --i) {
+    ParallelBucket &bkt = this->get_bucket(i);
+    bkt = this->get_bucket(i - 1);
+    ++bkt.offset;
+    this->set_frequency(i, this->get_frequency(i - 1));
+    this->set_expiry(i, this->get_expiry(i - 1));
+    this->bump_version(i);
+  }
+  this->get_bucket(land) = {.key = key,
+                            .value = value,
+                            .hashcode = hashcode,
+                            .offset = plan.offset,};
+  // A new entry starts out referenced once, so the hand skips it once.
+  this->set_frequency(land, clock_unreferenced + 1);
+  this->set_expiry(land, expiry);
+  this->bump_version(land);
+  this->meta_mutex_.lock();
+  ++this->length_;
+  this->meta_mutex_.unlock();
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// FRONT CACHE
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  A key that this thread read recently, with the version of the
+///         region of buckets that it was read from.
+struct FrontCacheEntry {
+  /// The table that the entry belongs to; zero means none.
+  uint64_t table_id = 0;
+  uint64_t version = 0;
+  size_t index = 0;
+  KeyType key = 0;
+  ValueType value = 0;
+};
+
+/// Slots in each thread's (direct-mapped) front cache, shared by all tables.
+static constexpr size_t front_cache_slots = 256;
+
+static FrontCacheEntry &
+front_cache_slot(const HashCodeType hashcode) {
+  thread_local FrontCacheEntry cache[front_cache_slots];
+  return cache[hashcode % front_cache_slots];
+}
+
+uint64_t
+ParallelRobinHoodHashTable::next_table_id() {
+  static std::atomic<uint64_t> next_id = 1;
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::optional<ValueType>
+ParallelRobinHoodHashTable::front_cache_lookup(const KeyType key, const HashCodeType hashcode) {
+  LOG_TRACE("Enter");
+  const FrontCacheEntry &entry = front_cache_slot(hashcode);
+  if (entry.table_id != this->id_ || entry.key != key ||
+      this->region_version(entry.index) != entry.version) {
+    return std::nullopt;
+  }
+  // Nothing in the region has changed since we read the entry, so it is
+  // still in the same bucket.
+  if (this->is_expired(entry.index)) {
+    return std::nullopt;
+  }
+  this->touch(entry.index);
+  return entry.value;
+}
+
+void
+ParallelRobinHoodHashTable::front_cache_fill(const KeyType key,
+                                             const HashCodeType hashcode,
+                                             const ValueType value,
+                                             const size_t index,
+                                             const uint64_t version) {
+  if (this->options_.front_cache) {
+    front_cache_slot(hashcode) = {.table_id = this->id_,
+                                  .version = version,
+                                  .index = index,
+                                  .key = key,
+                                  .value = value,};
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// STRIPED MODE
+////////////////////////////////////////////////////////////////////////////////
+
+ParallelRobinHoodHashTable::SegmentGuard::SegmentGuard(ParallelRobinHoodHashTable &table, const size_t index)
+    : table_(table), first_(index >> table.segment_shift_), end_(first_ + 1) {
+  this->table_.lock_segment(this->first_);
+}
+
+ParallelRobinHoodHashTable::SegmentGuard::~SegmentGuard() {
+  for (size_t s = 0; s < this->wrapped_end_; ++s) {
+    this->table_.unlock_segment(s);
+  }
+  for (size_t s = this->first_; s < this->end_; ++s) {
+    this->table_.unlock_segment(s);
+  }
+}
+
+bool
+ParallelRobinHoodHashTable::SegmentGuard::cover(const size_t index) {
+  const size_t segment = index >> this->table_.segment_shift_;
+  if ((this->first_ <= segment && segment < this->end_) || segment < this->wrapped_end_) {
+    return true;
+  }
+  // Probe paths are contiguous, so this is the next segment up...
+  if (segment == this->end_) {
+    this->table_.lock_segment(segment);
+    ++this->end_;
+    return true;
+  }
+  // ... or, past the end of the table, the next one from the start. We hold
+  // higher segments than it, so waiting for it could deadlock.
+  assert(this->end_ == this->table_.segment_locks_.size() && segment == this->wrapped_end_ &&
+         segment < this->first_ && "probe path is not contiguous");
+  if (!this->table_.try_lock_segment(segment)) {
+    return false;
+  }
+  ++this->wrapped_end_;
+  return true;
+}
+
+void
+ParallelRobinHoodHashTable::SegmentGuard::relock() {
+  this->table_.counters_.add_probe_retry();
+  for (size_t s = this->first_; s < this->end_; ++s) {
+    this->table_.unlock_segment(s);
+  }
+  for (size_t s = 0; s < this->wrapped_end_; ++s) {
+    this->table_.unlock_segment(s);
+  }
+  // The segment that cover() failed to take.
+  ++this->wrapped_end_;
+  assert(this->wrapped_end_ <= this->first_ && "wrapped around the whole table");
+  for (size_t s = 0; s < this->wrapped_end_; ++s) {
+    this->table_.lock_segment(s);
+  }
+  for (size_t s = this->first_; s < this->end_; ++s) {
+    this->table_.lock_segment(s);
+  }
+}
+
+void
+ParallelRobinHoodHashTable::lock_segment(const size_t segment) {
+  std::mutex &mutex = this->segment_locks_[segment].mutex;
+  if constexpr (table_counters_enabled || lock_profiling_enabled) {
+    if (!mutex.try_lock()) {
+      this->counters_.add_contended_lock();
+      this->lock_profiler_.lock_contended(mutex, segment << this->segment_shift_);
+    }
+    this->counters_.add_lock_acquisition();
+    this->lock_profiler_.record_acquisition(segment << this->segment_shift_);
+  } else {
+    mutex.lock();
+  }
+}
+
+bool
+ParallelRobinHoodHashTable::try_lock_segment(const size_t segment) {
+  if (!this->segment_locks_[segment].mutex.try_lock()) {
+    this->counters_.add_contended_lock();
+    return false;
+  }
+  this->counters_.add_lock_acquisition();
+  this->lock_profiler_.record_acquisition(segment << this->segment_shift_);
+  return true;
+}
+
+void
+ParallelRobinHoodHashTable::unlock_segment(const size_t segment) {
+  this->segment_locks_[segment].mutex.unlock();
+}
+
+std::optional<std::pair<SearchStatus, OffsetType>>
+ParallelRobinHoodHashTable::probe_striped(SegmentGuard &guard,
+                                          const KeyType key,
+                                          const HashCodeType hashcode,
+                                          const size_t home) {
+  LOG_TRACE("Enter");
+  for (OffsetType i = 0; i < this->capacity_; ++i) {
+    const size_t real_index = get_real_index(home, i, this->capacity_);
+    if (!guard.cover(real_index)) {
+      return std::nullopt;
+    }
+    const ParallelBucket &bkt = this->get_bucket(real_index);
+    if (bkt.is_empty()) {
+      return std::pair{SearchStatus::found_hole, i};
+    } else if (!bkt.equal_by_key(key, hashcode) && this->is_expired(real_index)) {
+      // As in get_wouldbe_offset(), reclaim it and look at this bucket again.
+      if (!this->erase_striped_locked(home, i, guard)) {
+        return std::nullopt;
+      }
+      this->expirations_.fetch_add(1, std::memory_order_relaxed);
+      --i;
+      continue;
+    } else if (bkt.offset < i) {
+      return std::pair{SearchStatus::found_swap, i};
+    } else if (bkt.equal_by_key(key, hashcode)) {
+      return std::pair{SearchStatus::found_match, i};
+    }
+  }
+  return std::pair{SearchStatus::found_nohole, offset_invalid};
+}
+
+bool
+ParallelRobinHoodHashTable::cover_to_hole(SegmentGuard &guard, const size_t index) {
+  for (size_t i = (index + 1) % this->capacity_; ; i = (i + 1) % this->capacity_) {
+    if (!guard.cover(i)) {
+      return false;
+    }
+    if (this->get_bucket(i).is_empty()) {
+      return true;
+    }
+  }
+}
+
+bool
+ParallelRobinHoodHashTable::cover_shift_back(SegmentGuard &guard, const size_t index, size_t &last) {
+  last = index;
+  while (true) {
+    const size_t next = (last + 1) % this->capacity_;
+    if (!guard.cover(next)) {
+      return false;
+    }
+    const ParallelBucket &next_bkt = this->get_bucket(next);
+    if (next_bkt.is_empty() || next_bkt.offset == 0) {
+      return true;
+    }
+    last = next;
+  }
+}
+
+bool
+ParallelRobinHoodHashTable::insert_striped_locked(ParallelBucket tmp,
+                                                  uint64_t expiry,
+                                                  const size_t home,
+                                                  const SearchStatus status,
+                                                  const OffsetType offset,
+                                                  SegmentGuard &guard) {
+  LOG_TRACE("Enter");
+  size_t real_index = get_real_index(home, offset, this->capacity_);
+  switch (status) {
+    case SearchStatus::found_match: {
+      this->get_bucket(real_index).value = tmp.value;
+      this->set_expiry(real_index, expiry);
+      this->touch(real_index);
+      this->bump_version(real_index);
+      return true;
+    }
+    case SearchStatus::found_swap: {
+      // Cover the chain up to the first hole before we move anything.
+      if (!this->cover_to_hole(guard, real_index)) {
+        return false;
+      }
+      [[fallthrough]];
+    }
+    case SearchStatus::found_hole: {
+      // A new entry starts out referenced once, so the hand skips it once.
+      uint8_t frequency = clock_unreferenced + 1;
+      OffsetType distance = offset;
+      while (true) {
+        ParallelBucket &bkt = this->get_bucket(real_index);
+        if (bkt.is_empty()) {
+          tmp.offset = distance;
+          bkt = tmp;
+          this->set_frequency(real_index, frequency);
+          this->set_expiry(real_index, expiry);
+          this->bump_version(real_index);
+          break;
+        }
+        // As in insert_locked(), carry the displaced entry onwards rather
+        // than probing again from its home, which may lie below our segments.
+        if (bkt.offset < distance) {
+          tmp.offset = distance;
+          std::swap(bkt, tmp);
+          distance = tmp.offset;
+          const uint8_t displaced_frequency = this->get_frequency(real_index);
+          this->set_frequency(real_index, frequency);
+          frequency = displaced_frequency;
+          const uint64_t displaced_expiry = this->get_expiry(real_index);
+          this->set_expiry(real_index, expiry);
+          expiry = displaced_expiry;
+          this->bump_version(real_index);
+        }
+        real_index = (real_index + 1) % this->capacity_;
+        ++distance;
+      }
+      this->meta_mutex_.lock();
+      ++this->length_;
+      this->meta_mutex_.unlock();
+      return true;
+    }
+    case SearchStatus::found_nohole:
+      assert(0 && "should not call this function if we need to resize!");
+    default:
+      assert(0 && "impossible!");
+  }
+  return true;
+}
+
+bool
+ParallelRobinHoodHashTable::erase_striped_locked(const size_t home, const OffsetType offset, SegmentGuard &guard) {
+  LOG_TRACE("Enter");
+  const size_t first = get_real_index(home, offset, this->capacity_);
+  // Cover every entry that will shift back before we move anything.
+  size_t last = first;
+  if (!this->cover_shift_back(guard, first, last)) {
+    return false;
+  }
+
+  for (size_t index = first; index != last; index = (index + 1) % this->capacity_) {
+    const size_t next = (index + 1) % this->capacity_;
+    ParallelBucket &bkt = this->get_bucket(index);
+    bkt = this->get_bucket(next);
+    --bkt.offset;
+    this->set_frequency(index, this->get_frequency(next));
+    this->set_expiry(index, this->get_expiry(next));
+    this->bump_version(index);
+  }
+  this->get_bucket(last).invalidate();
+  this->set_frequency(last, clock_empty);
+  this->set_expiry(last, 0);
+  this->bump_version(last);
+  this->meta_mutex_.lock();
+  --this->length_;
+  this->meta_mutex_.unlock();
+  return true;
+}
+
+bool
+ParallelRobinHoodHashTable::erase_index_if_striped(const size_t index,
+                                                   FunctionRef<bool(const ParallelBucket &)> pred) {
+  LOG_TRACE("Enter");
+  SegmentGuard guard(*this, index);
+  while (true) {
+    // Re-check now that it cannot move.
+    const ParallelBucket &bkt = this->get_bucket(index);
+    if (!pred(bkt)) {
+      return false;
+    }
+    if (this->erase_striped_locked(get_home(bkt.hashcode, this->capacity_), bkt.offset, guard)) {
+      return true;
+    }
+    guard.relock();
+  }
+}
+
+ErrorType
+ParallelRobinHoodHashTable::insert_striped(KeyType key,
+                                           ValueType value,
+                                           uint64_t expiry,
+                                           const HashCodeType hashcode,
+                                           const size_t home) {
+  LOG_TRACE("Enter");
+  {
+    SegmentGuard guard(*this, home);
+    while (true) {
+      const auto probe = this->probe_striped(guard, key, hashcode, home);
+      if (probe.has_value()) {
+        const auto [status, offset] = probe.value();
+        const ParallelBucket tmp = {.key = key,
+                                    .value = value,
+                                    .hashcode = hashcode,
+                                    .offset = /*arbitrary value*/0,};
+        if (this->insert_striped_locked(tmp, expiry, home, status, offset, guard)) {
+          break;
+        }
+      }
+      guard.relock();
+    }
+  }
+  if (this->is_cache()) {
+    this->evict_to_capacity();
+  }
+  return ErrorType::ok;
+}
+
+std::optional<ValueType>
+ParallelRobinHoodHashTable::search_striped(KeyType key, const HashCodeType hashcode, const size_t home) {
+  LOG_TRACE("Enter");
+  SegmentGuard guard(*this, home);
+  while (true) {
+    const auto probe = this->probe_striped(guard, key, hashcode, home);
+    if (!probe.has_value()) {
+      guard.relock();
+      continue;
+    }
+    const auto [status, offset] = probe.value();
+    if (status != SearchStatus::found_match) {
+      return std::nullopt;
+    }
+    const size_t real_index = get_real_index(home, offset, this->capacity_);
+    if (this->is_expired(real_index)) {
+      if (!this->erase_striped_locked(home, offset, guard)) {
+        guard.relock();
+        continue;
+      }
+      this->expirations_.fetch_add(1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+    this->touch(real_index);
+    const ValueType value = this->get_bucket(real_index).value;
+    this->front_cache_fill(key, hashcode, value, real_index, this->region_version(real_index));
+    return value;
+  }
+}
+
+ErrorType
+ParallelRobinHoodHashTable::remove_striped(KeyType key, const HashCodeType hashcode, const size_t home) {
+  LOG_TRACE("Enter");
+  SegmentGuard guard(*this, home);
+  while (true) {
+    const auto probe = this->probe_striped(guard, key, hashcode, home);
+    if (!probe.has_value()) {
+      guard.relock();
+      continue;
+    }
+    const auto [status, offset] = probe.value();
+    if (status != SearchStatus::found_match) {
+      return ErrorType::e_notfound;
+    }
+    const bool expired = this->is_expired(get_real_index(home, offset, this->capacity_));
+    if (!this->erase_striped_locked(home, offset, guard)) {
+      guard.relock();
+      continue;
+    }
+    if (expired) {
+      this->expirations_.fetch_add(1, std::memory_order_relaxed);
+      return ErrorType::e_notfound;
+    }
+    return ErrorType::ok;
+  }
+}
+
+bool
+ParallelRobinHoodHashTable::visit_striped(KeyType key,
+                                          const HashCodeType hashcode,
+                                          const size_t home,
+                                          FunctionRef<MatchAction(ValueType &)> on_match,
+                                          FunctionRef<std::optional<ValueType>()> on_miss) {
+  LOG_TRACE("Enter");
+  bool found = false;
+  {
+    SegmentGuard guard(*this, home);
+    while (true) {
+      const auto probe = this->probe_striped(guard, key, hashcode, home);
+      if (!probe.has_value()) {
+        guard.relock();
+        continue;
+      }
+      const auto [status, offset] = probe.value();
+      const size_t real_index = get_real_index(home, offset, this->capacity_);
+      // Cover whatever on_match or on_miss may ask us to do before calling
+      // them, since we cannot start over once they have run.
+      size_t last = real_index;
+      const bool covered = status == SearchStatus::found_match ? this->cover_shift_back(guard, real_index, last) :
+                           status == SearchStatus::found_swap ? this->cover_to_hole(guard, real_index) : true;
+      if (!covered) {
+        guard.relock();
+        continue;
+      }
+
+      [[maybe_unused]] bool done = true;
+      if (status == SearchStatus::found_match && !this->is_expired(real_index)) {
+        if (on_match(this->get_bucket(real_index).value) == MatchAction::erase) {
+          done = this->erase_striped_locked(home, offset, guard);
+        } else {
+          // on_match may have changed the value.
+          this->touch(real_index);
+          this->bump_version(real_index);
+        }
+        found = true;
+      } else if (status == SearchStatus::found_match) {
+        // Treat it as a miss, but reuse its slot if on_miss inserts.
+        this->expirations_.fetch_add(1, std::memory_order_relaxed);
+        const std::optional<ValueType> value = on_miss();
+        if (value.has_value()) {
+          this->get_bucket(real_index).value = value.value();
+          this->set_expiry(real_index, 0);
+          this->touch(real_index);
+          this->bump_version(real_index);
+        } else {
+          done = this->erase_striped_locked(home, offset, guard);
+        }
+      } else {
+        const std::optional<ValueType> value = on_miss();
+        if (value.has_value()) {
+          const ParallelBucket tmp = {.key = key,
+                                      .value = value.value(),
+                                      .hashcode = hashcode,
+                                      .offset = /*arbitrary value*/0,};
+          done = this->insert_striped_locked(tmp, 0, home, status, offset, guard);
+        }
+      }
+      assert(done && "the path was covered");
+      break;
+    }
+  }
+  if (!found && this->is_cache()) {
+    this->evict_to_capacity();
+  }
+  return found;
+}
@@ -0,0 +1,133 @@
+#include <cassert>
+#include <utility>
+
+#include "common/logger.hpp"
+#include "reclamation/epoch.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// STATIC HELPER FUNCTIONS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Unique per domain, so that a thread's cached record for a destroyed
+///         domain can never match a new domain at the same address.
+static uint64_t
+next_domain_id() {
+  static std::atomic<uint64_t> next_id = 0;
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// EPOCH DOMAIN
+////////////////////////////////////////////////////////////////////////////////
+
+EpochDomain::Guard::Guard(EpochDomain &domain)
+    : domain_(domain) {
+  this->domain_.enter();
+}
+
+EpochDomain::Guard::~Guard() {
+  this->domain_.exit();
+}
+
+EpochDomain::EpochDomain()
+    : id_(next_domain_id()) {}
+
+EpochDomain::~EpochDomain() {
+  LOG_TRACE("Enter");
+  ThreadRecord *record = this->records_.load(std::memory_order_acquire);
+  while (record != nullptr) {
+    this->reclaim_until(*record, inactive);
+    ThreadRecord *next = record->next;
+    delete record;
+    record = next;
+  }
+}
+
+EpochDomain::ThreadRecord &
+EpochDomain::local_record() {
+  thread_local std::vector<std::pair<uint64_t, ThreadRecord *>> cache;
+  for (const auto &[id, record] : cache) {
+    if (id == this->id_) {
+      return *record;
+    }
+  }
+  ThreadRecord *record = new ThreadRecord();
+  record->next = this->records_.load(std::memory_order_relaxed);
+  while (!this->records_.compare_exchange_weak(record->next, record,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+    // Retry with the new head
+  }
+  cache.emplace_back(this->id_, record);
+  return *record;
+}
+
+void
+EpochDomain::enter() {
+  ThreadRecord &record = this->local_record();
+  if (record.nesting++ != 0) {
+    return;
+  }
+  record.epoch.store(this->global_epoch_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  // Our announcement must be visible before we load any shared pointer, or
+  // try_advance() could miss us and let a writer free what we are reading.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void
+EpochDomain::exit() {
+  ThreadRecord &record = this->local_record();
+  assert(record.nesting != 0 && "unbalanced exit");
+  if (--record.nesting == 0) {
+    record.epoch.store(inactive, std::memory_order_release);
+  }
+}
+
+void
+EpochDomain::retire(void *object, Reclaimer reclaim, void *context) {
+  LOG_TRACE("Enter");
+  ThreadRecord &record = this->local_record();
+  record.retired.push_back({object, reclaim, context, this->global_epoch_.load(std::memory_order_acquire)});
+  this->num_retired_.fetch_add(1, std::memory_order_relaxed);
+  if (record.retired.size() % collect_threshold == 0) {
+    this->collect();
+  }
+}
+
+bool
+EpochDomain::try_advance() {
+  LOG_TRACE("Enter");
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  uint64_t epoch = this->global_epoch_.load(std::memory_order_acquire);
+  for (ThreadRecord *r = this->records_.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+    const uint64_t e = r->epoch.load(std::memory_order_acquire);
+    if (e != inactive && e != epoch) {
+      return false;
+    }
+  }
+  return this->global_epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+}
+
+void
+EpochDomain::collect() {
+  LOG_TRACE("Enter");
+  this->try_advance();
+  const uint64_t epoch = this->global_epoch_.load(std::memory_order_acquire);
+  if (epoch >= 2) {
+    this->reclaim_until(this->local_record(), epoch - 2);
+  }
+}
+
+void
+EpochDomain::reclaim_until(ThreadRecord &record, const uint64_t safe_epoch) {
+  // The list is in retirement order, so the reclaimable objects are a prefix.
+  auto it = record.retired.begin();
+  for (; it != record.retired.end() && it->epoch <= safe_epoch; ++it) {
+    it->reclaim(it->object, it->context);
+  }
+  const auto num_reclaimed = static_cast<uint64_t>(it - record.retired.begin());
+  record.retired.erase(record.retired.begin(), it);
+  this->num_reclaimed_.fetch_add(num_reclaimed, std::memory_order_relaxed);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// EPOCH-BASED RECLAMATION
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Frees retired objects once no reader can still hold a pointer to
+///         them.
+///
+/// Readers pin() the domain for as long as they use pointers they loaded from
+/// a shared structure. Writers unlink an object and then retire() it instead
+/// of freeing it. The domain keeps a global epoch; a pinned thread announces
+/// the epoch it saw. The epoch only advances once every pinned thread has
+/// seen the current one, so an object retired in epoch e is unreachable by
+/// every reader once the global epoch reaches e + 2.
+///
+/// N.B.  Each thread that uses a domain registers a record with it on first
+///       use. The records (and any objects their threads retired but that were
+///       not yet reclaimed) are only freed when the domain is destroyed, and
+///       nobody may use the domain at that point.
+class EpochDomain {
+public:
+  /// @brief  How to free a retired object. The context is passed through
+  ///         unchanged (e.g. the structure the object belonged to).
+  using Reclaimer = void (*)(void *object, void *context);
+
+  /// @brief  RAII pin. Pointers loaded while this is alive stay valid until it
+  ///         is destroyed. Pins nest.
+  class Guard {
+  public:
+    explicit Guard(EpochDomain &domain);
+    ~Guard();
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+  private:
+    EpochDomain &domain_;
+  };
+
+  EpochDomain();
+  ~EpochDomain();
+
+  EpochDomain(const EpochDomain &) = delete;
+  EpochDomain &operator=(const EpochDomain &) = delete;
+
+  Guard
+  pin()
+  {
+    return Guard(*this);
+  }
+
+  /// @brief  Free object with reclaim(object, context) once no reader that is
+  ///         currently pinned can still see it. The caller must have already
+  ///         made object unreachable.
+  void
+  retire(void *object, Reclaimer reclaim, void *context = nullptr);
+
+  template<typename T>
+  void
+  retire(T *object)
+  {
+    this->retire(static_cast<void *>(object), [](void *o, void *) { delete static_cast<T *>(o); });
+  }
+
+  /// @brief  Try to advance the epoch, then reclaim whatever this thread
+  ///         retired that is now safe. retire() calls this periodically.
+  void
+  collect();
+
+  uint64_t
+  num_retired() const
+  {
+    return this->num_retired_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t
+  num_reclaimed() const
+  {
+    return this->num_reclaimed_.load(std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr uint64_t inactive = std::numeric_limits<uint64_t>::max();
+  /// Each thread tries to collect after retiring this many objects.
+  static constexpr size_t collect_threshold = 64;
+
+  struct Retired {
+    void *object;
+    Reclaimer reclaim;
+    void *context;
+    uint64_t epoch;
+  };
+
+  struct alignas(64) ThreadRecord {
+    /// The epoch this thread saw when it pinned, or `inactive`.
+    std::atomic<uint64_t> epoch = inactive;
+    /// Only touched by the owning thread.
+    size_t nesting = 0;
+    std::vector<Retired> retired = {};
+    ThreadRecord *next = nullptr;
+  };
+
+  ThreadRecord &
+  local_record();
+
+  void
+  enter();
+
+  void
+  exit();
+
+  bool
+  try_advance();
+
+  void
+  reclaim_until(ThreadRecord &record, uint64_t safe_epoch);
+
+  const uint64_t id_;
+  std::atomic<uint64_t> global_epoch_ = 0;
+  /// Push-only list of every thread that has used this domain.
+  std::atomic<ThreadRecord *> records_ = nullptr;
+  std::atomic<uint64_t> num_retired_ = 0;
+  std::atomic<uint64_t> num_reclaimed_ = 0;
+};
@@ -1,15 +1,25 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <iterator>
 #include <optional>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "common/engine.hpp"
 #include "common/logger.hpp"
+#include "common/stats.hpp"
 #include "common/status.hpp"
 #include "common/types.hpp"
+#include "utility/blocked_counting_filter.hpp"
+#include "utility/count_min_sketch.hpp"
+#include "utility/function_ref.hpp"
+#include "utility/parallel_for.hpp"
+#include "utility/relaxed_counter.hpp"
 #include "utility/utility.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -43,6 +53,25 @@ struct SequentialBucket {
   print(const size_t capacity) const;
 };
 
+/// @brief  Options for SequentialRobinHoodHashTable. The defaults give the
+///         plain table.
+struct SequentialTableOptions {
+  /// The number of buckets to start with. The table doubles it as it fills,
+  /// so this only matters for small tables (e.g. one of many partitions),
+  /// which need not pay for the default up front.
+  size_t initial_capacity = 1<<20;
+  /// If nonzero, count every this-many-th search in a count-min sketch of the
+  /// hash codes, and order the entries that share a home bucket from hottest
+  /// to coldest as they are inserted or displaced. Robin Hood order only fixes
+  /// which home's entries come first, so this is free to choose within a
+  /// home, and the hot keys of a skewed workload are then found first.
+  size_t heat_sample_period = 0;
+  /// Keep a counting Bloom filter of the keys, one cache line per 16 home
+  /// buckets, so that a search or remove for an absent key is usually
+  /// rejected after reading that line instead of walking the key's cluster.
+  bool miss_filter = false;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 /// STATIC HELPER FUNCTIONS
 ////////////////////////////////////////////////////////////////////////////////
@@ -59,12 +88,26 @@ get_wouldbe_offset(const std::vector<SequentialBucket> &buckets_buf,
                    const HashCodeType hashcode,
                    const size_t home);
 
+/// @brief  Get the first offset before end_offset that holds a colder entry
+///         of the same home, i.e. where an entry with this heat should go
+///         instead. Return end_offset if there is none.
+size_t
+get_hotter_offset(const std::vector<SequentialBucket> &buckets_buf,
+                  const size_t home,
+                  const size_t end_offset,
+                  const CountMinSketch &sketch,
+                  const uint16_t heat);
+
 /// @brief  Insert but assume no resize is necessary.
+///
+/// If sketch is given, an entry whose probe distance ties with a resident's
+/// takes the resident's place when it is hotter.
 ErrorType
 insert_without_resize(      std::vector<SequentialBucket> &tmp_buckets,
                       const KeyType key,
                       const ValueType value,
-                      const HashCodeType hashcode);
+                      const HashCodeType hashcode,
+                      const CountMinSketch *sketch = nullptr);
 
 ////////////////////////////////////////////////////////////////////////////////
 /// HASH TABLE CLASS
@@ -72,6 +115,85 @@ insert_without_resize(      std::vector<SequentialBucket> &tmp_buckets,
 
 class SequentialRobinHoodHashTable {
 public:
+  static constexpr EngineCapabilities capabilities = {.thread_safe = false, .resizable = true, .batched = true};
+
+  /// @brief  Forward iterator over the occupied buckets. This is zero-copy: it
+  ///         yields references to the buckets themselves, so read `key` and
+  ///         `value` from them. Any insert or remove invalidates it.
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = SequentialBucket;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const SequentialBucket *;
+    using reference = const SequentialBucket &;
+
+    const_iterator() = default;
+
+    reference
+    operator*() const
+    {
+      return *this->it_;
+    }
+
+    pointer
+    operator->() const
+    {
+      return &*this->it_;
+    }
+
+    const_iterator &
+    operator++()
+    {
+      ++this->it_;
+      this->skip_empty();
+      return *this;
+    }
+
+    const_iterator
+    operator++(int)
+    {
+      const_iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool
+    operator==(const const_iterator &other) const
+    {
+      return this->it_ == other.it_;
+    }
+
+  private:
+    friend class SequentialRobinHoodHashTable;
+    using BucketIterator = std::vector<SequentialBucket>::const_iterator;
+
+    const_iterator(const BucketIterator it, const BucketIterator end)
+        : it_(it), end_(end)
+    {
+      this->skip_empty();
+    }
+
+    void
+    skip_empty()
+    {
+      while (this->it_ != this->end_ && this->it_->is_empty()) {
+        ++this->it_;
+      }
+    }
+
+    BucketIterator it_ = {};
+    BucketIterator end_ = {};
+  };
+
+  /// @brief  Construct with a random hash seed.
+  SequentialRobinHoodHashTable() = default;
+
+  /// @brief  Construct with a fixed hash seed (e.g. for reproducible layouts).
+  explicit SequentialRobinHoodHashTable(const uint64_t hash_seed);
+
+  explicit SequentialRobinHoodHashTable(const SequentialTableOptions &options);
+
   void
   print() const;
 
@@ -88,6 +210,13 @@ public:
   std::optional<ValueType>
   search(KeyType key) const;
 
+  /// @brief Search for a batch of keys.
+  ///
+  /// Keys are hashed in groups with hash_batch and each group's home buckets
+  /// are prefetched before probing, so their cache misses overlap.
+  void
+  search_batch(const KeyType *keys, const size_t num_keys, std::optional<ValueType> *results) const;
+
   /// @brief Remove <key, value> pair.
   /// N.B. 'delete' is a keyword, so I used 'remove'.
   ///
@@ -95,17 +224,184 @@ public:
   ErrorType
   remove(KeyType key);
 
+  /// @brief  If key is present, replace its value with update(value);
+  ///         otherwise, insert <key, value>.
+  ///
+  /// @return the value now stored for key.
+  template<typename Fn>
+  ValueType
+  upsert(KeyType key, ValueType value, Fn &&update)
+  {
+    ValueType result = value;
+    this->visit(key,
+        [&update, &result](ValueType &v) { v = update(v); result = v; return MatchAction::keep; },
+        [value]() -> std::optional<ValueType> { return value; });
+    return result;
+  }
+
+  /// @brief  Add delta to key's value, inserting <key, delta> if it is absent.
+  ///
+  /// @return the previous value (or 0 if key was absent).
+  ValueType
+  fetch_add(KeyType key, ValueType delta);
+
+  /// @brief  If key's value equals expected, replace it with desired.
+  ///         Otherwise, load the current value into expected.
+  ///
+  /// @return whether the value was replaced (false if key is absent).
+  bool
+  compare_exchange(KeyType key, ValueType &expected, ValueType desired);
+
+  /// @brief  Return key's value, inserting <key, fn()> if it is absent.
+  template<typename Fn>
+  ValueType
+  compute_if_absent(KeyType key, Fn &&fn)
+  {
+    ValueType result = 0;
+    this->visit(key,
+        [&result](ValueType &v) { result = v; return MatchAction::keep; },
+        [&fn, &result]() -> std::optional<ValueType> { result = fn(); return result; });
+    return result;
+  }
+
+  /// @brief  Remove key if pred(value) is true.
+  ///
+  /// @return 0 if removed; 1 otherwise.
+  template<typename Pred>
+  ErrorType
+  erase_if(KeyType key, Pred &&pred)
+  {
+    bool erased = false;
+    this->visit(key,
+        [&pred, &erased](ValueType &v) {
+          erased = pred(static_cast<const ValueType &>(v));
+          return erased ? MatchAction::erase : MatchAction::keep;
+        },
+        []() -> std::optional<ValueType> { return std::nullopt; });
+    return erased ? ErrorType::ok : ErrorType::e_notfound;
+  }
+
   std::vector<ValueType> 
   getElements() const;
 
+  const_iterator
+  begin() const
+  {
+    return const_iterator(this->buckets_.begin(), this->buckets_.end());
+  }
+
+  const_iterator
+  end() const
+  {
+    return const_iterator(this->buckets_.end(), this->buckets_.end());
+  }
+
+  /// @brief  Call fn(key, value) on every entry.
+  template<typename Fn>
+  void
+  for_each(Fn &&fn) const
+  {
+    this->for_each_in_range(0, this->capacity_, fn);
+  }
+
+  /// @brief  Call fn(key, value) on every entry, splitting the bucket array
+  ///         into num_threads ranges. fn must be safe to call concurrently.
+  template<typename Fn>
+  void
+  parallel_for_each(Fn &&fn, const size_t num_threads) const
+  {
+    parallel_for_ranges(this->capacity_, num_threads, [this, &fn](const size_t begin, const size_t end) {
+      this->for_each_in_range(begin, end, fn);
+    });
+  }
+
+  /// @brief  Summarize the table's shape (see TableStats).
+  TableStats
+  stats() const;
 
+  /// @brief  Get the number of entries.
+  size_t
+  size() const;
+
+  /// @brief  Get the index of key's home bucket, e.g. to order a batch of
+  ///         operations by where they land. Any resize invalidates it.
+  size_t
+  home_of(KeyType key) const;
 
 private:
   std::vector<SequentialBucket> buckets_{1<<20};
   size_t length_ = 0;
   size_t capacity_ = 1<<20;
+  DefaultHash hasher_{random_hash_seed()};
+  /// Search counts for skew-aware placement (empty if it is disabled). The
+  /// searches are logically const, so these are mutable. Like any const
+  /// method, search() may run in concurrent threads, so everything it writes
+  /// is a RelaxedCounter (which, unlike std::atomic, keeps the table
+  /// copyable): concurrent searches may lose counts, but the counts are
+  /// approximate anyway.
+  mutable CountMinSketch heat_;
+  size_t heat_sample_period_ = 0;
+  mutable RelaxedCounter<size_t> searches_until_sample_;
+  /// The keys whose homes are in [16 * i, 16 * (i + 1)) are in block i (empty
+  /// if the filter is disabled).
+  static constexpr size_t homes_per_filter_block = 16;
+  BlockedCountingFilter miss_filter_;
+  mutable RelaxedCounter<uint64_t> filtered_misses_;
 
   ErrorType
   resize(size_t new_size);
 
+  /// @brief  Count one search for hashcode, if this one is sampled.
+  void
+  sample_search(const HashCodeType hashcode) const;
+
+  /// @brief  The sketch to order entries by, or nullptr if disabled.
+  const CountMinSketch *
+  placement_sketch() const;
+
+  /// @brief  Whether the miss filter shows that the key with this hash code
+  ///         (and home) is absent. Always false if the filter is disabled.
+  bool
+  filter_rejects(const HashCodeType hashcode, const size_t home) const;
+
+  /// @brief  Count a search that the miss filter rejected (approximately; see
+  ///         heat_).
+  void
+  count_filtered_miss() const;
+
+  /// @brief  Clear the miss filter (for the current capacity) and add every
+  ///         entry to it.
+  void
+  rebuild_miss_filter();
+
+  /// @brief  Find key. If it is present, call on_match(value), which may modify
+  ///         value in place or ask for the entry to be erased. Otherwise, call
+  ///         on_miss() and insert the value it returns, if any.
+  ///
+  /// @return whether key was present.
+  bool
+  visit(KeyType key,
+        FunctionRef<MatchAction(ValueType &)> on_match,
+        FunctionRef<std::optional<ValueType>()> on_miss);
+
+  /// @brief  Remove the entry at (home, offset) by shifting its successors back.
+  void
+  erase_at(const size_t home, const size_t offset);
+
+  template<typename Fn>
+  void
+  for_each_in_range(const size_t begin, const size_t end, Fn &fn) const
+  {
+    for (size_t i = begin; i < end; ++i) {
+      const SequentialBucket &bkt = this->buckets_[i];
+      if (!bkt.is_empty()) {
+        fn(bkt.key, bkt.value);
+      }
+    }
+  }
 };
+
+static_assert(HashTableEngine<SequentialRobinHoodHashTable>);
+static_assert(std::is_copy_constructible_v<SequentialRobinHoodHashTable> &&
+              std::is_copy_assignable_v<SequentialRobinHoodHashTable>,
+              "keep the table a value type");
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <iostream>
 #include <optional>
 
@@ -23,6 +24,39 @@ int main() {
     }
   }
 
+  // Batched search
+  KeyType keys[11];
+  std::optional<ValueType> values[11];
+  for (KeyType i = 0; i < 11; ++i) {
+    keys[i] = i;
+  }
+  a.search_batch(keys, 11, values);
+  for (size_t i = 0; i < 11; ++i) {
+    std::cout << "Batch lookup (" << values[i].has_value() << ") " << keys[i] << "\n";
+  }
+
+  // Read-modify-write
+  std::cout << "Fetch-add (" << a.fetch_add(10, 5) << "): 10 += 5\n";
+  ValueType expected = 5;
+  bool exchanged = a.compare_exchange(10, expected, 7);
+  std::cout << "Compare-exchange (" << exchanged << "): 10: 5 -> 7\n";
+  std::cout << "Compute-if-absent: 11: " << a.compute_if_absent(11, []() { return ValueType{11}; }) << "\n";
+  std::cout << "Upsert: 11: " << a.upsert(11, 0, [](ValueType v) { return v * 2; }) << "\n";
+  std::cout << "Erase-if (" << static_cast<int>(a.erase_if(11, [](ValueType v) { return v == 22; })) << "): 11\n";
+
+  // Iterate
+  std::atomic<size_t> num_visited = 0;
+  a.parallel_for_each([&num_visited](const KeyType, const ValueType) {
+    num_visited.fetch_add(1, std::memory_order_relaxed);
+  }, 4);
+  std::cout << "Visited " << num_visited.load() << " pairs with 4 threads\n";
+  for (const SequentialBucket &bkt : a) {
+    std::cout << "Iterator: <" << bkt.key << ", " << bkt.value << ">\n";
+  }
+
+  // Statistics
+  a.stats().print(std::cout);
+
   // Remove
   for (uint64_t i = 0; i < 11; ++i) {
     ErrorType e = a.remove(i);
@@ -80,11 +80,31 @@ get_wouldbe_offset(const std::vector<SequentialBucket> &buckets_buf,
   return {SearchStatus::found_nohole, SIZE_MAX};
 }
 
+size_t
+get_hotter_offset(const std::vector<SequentialBucket> &buckets_buf,
+                  const size_t home,
+                  const size_t end_offset,
+                  const CountMinSketch &sketch,
+                  const uint16_t heat) {
+  LOG_TRACE("Enter");
+  const size_t capacity = buckets_buf.size();
+  for (size_t i = 0; i < end_offset; ++i) {
+    const SequentialBucket &bkt = buckets_buf[get_real_index(home, i, capacity)];
+    // Before end_offset, an entry at its own probe distance shares our home;
+    // the others belong to earlier homes and must stay ahead of us.
+    if (bkt.offset == i && sketch.estimate(bkt.hashcode) < heat) {
+      return i;
+    }
+  }
+  return end_offset;
+}
+
 ErrorType
 insert_without_resize(      std::vector<SequentialBucket> &tmp_buckets,
                       const KeyType key,
                       const ValueType value,
-                      const HashCodeType hashcode) {
+                      const HashCodeType hashcode,
+                      const CountMinSketch *sketch) {
   LOG_TRACE("Enter");
   SequentialBucket tmp = {.key = key,
                           .value = value,
@@ -96,17 +116,27 @@ insert_without_resize(      std::vector<SequentialBucket> &tmp_buckets,
   // (if they are all sitting in a row) to insert something.
   while (true) {
     size_t home = get_home(tmp.hashcode, capacity);
-    const auto [status, offset] = get_wouldbe_offset(tmp_buckets, tmp.key, tmp.hashcode, home);
+    auto [status, offset] = get_wouldbe_offset(tmp_buckets, tmp.key, tmp.hashcode, home);
+    // Only once the key is known to be absent may a tie go to the hotter entry;
+    // otherwise we could place it ahead of its own older copy.
+    if (sketch != nullptr && (status == SearchStatus::found_swap || status == SearchStatus::found_hole)) {
+      const size_t hotter_offset = get_hotter_offset(tmp_buckets, home, offset, *sketch,
+                                                     sketch->estimate(tmp.hashcode));
+      if (hotter_offset != offset) {
+        status = SearchStatus::found_swap;
+        offset = hotter_offset;
+      }
+    }
     switch (status) {
       case SearchStatus::found_match: {
-        LOG_DEBUG("SearchStatus::found_match");
+        LOG_TRACE("SearchStatus::found_match");
         size_t real_index = get_real_index(home, offset, capacity);
         SequentialBucket &bkt = tmp_buckets[real_index];
         bkt.value = tmp.value;
         return ErrorType::ok;
       }
       case SearchStatus::found_swap: {
-        LOG_DEBUG("SearchStatus::found_swap");
+        LOG_TRACE("SearchStatus::found_swap");
         // NOTE(dchu): could be buggy
         size_t real_index = get_real_index(home, offset, capacity);
         SequentialBucket &bkt = tmp_buckets[real_index];
@@ -115,7 +145,7 @@ insert_without_resize(      std::vector<SequentialBucket> &tmp_buckets,
         continue;
       }
       case SearchStatus::found_hole: {
-        LOG_DEBUG("SearchStatus::found_hole");
+        LOG_TRACE("SearchStatus::found_hole");
         // NOTE(dchu): could be buggy
         size_t real_index = get_real_index(home, offset, capacity);
         SequentialBucket &bkt = tmp_buckets[real_index];
@@ -137,6 +167,22 @@ insert_without_resize(      std::vector<SequentialBucket> &tmp_buckets,
 /// HASH TABLE CLASS
 ////////////////////////////////////////////////////////////////////////////////
 
+SequentialRobinHoodHashTable::SequentialRobinHoodHashTable(const uint64_t hash_seed)
+    : hasher_(hash_seed) {}
+
+SequentialRobinHoodHashTable::SequentialRobinHoodHashTable(const SequentialTableOptions &options)
+    : buckets_(options.initial_capacity),
+      capacity_(options.initial_capacity),
+      // 4 rows of 1024 counters: 8 KiB, which stays in cache.
+      heat_(options.heat_sample_period != 0 ? CountMinSketch(10) : CountMinSketch()),
+      heat_sample_period_(options.heat_sample_period),
+      searches_until_sample_(options.heat_sample_period) {
+  assert(options.initial_capacity != 0 && "a table needs at least one bucket");
+  if (options.miss_filter) {
+    this->rebuild_miss_filter();
+  }
+}
+
 void
 SequentialRobinHoodHashTable::print() const {
   LOG_TRACE("Enter");
@@ -150,6 +196,42 @@ SequentialRobinHoodHashTable::print() const {
   std::cout << "]" << std::endl;
 }
 
+std::vector<ValueType>
+SequentialRobinHoodHashTable::getElements() const {
+  LOG_TRACE("Enter");
+  std::vector<ValueType> values;
+  values.reserve(this->length_);
+  for (const SequentialBucket &bkt : *this) {
+    values.push_back(bkt.value);
+  }
+  return values;
+}
+
+TableStats
+SequentialRobinHoodHashTable::stats() const {
+  LOG_TRACE("Enter");
+  TableStatsCollector collector(this->capacity_);
+  for (const auto &bkt : this->buckets_) {
+    collector.visit(!bkt.is_empty(), bkt.offset);
+  }
+  TableStats stats = collector.finish(sizeof(*this) + this->buckets_.capacity() * sizeof(SequentialBucket) +
+                                      this->miss_filter_.bytes_used());
+  stats.miss_filter_enabled = !this->miss_filter_.empty();
+  stats.filtered_misses = this->filtered_misses_.load();
+  return stats;
+}
+
+size_t
+SequentialRobinHoodHashTable::size() const {
+  LOG_TRACE("Enter");
+  return this->length_;
+}
+
+size_t
+SequentialRobinHoodHashTable::home_of(KeyType key) const {
+  return get_home(this->hasher_(key), this->capacity_);
+}
+
 ErrorType
 SequentialRobinHoodHashTable::insert(KeyType key, ValueType value) {
   LOG_TRACE("Enter");
@@ -159,27 +241,31 @@ SequentialRobinHoodHashTable::insert(KeyType key, ValueType value) {
   // 3.   If not, check if room to insert
   // 4.     If not, resize
   // 5. Insert (with swapping if necessary)
-  HashCodeType hashcode = hash(key);
+  HashCodeType hashcode = this->hasher_(key);
   size_t home = get_home(hashcode, this->capacity_);
 
   const auto [status, offset] = get_wouldbe_offset(this->buckets_, key, hashcode, home);
   switch (status) {
   case SearchStatus::found_match: {
-    LOG_DEBUG("SearchStatus::found_match");
-    ErrorType e = insert_without_resize(this->buckets_, key, value, hashcode);
+    LOG_TRACE("SearchStatus::found_match");
+    ErrorType e = insert_without_resize(this->buckets_, key, value, hashcode, this->placement_sketch());
     assert(e == ErrorType::ok && "error in insert_without_resize");
     return e;
   }
   case SearchStatus::found_hole: {
-    LOG_DEBUG("SearchStatus::found_hole");
-    ErrorType e = insert_without_resize(this->buckets_, key, value, hashcode);
+    LOG_TRACE("SearchStatus::found_hole");
+    ErrorType e = insert_without_resize(this->buckets_, key, value, hashcode, this->placement_sketch());
     assert(e == ErrorType::ok && "error in insert_without_resize");
     ++this->length_;
+    if (!this->miss_filter_.empty()) {
+      // After any resize, so the block is for the current capacity.
+      this->miss_filter_.add(get_home(hashcode, this->capacity_) / homes_per_filter_block, hashcode);
+    }
     return e;
   }
   case SearchStatus::found_swap:
   case SearchStatus::found_nohole: {
-    LOG_DEBUG("SearchStatus::FOUND_{SWAP,NOHOLE}");
+    LOG_TRACE("SearchStatus::FOUND_{SWAP,NOHOLE}");
     // Ensure suitably empty and there is at least one hole
     if (static_cast<double>(this->length_) >= 0.9 * static_cast<double>(this->capacity_) ||
         this->length_ + 1 >= this->capacity_) {
@@ -187,9 +273,13 @@ SequentialRobinHoodHashTable::insert(KeyType key, ValueType value) {
       assert(e == ErrorType::ok && "error in resize");
     }
 
-    ErrorType e = insert_without_resize(this->buckets_, key, value, hashcode);
+    ErrorType e = insert_without_resize(this->buckets_, key, value, hashcode, this->placement_sketch());
     assert(e == ErrorType::ok && "error in insert_without_resize");
     ++this->length_;
+    if (!this->miss_filter_.empty()) {
+      // After any resize, so the block is for the current capacity.
+      this->miss_filter_.add(get_home(hashcode, this->capacity_) / homes_per_filter_block, hashcode);
+    }
     return e;
   }
   default:
@@ -201,8 +291,13 @@ SequentialRobinHoodHashTable::insert(KeyType key, ValueType value) {
 std::optional<ValueType>
 SequentialRobinHoodHashTable::search(KeyType key) const {
   LOG_TRACE("Enter");
-  HashCodeType hashcode = hash(key);
+  HashCodeType hashcode = this->hasher_(key);
   size_t home = get_home(hashcode, this->capacity_);
+  this->sample_search(hashcode);
+  if (this->filter_rejects(hashcode, home)) {
+    this->count_filtered_miss();
+    return std::nullopt;
+  }
 
   const auto [status, offset] = get_wouldbe_offset(this->buckets_, key, hashcode, home);
   switch (status) {
@@ -221,35 +316,61 @@ SequentialRobinHoodHashTable::search(KeyType key) const {
   assert(0 && "unreachable");
 }
 
+void
+SequentialRobinHoodHashTable::search_batch(const KeyType *keys,
+                                           const size_t num_keys,
+                                           std::optional<ValueType> *results) const {
+  LOG_TRACE("Enter");
+  constexpr size_t batch_size = 8;
+  HashCodeType hashcodes[batch_size];
+  size_t homes[batch_size];
+  for (size_t base = 0; base < num_keys; base += batch_size) {
+    const size_t n = std::min(batch_size, num_keys - base);
+    if (n == batch_size) {
+      hash_batch<batch_size>(this->hasher_, &keys[base], hashcodes);
+    } else {
+      for (size_t i = 0; i < n; ++i) {
+        hashcodes[i] = this->hasher_(keys[base + i]);
+      }
+    }
+    for (size_t i = 0; i < n; ++i) {
+      homes[i] = get_home(hashcodes[i], this->capacity_);
+      __builtin_prefetch(&this->buckets_[homes[i]]);
+      if (!this->miss_filter_.empty()) {
+        this->miss_filter_.prefetch(homes[i] / homes_per_filter_block);
+      }
+      this->sample_search(hashcodes[i]);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      if (this->filter_rejects(hashcodes[i], homes[i])) {
+        this->count_filtered_miss();
+        results[base + i] = std::nullopt;
+        continue;
+      }
+      const auto [status, offset] = get_wouldbe_offset(this->buckets_, keys[base + i], hashcodes[i], homes[i]);
+      if (status == SearchStatus::found_match) {
+        results[base + i] = this->buckets_[get_real_index(homes[i], offset, this->capacity_)].value;
+      } else {
+        results[base + i] = std::nullopt;
+      }
+    }
+  }
+}
+
 ErrorType
 SequentialRobinHoodHashTable::remove(KeyType key) {
   LOG_TRACE("Enter");
-  HashCodeType hashcode = hash(key);
+  HashCodeType hashcode = this->hasher_(key);
   size_t home = get_home(hashcode, this->capacity_);
+  if (this->filter_rejects(hashcode, home)) {
+    return ErrorType::e_notfound;
+  }
 
   const auto [status, offset] = get_wouldbe_offset(this->buckets_, key, hashcode, home);
   switch (status) {
-    case SearchStatus::found_match: {
-      for (size_t i = 0; i < this->capacity_; ++i) {
-        // NOTE(dchu): real_index is the previous iteration's next_real_index
-        size_t real_index = get_real_index(home, offset + i, this->capacity_);
-        SequentialBucket &bkt = this->buckets_[real_index];
-        size_t next_real_index = get_real_index(home, offset + i + 1, this->capacity_);
-        SequentialBucket &next_bkt = this->buckets_[next_real_index];
-        // Next element is empty or already in its home bucket
-        if (next_bkt.is_empty() || next_bkt.offset == 0) {
-          bkt.invalidate();
-          --this->length_;
-          return ErrorType::ok;
-        }
-        // I argue that this sliding is efficient if the average home has only a
-        // single element belonging to it. In this case, it would not have any
-        // elements belonging to the same home, over which it may leap-frog.
-        bkt = std::move(next_bkt);
-        --bkt.offset;
-      }
-      assert(0 && "impossible! Should have a hole");
-    }
+    case SearchStatus::found_match:
+      this->erase_at(home, offset);
+      return ErrorType::ok;
     // Not found
     case SearchStatus::found_hole:
     case SearchStatus::found_nohole:
@@ -261,6 +382,130 @@ SequentialRobinHoodHashTable::remove(KeyType key) {
   assert(0 && "unreachable");
 }
 
+void
+SequentialRobinHoodHashTable::erase_at(const size_t home, const size_t offset) {
+  LOG_TRACE("Enter");
+  if (!this->miss_filter_.empty()) {
+    const HashCodeType hashcode = this->buckets_[get_real_index(home, offset, this->capacity_)].hashcode;
+    this->miss_filter_.remove(home / homes_per_filter_block, hashcode);
+  }
+  for (size_t i = 0; i < this->capacity_; ++i) {
+    // NOTE(dchu): real_index is the previous iteration's next_real_index
+    size_t real_index = get_real_index(home, offset + i, this->capacity_);
+    SequentialBucket &bkt = this->buckets_[real_index];
+    size_t next_real_index = get_real_index(home, offset + i + 1, this->capacity_);
+    SequentialBucket &next_bkt = this->buckets_[next_real_index];
+    // Next element is empty or already in its home bucket
+    if (next_bkt.is_empty() || next_bkt.offset == 0) {
+      bkt.invalidate();
+      --this->length_;
+      return;
+    }
+    // I argue that this sliding is efficient if the average home has only a
+    // single element belonging to it. In this case, it would not have any
+    // elements belonging to the same home, over which it may leap-frog.
+    bkt = std::move(next_bkt);
+    --bkt.offset;
+  }
+  assert(0 && "impossible! Should have a hole");
+}
+
+bool
+SequentialRobinHoodHashTable::visit(KeyType key,
+                                    FunctionRef<MatchAction(ValueType &)> on_match,
+                                    FunctionRef<std::optional<ValueType>()> on_miss) {
+  LOG_TRACE("Enter");
+  HashCodeType hashcode = this->hasher_(key);
+  size_t home = get_home(hashcode, this->capacity_);
+
+  const auto [status, offset] = get_wouldbe_offset(this->buckets_, key, hashcode, home);
+  if (status == SearchStatus::found_match) {
+    size_t real_index = get_real_index(home, offset, this->capacity_);
+    if (on_match(this->buckets_[real_index].value) == MatchAction::erase) {
+      this->erase_at(home, offset);
+    }
+    return true;
+  }
+  const std::optional<ValueType> value = on_miss();
+  if (value.has_value()) {
+    // This may need to resize, so it re-probes.
+    [[maybe_unused]] ErrorType e = this->insert(key, value.value());
+    assert(e == ErrorType::ok && "error in insert");
+  }
+  return false;
+}
+
+ValueType
+SequentialRobinHoodHashTable::fetch_add(KeyType key, ValueType delta) {
+  LOG_TRACE("Enter");
+  ValueType old = 0;
+  this->visit(key,
+      [&old, delta](ValueType &value) { old = value; value += delta; return MatchAction::keep; },
+      [delta]() -> std::optional<ValueType> { return delta; });
+  return old;
+}
+
+bool
+SequentialRobinHoodHashTable::compare_exchange(KeyType key, ValueType &expected, ValueType desired) {
+  LOG_TRACE("Enter");
+  bool exchanged = false;
+  this->visit(key,
+      [&expected, desired, &exchanged](ValueType &value) {
+        if (value == expected) {
+          value = desired;
+          exchanged = true;
+        } else {
+          expected = value;
+        }
+        return MatchAction::keep;
+      },
+      []() -> std::optional<ValueType> { return std::nullopt; });
+  return exchanged;
+}
+
+void
+SequentialRobinHoodHashTable::sample_search(const HashCodeType hashcode) const {
+  if (this->heat_sample_period_ == 0) {
+    return;
+  }
+  const size_t until_sample = this->searches_until_sample_.load();
+  if (until_sample > 1) {
+    this->searches_until_sample_.store(until_sample - 1);
+    return;
+  }
+  this->searches_until_sample_.store(this->heat_sample_period_);
+  this->heat_.increment(hashcode);
+}
+
+const CountMinSketch *
+SequentialRobinHoodHashTable::placement_sketch() const {
+  return this->heat_.empty() ? nullptr : &this->heat_;
+}
+
+bool
+SequentialRobinHoodHashTable::filter_rejects(const HashCodeType hashcode, const size_t home) const {
+  return !this->miss_filter_.empty() && !this->miss_filter_.may_contain(home / homes_per_filter_block, hashcode);
+}
+
+void
+SequentialRobinHoodHashTable::count_filtered_miss() const {
+  this->filtered_misses_.add(1);
+}
+
+void
+SequentialRobinHoodHashTable::rebuild_miss_filter() {
+  LOG_TRACE("Enter");
+  const size_t num_blocks = (this->capacity_ + homes_per_filter_block - 1) / homes_per_filter_block;
+  if (this->miss_filter_.num_blocks() == num_blocks) {
+    this->miss_filter_.clear();
+  } else {
+    this->miss_filter_ = BlockedCountingFilter(num_blocks);
+  }
+  for (const SequentialBucket &bkt : *this) {
+    this->miss_filter_.add(get_home(bkt.hashcode, this->capacity_) / homes_per_filter_block, bkt.hashcode);
+  }
+}
+
 ErrorType
 SequentialRobinHoodHashTable::resize(size_t new_size) {
   LOG_TRACE("Enter");
@@ -269,12 +514,16 @@ SequentialRobinHoodHashTable::resize(size_t new_size) {
   assert(new_size >= this->length_ && "not enough room in new array!");
   for (auto &bkt : this->buckets_) {
     if (!bkt.is_empty()) {
-      ErrorType e = insert_without_resize(tmp_bkts, bkt.key, bkt.value, bkt.hashcode);
+      ErrorType e = insert_without_resize(tmp_bkts, bkt.key, bkt.value, bkt.hashcode, this->placement_sketch());
       assert(e == ErrorType::ok && "should not have error in insert_without_resize");
     }
   }
-  this->buckets_ = tmp_bkts;
+  this->buckets_ = std::move(tmp_bkts);
   this->capacity_ = new_size;
+  if (!this->miss_filter_.empty()) {
+    // This also drops any counters that had saturated.
+    this->rebuild_miss_filter();
+  }
   return ErrorType::ok;
 }
 
@@ -0,0 +1,59 @@
+#include <cassert>
+#include <limits>
+
+#include "common/logger.hpp"
+#include "string_key/arena.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// KEY ARENA
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t
+StringArena::append(std::string_view key) {
+  LOG_TRACE("Enter");
+  const size_t ref = this->bytes_.size();
+  assert(ref + key.size() <= std::numeric_limits<uint32_t>::max() && "arena is full");
+  this->bytes_.insert(this->bytes_.end(), key.begin(), key.end());
+  return static_cast<uint32_t>(ref);
+}
+
+std::string_view
+StringArena::view(uint32_t ref, size_t length) const {
+  assert(ref + length <= this->bytes_.size() && "reference out of range");
+  return std::string_view(this->bytes_.data() + ref, length);
+}
+
+void
+StringArena::release(size_t length) {
+  LOG_TRACE("Enter");
+  this->dead_bytes_ += length;
+  assert(this->dead_bytes_ <= this->bytes_.size() && "released more than appended");
+}
+
+bool
+StringArena::should_compact() const {
+  // Compacting copies every live byte, so wait until at least as many are dead.
+  return this->dead_bytes_ >= min_compact_bytes && this->dead_bytes_ >= this->live_bytes();
+}
+
+void
+StringArena::reserve(size_t num_bytes) {
+  LOG_TRACE("Enter");
+  this->bytes_.reserve(num_bytes);
+}
+
+size_t
+StringArena::live_bytes() const {
+  return this->bytes_.size() - this->dead_bytes_;
+}
+
+size_t
+StringArena::dead_bytes() const {
+  return this->dead_bytes_;
+}
+
+size_t
+StringArena::bytes_used() const {
+  return this->bytes_.capacity();
+}
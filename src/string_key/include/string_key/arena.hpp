@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// KEY ARENA
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Append-only storage for the bytes of variable-length keys.
+///
+/// Every key is copied into one contiguous byte buffer and referred to by its
+/// 32-bit offset, so a table holds no per-key allocation. Nothing is freed in
+/// place: release() only counts the bytes as dead. The owner reclaims them by
+/// copying its live keys into a fresh arena (see
+/// StringKeyRobinHoodHashTable::compact()), because only it knows which
+/// offsets are still referenced.
+///
+/// N.B.  Views returned by view() are invalidated by the next append(), since
+///       the buffer may move.
+class StringArena {
+public:
+  /// @brief  Copy key into the arena.
+  ///
+  /// @return its offset.
+  uint32_t
+  append(std::string_view key);
+
+  std::string_view
+  view(uint32_t ref, size_t length) const;
+
+  /// @brief  Mark length bytes as no longer referenced.
+  void
+  release(size_t length);
+
+  /// @brief  Whether enough of the arena is dead for compaction to pay off.
+  bool
+  should_compact() const;
+
+  void
+  reserve(size_t num_bytes);
+
+  size_t
+  live_bytes() const;
+
+  size_t
+  dead_bytes() const;
+
+  /// @brief  Bytes allocated for the buffer, including unused capacity.
+  size_t
+  bytes_used() const;
+
+private:
+  /// Do not bother compacting an arena smaller than this.
+  static constexpr size_t min_compact_bytes = 1 << 16;
+
+  std::vector<char> bytes_;
+  size_t dead_bytes_ = 0;
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "common/logger.hpp"
+#include "common/stats.hpp"
+#include "common/status.hpp"
+#include "common/types.hpp"
+#include "string_key/arena.hpp"
+#include "utility/utility.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// HELPER CLASSES
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Bucket for the string-key Robin Hood hash table.
+///
+/// The key's bytes live in a StringArena, so the bucket only holds a reference
+/// to them and stays 16 bytes. The hashcode doubles as a tag: a probe compares
+/// it (and the length) before it touches the key's bytes, so almost every
+/// mismatch is rejected without a second cache miss.
+struct StringKeyBucket {
+  /// A key of at most this many bytes is stored in key_ref itself.
+  static constexpr size_t inline_key_size = sizeof(uint32_t);
+  /// The largest displacement we can store; UINT16_MAX marks an empty bucket.
+  static constexpr size_t max_offset = UINT16_MAX - 1;
+
+  HashCodeType hashcode = 0;
+  /// The key's arena offset or, for a short key, its bytes (zero padded).
+  uint32_t key_ref = 0;
+  ValueType value = 0;
+  uint16_t length = 0;
+  uint16_t offset = UINT16_MAX;
+
+  bool
+  is_empty() const;
+
+  void
+  invalidate();
+
+  bool
+  is_inline() const;
+
+  /// @brief  Get the key's bytes. This is only valid until the next append to
+  ///         arena.
+  std::string_view
+  key(const StringArena &arena) const;
+
+  bool
+  equal_by_key(const StringArena &arena, std::string_view key, const HashCodeType hashcode) const;
+
+  /// @brief  Pretty print bucket
+  ///
+  /// This prints in the format (using Python's f-string syntax):
+  /// f"({hashcode}=>{home}+{offset}) {key}: {value}"
+  void
+  print(const StringArena &arena, const size_t capacity) const;
+};
+
+static_assert(sizeof(StringKeyBucket) == 16, "keep the bucket array dense");
+
+////////////////////////////////////////////////////////////////////////////////
+/// HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  A sequential Robin Hood hash table from variable-length string keys
+///         to values.
+///
+/// Keys are copied into an append-only arena rather than into a std::string
+/// per entry. Removing a key leaves a hole in the arena, which is reclaimed by
+/// compact(); remove() compacts automatically once half of the arena is dead.
+///
+/// N.B.  Keys may be at most UINT16_MAX bytes long.
+class StringKeyRobinHoodHashTable {
+public:
+  /// @brief  Construct with a random hash seed.
+  StringKeyRobinHoodHashTable() = default;
+
+  /// @brief  Construct with a fixed hash seed (e.g. for reproducible layouts).
+  explicit StringKeyRobinHoodHashTable(const uint64_t hash_seed);
+
+  void
+  print() const;
+
+  /// @brief Insert <key, value> pair. The key is copied only if it is new.
+  ///
+  /// @return 0 on good; 1 on failure
+  ErrorType
+  insert(std::string_view key, ValueType value);
+
+  /// @brief Search for <key, value>.
+  std::optional<ValueType>
+  search(std::string_view key) const;
+
+  /// @brief Remove <key, value> pair.
+  ///
+  /// @return 0 on found; 1 otherwise.
+  ErrorType
+  remove(std::string_view key);
+
+  /// @brief  Copy the live keys into a fresh arena, dropping removed ones.
+  void
+  compact();
+
+  /// @brief  Call fn(key, value) on every entry. The key view is only valid
+  ///         during the call.
+  template<typename Fn>
+  void
+  for_each(Fn &&fn) const
+  {
+    for (const StringKeyBucket &bkt : this->buckets_) {
+      if (!bkt.is_empty()) {
+        fn(bkt.key(this->arena_), bkt.value);
+      }
+    }
+  }
+
+  const StringArena &
+  arena() const
+  {
+    return this->arena_;
+  }
+
+  /// @brief  Summarize the table's shape (see TableStats). The bytes used
+  ///         include the arena.
+  TableStats
+  stats() const;
+
+private:
+  std::vector<StringKeyBucket> buckets_{1<<20};
+  size_t length_ = 0;
+  size_t capacity_ = 1<<20;
+  StringArena arena_;
+  WyHash hasher_{random_hash_seed()};
+
+  HashCodeType
+  hash(std::string_view key) const;
+
+  /// @brief  Get offset from home or where it would be if not found.
+  std::pair<SearchStatus, size_t>
+  get_wouldbe_offset(std::string_view key, const HashCodeType hashcode, const size_t home) const;
+
+  ErrorType
+  resize(size_t new_size);
+
+  /// @brief  Remove the entry at (home, offset) by shifting its successors back.
+  void
+  erase_at(const size_t home, const size_t offset);
+};
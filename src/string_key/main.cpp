@@ -0,0 +1,51 @@
+#include <iostream>
+#include <optional>
+#include <string>
+
+#include "string_key/string_key.hpp"
+
+
+int main() {
+  LOG_TRACE("Enter");
+  StringKeyRobinHoodHashTable a;
+  // Insert (the short keys are stored inline, the long ones in the arena)
+  for (ValueType i = 0; i < 10; ++i) {
+    const std::string key = (i % 2 == 0) ? std::to_string(i) : "key-number-" + std::to_string(i);
+    ErrorType e = a.insert(key, i);
+    std::cout << "Insert (" << static_cast<int>(e) << "): <" << key << ", " << i << ">\n";
+  }
+
+  // Search
+  for (ValueType i = 0; i < 11; ++i) {
+    const std::string key = (i % 2 == 0) ? std::to_string(i) : "key-number-" + std::to_string(i);
+    std::optional<ValueType> value = a.search(key);
+    if (value.has_value()) {
+      std::cout << "Lookup (" << value.has_value() << ") " << key << ": " << value.value() << "\n";
+    } else {
+      std::cout << "Lookup (" << value.has_value() << ") " << key << ": ?\n";
+    }
+  }
+
+  // Iterate
+  a.for_each([](std::string_view key, const ValueType value) {
+    std::cout << "Iterator: <" << key << ", " << value << ">\n";
+  });
+
+  // Remove
+  for (ValueType i = 0; i < 11; ++i) {
+    const std::string key = (i % 2 == 0) ? std::to_string(i) : "key-number-" + std::to_string(i);
+    ErrorType e = a.remove(key);
+    std::cout << "Remove (" << static_cast<int>(e) << "): " << key << "\n";
+  }
+
+  // Compact
+  std::cout << "Arena before compaction: " << a.arena().live_bytes() << " live, " <<
+      a.arena().dead_bytes() << " dead bytes\n";
+  a.compact();
+  std::cout << "Arena after compaction: " << a.arena().live_bytes() << " live, " <<
+      a.arena().dead_bytes() << " dead bytes\n";
+
+  // Statistics
+  a.stats().print(std::cout);
+  return 0;
+}
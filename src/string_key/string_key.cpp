@@ -0,0 +1,285 @@
+#include <algorithm>  // std::swap
+#include <cstring>
+
+#include "string_key/string_key.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// STATIC HELPER FUNCTIONS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Pack a short key into a bucket's key_ref, zero padded.
+static uint32_t
+pack_inline_key(std::string_view key) {
+  assert(key.size() <= StringKeyBucket::inline_key_size && "key is too long to inline");
+  uint32_t packed = 0;
+  std::memcpy(&packed, key.data(), key.size());
+  return packed;
+}
+
+/// @brief  Get real bucket index.
+static size_t
+get_real_index(const size_t home, const size_t offset, const size_t capacity) {
+  return (home + offset) % capacity;
+}
+
+/// @brief  Place a bucket whose key is known to be absent, displacing richer
+///         entries. This never compares keys, so it never reads the arena.
+static void
+place_without_resize(std::vector<StringKeyBucket> &buckets, StringKeyBucket tmp) {
+  LOG_TRACE("Enter");
+  const size_t capacity = buckets.size();
+  size_t index = get_home(tmp.hashcode, capacity);
+  size_t offset = 0;
+  for (size_t i = 0; i < capacity; ++i) {
+    StringKeyBucket &bkt = buckets[index];
+    if (bkt.is_empty()) {
+      assert(offset <= StringKeyBucket::max_offset && "displacement overflow");
+      tmp.offset = static_cast<uint16_t>(offset);
+      bkt = tmp;
+      return;
+    }
+    if (bkt.offset < offset) {
+      // This means that bkt belongs to a nearer home, so take its place and
+      // carry it onwards instead.
+      assert(offset <= StringKeyBucket::max_offset && "displacement overflow");
+      tmp.offset = static_cast<uint16_t>(offset);
+      std::swap(bkt, tmp);
+      offset = tmp.offset;
+    }
+    ++offset;
+    index = get_real_index(index, 1, capacity);
+  }
+  assert(0 && "should not call this function if we need to resize!");
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// HELPER CLASSES
+////////////////////////////////////////////////////////////////////////////////
+
+bool
+StringKeyBucket::is_empty() const {
+  return this->offset == UINT16_MAX;
+}
+
+void
+StringKeyBucket::invalidate() {
+  LOG_TRACE("Enter");
+  // Not necessary
+  this->hashcode = 0;
+  this->key_ref = 0;
+  this->value = 0;
+  this->length = 0;
+  // Necessary
+  this->offset = UINT16_MAX;
+}
+
+bool
+StringKeyBucket::is_inline() const {
+  return this->length <= inline_key_size;
+}
+
+std::string_view
+StringKeyBucket::key(const StringArena &arena) const {
+  assert(!this->is_empty() && "empty bucket has no key!");
+  if (this->is_inline()) {
+    return std::string_view(reinterpret_cast<const char *>(&this->key_ref), this->length);
+  }
+  return arena.view(this->key_ref, this->length);
+}
+
+bool
+StringKeyBucket::equal_by_key(const StringArena &arena,
+                              std::string_view key,
+                              const HashCodeType hashcode) const {
+  assert(!this->is_empty() && "should not compare to empty bucket!");
+  // Compare the tag and length first, since the key's bytes may be a cache
+  // miss away.
+  if (this->hashcode != hashcode || this->length != key.size()) {
+    return false;
+  }
+  if (this->is_inline()) {
+    return this->key_ref == pack_inline_key(key);
+  }
+  return arena.view(this->key_ref, this->length) == key;
+}
+
+void
+StringKeyBucket::print(const StringArena &arena, const size_t capacity) const {
+  if (this->is_empty()) {
+    std::cout << "(empty)";
+  } else {
+    std::cout << "(" << this->hashcode << "=>" << this->hashcode % capacity <<
+        "+" << this->offset << ") " << this->key(arena) << ": " << this->value;
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// HASH TABLE CLASS
+////////////////////////////////////////////////////////////////////////////////
+
+StringKeyRobinHoodHashTable::StringKeyRobinHoodHashTable(const uint64_t hash_seed)
+    : hasher_(hash_seed) {}
+
+void
+StringKeyRobinHoodHashTable::print() const {
+  LOG_TRACE("Enter");
+  std::cout << "(Length: " << this->length_ << "/Capacity: " << this->capacity_ << ") [\n";
+  for (size_t i = 0; i < this->capacity_; ++i) {
+    std::cout << "\t" << i << ": ";
+    this->buckets_[i].print(this->arena_, this->capacity_);
+    std::cout << ",\n";
+  }
+  std::cout << "]" << std::endl;
+}
+
+TableStats
+StringKeyRobinHoodHashTable::stats() const {
+  LOG_TRACE("Enter");
+  TableStatsCollector collector(this->capacity_);
+  for (const auto &bkt : this->buckets_) {
+    collector.visit(!bkt.is_empty(), bkt.offset);
+  }
+  return collector.finish(sizeof(*this) + this->buckets_.capacity() * sizeof(StringKeyBucket) +
+                          this->arena_.bytes_used());
+}
+
+HashCodeType
+StringKeyRobinHoodHashTable::hash(std::string_view key) const {
+  return static_cast<HashCodeType>(this->hasher_(key.data(), key.size()));
+}
+
+std::pair<SearchStatus, size_t>
+StringKeyRobinHoodHashTable::get_wouldbe_offset(std::string_view key,
+                                                const HashCodeType hashcode,
+                                                const size_t home) const {
+  LOG_TRACE("Enter");
+  for (size_t i = 0; i < this->capacity_; ++i) {
+    const StringKeyBucket &bkt = this->buckets_[get_real_index(home, i, this->capacity_)];
+    if (bkt.is_empty()) {
+      return {SearchStatus::found_hole, i};
+    } else if (bkt.offset < i) { // This means that bkt belongs to a nearer home
+      return {SearchStatus::found_swap, i};
+    } else if (bkt.equal_by_key(this->arena_, key, hashcode)) {
+      return {SearchStatus::found_match, i};
+    }
+  }
+  return {SearchStatus::found_nohole, SIZE_MAX};
+}
+
+ErrorType
+StringKeyRobinHoodHashTable::insert(std::string_view key, ValueType value) {
+  LOG_TRACE("Enter");
+  if (key.size() > UINT16_MAX) {
+    return ErrorType::e_unknown;
+  }
+  const HashCodeType hashcode = this->hash(key);
+  const size_t home = get_home(hashcode, this->capacity_);
+
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
+  if (status == SearchStatus::found_match) {
+    LOG_TRACE("SearchStatus::found_match");
+    this->buckets_[get_real_index(home, offset, this->capacity_)].value = value;
+    return ErrorType::ok;
+  }
+  // Ensure suitably empty and there is at least one hole
+  if (static_cast<double>(this->length_) >= 0.9 * static_cast<double>(this->capacity_) ||
+      this->length_ + 1 >= this->capacity_) {
+    [[maybe_unused]] ErrorType e = this->resize(2 * this->capacity_);
+    assert(e == ErrorType::ok && "error in resize");
+  }
+
+  StringKeyBucket bkt = {.hashcode = hashcode,
+                         .key_ref = 0,
+                         .value = value,
+                         .length = static_cast<uint16_t>(key.size()),
+                         .offset = /*arbitrary value*/0,};
+  // Only now that we know the key is new do we copy it.
+  bkt.key_ref = bkt.is_inline() ? pack_inline_key(key) : this->arena_.append(key);
+  place_without_resize(this->buckets_, bkt);
+  ++this->length_;
+  return ErrorType::ok;
+}
+
+std::optional<ValueType>
+StringKeyRobinHoodHashTable::search(std::string_view key) const {
+  LOG_TRACE("Enter");
+  const HashCodeType hashcode = this->hash(key);
+  const size_t home = get_home(hashcode, this->capacity_);
+
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
+  if (status == SearchStatus::found_match) {
+    return this->buckets_[get_real_index(home, offset, this->capacity_)].value;
+  }
+  return std::nullopt;
+}
+
+ErrorType
+StringKeyRobinHoodHashTable::remove(std::string_view key) {
+  LOG_TRACE("Enter");
+  const HashCodeType hashcode = this->hash(key);
+  const size_t home = get_home(hashcode, this->capacity_);
+
+  const auto [status, offset] = this->get_wouldbe_offset(key, hashcode, home);
+  if (status != SearchStatus::found_match) {
+    return ErrorType::e_notfound;
+  }
+  const StringKeyBucket &bkt = this->buckets_[get_real_index(home, offset, this->capacity_)];
+  if (!bkt.is_inline()) {
+    this->arena_.release(bkt.length);
+  }
+  this->erase_at(home, offset);
+  if (this->arena_.should_compact()) {
+    this->compact();
+  }
+  return ErrorType::ok;
+}
+
+void
+StringKeyRobinHoodHashTable::compact() {
+  LOG_TRACE("Enter");
+  StringArena fresh;
+  fresh.reserve(this->arena_.live_bytes());
+  for (StringKeyBucket &bkt : this->buckets_) {
+    if (!bkt.is_empty() && !bkt.is_inline()) {
+      bkt.key_ref = fresh.append(this->arena_.view(bkt.key_ref, bkt.length));
+    }
+  }
+  this->arena_ = std::move(fresh);
+}
+
+void
+StringKeyRobinHoodHashTable::erase_at(const size_t home, const size_t offset) {
+  LOG_TRACE("Enter");
+  for (size_t i = 0; i < this->capacity_; ++i) {
+    StringKeyBucket &bkt = this->buckets_[get_real_index(home, offset + i, this->capacity_)];
+    StringKeyBucket &next_bkt = this->buckets_[get_real_index(home, offset + i + 1, this->capacity_)];
+    // Next element is empty or already in its home bucket
+    if (next_bkt.is_empty() || next_bkt.offset == 0) {
+      bkt.invalidate();
+      --this->length_;
+      return;
+    }
+    bkt = next_bkt;
+    --bkt.offset;
+  }
+  assert(0 && "impossible! Should have a hole");
+}
+
+ErrorType
+StringKeyRobinHoodHashTable::resize(size_t new_size) {
+  LOG_TRACE("Enter");
+  assert(new_size >= this->length_ && "not enough room in new array!");
+  std::vector<StringKeyBucket> tmp_bkts(new_size);
+  // The keys stay where they are in the arena; only their references move.
+  for (const auto &bkt : this->buckets_) {
+    if (!bkt.is_empty()) {
+      place_without_resize(tmp_bkts, bkt);
+    }
+  }
+  this->buckets_ = std::move(tmp_bkts);
+  this->capacity_ = new_size;
+  return ErrorType::ok;
+}
@@ -33,8 +33,8 @@ generate_random_traces(const size_t max_num_unique_elements,
                        const unsigned search_ratio,
                        const unsigned remove_ratio)
 {
-    LOG_TRACE("generate_random_traces() with ratio " << insert_ratio << ":" <<
-            search_ratio << ":" << remove_ratio);
+    LOG_TRACE("generate_random_traces() with ratio {}:{}:{}",
+            insert_ratio, search_ratio, remove_ratio);
     std::vector<Trace> traces;
     traces.reserve(trace_length);
     foedus::assorted::ZipfianRandom zrng(max_num_unique_elements, /*theta=*/0.5, /*urnd_seed=*/0);
@@ -73,8 +73,8 @@ generate_ordered_traces(const size_t max_num_unique_elements,
                         const unsigned search_ratio,
                         const unsigned remove_ratio)
 {
-    LOG_INFO("generate_ordered_traces() with ratio " << insert_ratio << ":" <<
-            search_ratio << ":" << remove_ratio);
+    LOG_INFO("generate_ordered_traces() with ratio {}:{}:{}",
+            insert_ratio, search_ratio, remove_ratio);
     std::vector<Trace> traces;
     // NOTE Add 1 to the reserved space because if we ask for 10 elements but
     //      have ratios {3.5,3.5,3}, then we would have {4,4,3} which adds to 11
@@ -90,7 +90,7 @@ generate_ordered_traces(const size_t max_num_unique_elements,
     const size_t num_inserts = static_cast<size_t>(std::lround(static_cast<double>(insert_ratio) / sum_of_ratios * static_cast<double>(goal_trace_length)));
     const size_t num_searches = static_cast<size_t>(std::lround(static_cast<double>(search_ratio) / sum_of_ratios * static_cast<double>(goal_trace_length)));
     const size_t num_removes = static_cast<size_t>(std::lround(static_cast<double>(remove_ratio) / sum_of_ratios * static_cast<double>(goal_trace_length)));
-    LOG_INFO("Ratio of ops" << num_inserts << ":" << num_searches << ":" << num_removes);
+    LOG_INFO("Ratio of ops {}:{}:{}", num_inserts, num_searches, num_removes);
 
     ValueType value = 0;
     for (size_t i = 0; i < num_inserts; ++i) {
@@ -0,0 +1,129 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief  A blocked counting Bloom filter: one cache line per block, so that
+///         a query reads a single line.
+///
+/// Each block holds 128 4-bit counters. A hash code sets (i.e. increments)
+/// `num_probes` counters in its block, and may be in the filter only if all of
+/// them are nonzero. Since remove() decrements the same counters, the filter
+/// stays exact (save for false positives) as entries come and go. A counter
+/// that reaches 15 sticks there, which can only cause false positives, until
+/// the filter is cleared and rebuilt.
+///
+/// The caller chooses the block, e.g. from the bucket that the key hashes to;
+/// the counters within it are chosen from the hash code's remixed top bits.
+class BlockedCountingFilter {
+public:
+  BlockedCountingFilter() = default;
+
+  explicit BlockedCountingFilter(const size_t num_blocks)
+      : blocks_(num_blocks) {}
+
+  bool
+  empty() const
+  {
+    return this->blocks_.empty();
+  }
+
+  size_t
+  num_blocks() const
+  {
+    return this->blocks_.size();
+  }
+
+  size_t
+  bytes_used() const
+  {
+    return this->blocks_.capacity() * sizeof(Block);
+  }
+
+  void
+  clear()
+  {
+    for (Block &block : this->blocks_) {
+      block = Block{};
+    }
+  }
+
+  void
+  add(const size_t block, const uint64_t hash)
+  {
+    Block &b = this->blocks_[block];
+    for (size_t i = 0; i < num_probes; ++i) {
+      const size_t c = counter_index(hash, i);
+      if (get_counter(b, c) != max_count) {
+        set_counter(b, c, static_cast<uint8_t>(get_counter(b, c) + 1));
+      }
+    }
+  }
+
+  /// @brief  Undo one add(block, hash). The hash must have been added.
+  void
+  remove(const size_t block, const uint64_t hash)
+  {
+    Block &b = this->blocks_[block];
+    for (size_t i = 0; i < num_probes; ++i) {
+      const size_t c = counter_index(hash, i);
+      if (get_counter(b, c) != max_count) {
+        set_counter(b, c, static_cast<uint8_t>(get_counter(b, c) - 1));
+      }
+    }
+  }
+
+  /// @brief  Whether hash may have been added to block. A false result is
+  ///         exact.
+  bool
+  may_contain(const size_t block, const uint64_t hash) const
+  {
+    const Block &b = this->blocks_[block];
+    for (size_t i = 0; i < num_probes; ++i) {
+      if (get_counter(b, counter_index(hash, i)) == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void
+  prefetch(const size_t block) const
+  {
+    __builtin_prefetch(&this->blocks_[block]);
+  }
+
+private:
+  static constexpr size_t num_probes = 3;
+  static constexpr size_t log2_counters = 7;
+  static constexpr uint8_t max_count = 15;
+
+  struct alignas(64) Block {
+    /// Two counters per byte: even ones in the low nibble.
+    uint8_t counters[(size_t{1} << log2_counters) / 2] = {};
+  };
+
+  static size_t
+  counter_index(const uint64_t hash, const size_t probe)
+  {
+    // The caller's block usually comes from the low bits of the hash code, so
+    // mix them into the top bits and use those.
+    const uint64_t mixed = hash * 0x9E3779B97F4A7C15ULL;
+    return (mixed >> (64 - log2_counters * (probe + 1))) & ((size_t{1} << log2_counters) - 1);
+  }
+
+  static uint8_t
+  get_counter(const Block &b, const size_t c)
+  {
+    return static_cast<uint8_t>((b.counters[c / 2] >> (4 * (c % 2))) & 0xF);
+  }
+
+  static void
+  set_counter(Block &b, const size_t c, const uint8_t value)
+  {
+    const size_t shift = 4 * (c % 2);
+    b.counters[c / 2] = static_cast<uint8_t>((b.counters[c / 2] & ~(0xF << shift)) | (value << shift));
+  }
+
+  std::vector<Block> blocks_;
+};
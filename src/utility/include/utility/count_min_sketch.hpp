@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utility/relaxed_counter.hpp"
+
+/// @brief  A count-min sketch of how often each hash code was seen, in a
+///         fixed amount of memory.
+///
+/// Each of the `depth` rows maps a hash code to one of its counters with a
+/// different multiplier; increment() bumps the code's counter in every row and
+/// estimate() returns the smallest of them, which over-counts only when every
+/// row collides. Once the total count reaches ten times the width, every
+/// counter is halved, so the estimates follow a shifting working set.
+///
+/// The counters are RelaxedCounters, so increment() may be called from
+/// concurrent (e.g. const, reading) threads, and the sketch can still be
+/// copied. Increments that race may be lost, which only makes the estimates
+/// more approximate.
+///
+/// A default-constructed sketch is empty: it has no counters, and must not be
+/// used.
+class CountMinSketch {
+public:
+  CountMinSketch() = default;
+
+  /// @brief  Construct with 2**log2_width counters per row.
+  explicit CountMinSketch(const size_t log2_width)
+      : shift_(64 - log2_width),
+        width_(size_t{1} << log2_width),
+        counters_(depth * (size_t{1} << log2_width)),
+        age_period_(10 * (size_t{1} << log2_width))
+  {
+  }
+
+  bool
+  empty() const
+  {
+    return this->counters_.empty();
+  }
+
+  void
+  increment(const uint64_t hash)
+  {
+    for (size_t row = 0; row < depth; ++row) {
+      RelaxedCounter<uint16_t> &counter = this->counters_[this->index(row, hash)];
+      if (counter.load() != UINT16_MAX) {
+        counter.add(1);
+      }
+    }
+    if (this->count_.add(1) >= this->age_period_) {
+      this->age();
+    }
+  }
+
+  uint16_t
+  estimate(const uint64_t hash) const
+  {
+    uint16_t min = UINT16_MAX;
+    for (size_t row = 0; row < depth; ++row) {
+      const uint16_t counter = this->counters_[this->index(row, hash)].load();
+      min = counter < min ? counter : min;
+    }
+    return min;
+  }
+
+private:
+  static constexpr size_t depth = 4;
+  /// Odd multipliers, one per row; the top bits of the product pick the
+  /// counter.
+  static constexpr uint64_t multipliers[depth] = {
+      0x9E3779B97F4A7C15ULL,
+      0xC2B2AE3D27D4EB4FULL,
+      0x165667B19E3779F9ULL,
+      0xD6E8FEB86659FD93ULL,
+  };
+
+  size_t shift_ = 64;
+  size_t width_ = 0;
+  std::vector<RelaxedCounter<uint16_t>> counters_;
+  RelaxedCounter<size_t> count_;
+  size_t age_period_ = 0;
+
+  size_t
+  index(const size_t row, const uint64_t hash) const
+  {
+    return row * this->width_ + ((hash * multipliers[row]) >> this->shift_);
+  }
+
+  void
+  age()
+  {
+    for (RelaxedCounter<uint16_t> &counter : this->counters_) {
+      counter.store(static_cast<uint16_t>(counter.load() >> 1));
+    }
+    this->count_.store(this->age_period_ / 2);
+  }
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+/// @brief  A non-owning reference to a callable, so that a non-template method
+///         can take a lambda without the allocation of std::function.
+///
+/// N.B.  This does not extend the callable's lifetime, so only use it for
+///       parameters and never store it.
+template<typename Fn>
+class FunctionRef;
+
+template<typename Ret, typename ...Args>
+class FunctionRef<Ret(Args...)> {
+public:
+  template<typename Callable>
+    requires (!std::is_same_v<std::remove_cvref_t<Callable>, FunctionRef> &&
+              std::is_invocable_r_v<Ret, Callable &, Args...>)
+  FunctionRef(Callable &&callable)
+      : callable_(const_cast<void *>(static_cast<const void *>(std::addressof(callable)))),
+        call_(&call<std::remove_reference_t<Callable>>) {}
+
+  Ret
+  operator()(Args ...args) const
+  {
+    return this->call_(this->callable_, std::forward<Args>(args)...);
+  }
+
+private:
+  template<typename Callable>
+  static Ret
+  call(void *callable, Args ...args)
+  {
+    return (*static_cast<Callable *>(callable))(std::forward<Args>(args)...);
+  }
+
+  void *callable_;
+  Ret (*call_)(void *, Args...);
+};
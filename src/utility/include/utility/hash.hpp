@@ -0,0 +1,336 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+#if defined(__AVX2__)
+// Compiled for AVX2, so the AVX2 batch hashes always run.
+#define MM_HASH_AVX2 1
+#define MM_TARGET_AVX2
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+// Compile the AVX2 batch hashes for that target anyway, and pick them at run
+// time (see cpu_has_avx2()), so that the default build uses them too.
+#define MM_HASH_AVX2 1
+#define MM_HASH_AVX2_DISPATCH 1
+#define MM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__SSE4_2__) || defined(MM_HASH_AVX2)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "common/types.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// HASH POLICIES (header-only so that they always inline into the tables)
+////////////////////////////////////////////////////////////////////////////////
+
+/// N.B.  Every policy is a small value type that is constructed from a 64-bit
+///       seed and called as `HashCodeType operator()(KeyType) const`. Each table
+///       draws its own random seed, so an adversary who knows the hash function
+///       still cannot precompute a set of colliding keys (i.e. HashDoS).
+
+/// @brief  Get a fresh random seed for a table.
+inline uint64_t
+random_hash_seed()
+{
+  static thread_local std::random_device rd;
+  return (static_cast<uint64_t>(rd()) << 32) ^ static_cast<uint64_t>(rd());
+}
+
+/// @brief  The original (splitmix64 finalizer) mixer. With a seed of zero, this
+///         is exactly the unseeded hash we have always used.
+///
+/// Source: https://stackoverflow.com/questions/664014/what-integer-hash-function-are-good-that-accepts-an-integer-hash-key
+struct SplitMixHash {
+  uint64_t seed = 0;
+
+  explicit SplitMixHash(const uint64_t seed = 0) : seed(seed) {}
+
+  HashCodeType
+  operator()(const KeyType key) const
+  {
+    uint64_t k = static_cast<uint64_t>(key) ^ this->seed;
+    // I use the suffix '*ULL' to denote that the literal is at least an int64.
+    k = ((k >> 30) ^ k) * 0xbf58476d1ce4e5b9ULL;
+    k = ((k >> 27) ^ k) * 0x94d049bb133111ebULL;
+    k =  (k >> 31) ^ k;
+    return static_cast<HashCodeType>(k);
+  }
+};
+
+/// @brief  Dietzfelbinger's multiply-add-shift: h(x) = (a * x + b) >> 32.
+///
+/// This is 2-universal for 32-bit keys and costs a single multiply, but it only
+/// mixes upwards, so take the home from the high bits if the capacity is tiny.
+struct MultiplyShiftHash {
+  uint64_t multiplier = 1;
+  uint64_t increment = 0;
+
+  explicit MultiplyShiftHash(const uint64_t seed = 0)
+      : multiplier(SplitMixHash(seed)(0) | (static_cast<uint64_t>(SplitMixHash(seed)(1)) << 32) | 1),
+        increment(SplitMixHash(seed)(2) | (static_cast<uint64_t>(SplitMixHash(seed)(3)) << 32)) {}
+
+  HashCodeType
+  operator()(const KeyType key) const
+  {
+    return static_cast<HashCodeType>((this->multiplier * key + this->increment) >> 32);
+  }
+};
+
+/// @brief  CRC32-C (Castagnoli) software implementation. This matches the
+///         SSE4.2 `crc32` instruction bit-for-bit.
+inline uint32_t
+crc32c_software(uint32_t crc, const uint32_t data)
+{
+  crc ^= data;
+  for (int i = 0; i < 32; ++i) {
+    crc = (crc >> 1) ^ (0x82f63b78U & (0U - (crc & 1U)));
+  }
+  return crc;
+}
+
+/// @brief  Multiply two 64-bit numbers and fold the 128-bit product into 64 bits.
+inline uint64_t
+wy_mix(const uint64_t a, const uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+  __extension__ using uint128 = unsigned __int128;
+  const uint128 r = static_cast<uint128>(a) * b;
+  return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  uint64_t hi = 0;
+  const uint64_t lo = _umul128(a, b, &hi);
+  return lo ^ hi;
+#else
+  // Portable 64x64->128 multiply from 32-bit halves.
+  const uint64_t a_lo = a & 0xffffffffULL, a_hi = a >> 32;
+  const uint64_t b_lo = b & 0xffffffffULL, b_hi = b >> 32;
+  const uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+  const uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+  const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffULL) + lo_hi;
+  const uint64_t hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+  const uint64_t lo = (cross << 32) | (lo_lo & 0xffffffffULL);
+  return lo ^ hi;
+#endif
+}
+
+/// @brief  Hash with the CRC32 instruction, then mix in the seed.
+///
+/// N.B.  CRC is linear: crc(s, a) ^ crc(s, b) does not depend on the initial
+///       CRC s, so seeding it alone gives no HashDoS resistance, and neither
+///       does a final multiply (which only moves bits upwards, away from the
+///       low bits that `get_home` keeps). So we finish with a seeded wy_mix(),
+///       whose folded 128-bit product makes every output bit depend on the
+///       seed and on every bit of the CRC. Without SSE4.2 (e.g. no
+///       `-march=native`), this falls back to an equivalent (but much slower)
+///       software CRC.
+struct Crc32Hash {
+  uint32_t seed = 0;
+  uint64_t mix_seed = 0;
+
+  explicit Crc32Hash(const uint64_t seed = 0)
+      : seed(static_cast<uint32_t>(seed)),
+        mix_seed(seed ^ 0xa0761d6478bd642fULL) {}
+
+  HashCodeType
+  operator()(const KeyType key) const
+  {
+#if defined(__SSE4_2__)
+    const uint32_t crc = _mm_crc32_u32(this->seed, key);
+#else
+    const uint32_t crc = crc32c_software(this->seed, key);
+#endif
+    return static_cast<HashCodeType>(wy_mix(crc ^ 0xe7037ed1a0b428dbULL, this->mix_seed));
+  }
+};
+
+/// @brief  A wyhash-style mixer. Besides integer keys, this also hashes byte
+///         strings, for keys that are wider than a machine word.
+///
+/// Source: https://github.com/wangyi-fudan/wyhash (simplified; the output is
+///         not compatible with the reference implementation).
+struct WyHash {
+  static constexpr uint64_t p0 = 0xa0761d6478bd642fULL;
+  static constexpr uint64_t p1 = 0xe7037ed1a0b428dbULL;
+  static constexpr uint64_t p2 = 0x8ebc6af09c88c6e3ULL;
+
+  uint64_t seed = 0;
+
+  explicit WyHash(const uint64_t seed = 0) : seed(seed ^ p0) {}
+
+  HashCodeType
+  operator()(const KeyType key) const
+  {
+    return static_cast<HashCodeType>(wy_mix(key ^ p1, this->seed ^ p2));
+  }
+
+  uint64_t
+  operator()(const void *data, const size_t length) const
+  {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint64_t h = this->seed;
+    size_t i = length;
+    for (; i > 16; i -= 16, p += 16) {
+      h = wy_mix(read64(p) ^ p1, read64(p + 8) ^ h);
+    }
+    // Read the last (up to) 16 bytes, zero padded.
+    unsigned char tail[16] = {};
+    std::memcpy(tail, p, i);
+    h = wy_mix(read64(tail) ^ p1, read64(tail + 8) ^ h);
+    return wy_mix(h ^ p2, static_cast<uint64_t>(length) ^ p1);
+  }
+
+private:
+  static uint64_t
+  read64(const unsigned char *p)
+  {
+    uint64_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+};
+
+/// @brief  The policy the tables use unless told otherwise.
+using DefaultHash = SplitMixHash;
+
+////////////////////////////////////////////////////////////////////////////////
+/// BATCHED HASHING
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Whether the CPU we are running on has AVX2.
+inline bool
+cpu_has_avx2()
+{
+#if defined(__AVX2__)
+  return true;
+#elif defined(MM_HASH_AVX2_DISPATCH)
+  static const bool has_avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return has_avx2;
+#else
+  return false;
+#endif
+}
+
+/// @brief  Hash N keys one at a time, in a fixed-length loop that the
+///         compiler unrolls.
+template<size_t N, typename Hash>
+inline void
+hash_batch_scalar(const Hash &hasher, const KeyType *keys, HashCodeType *hashcodes)
+{
+  for (size_t i = 0; i < N; ++i) {
+    hashcodes[i] = hasher(keys[i]);
+  }
+}
+
+/// @brief  Hash N keys at once, for the batched lookup paths.
+///
+/// The generic version hashes them one at a time; policies with an explicit
+/// AVX2 version are overloaded below, and use it if the CPU has AVX2.
+template<size_t N, typename Hash>
+inline void
+hash_batch(const Hash &hasher, const KeyType *keys, HashCodeType *hashcodes)
+{
+  hash_batch_scalar<N>(hasher, keys, hashcodes);
+}
+
+#if defined(MM_HASH_AVX2)
+/// @brief  Multiply each 64-bit lane of x by c, keeping the low 64 bits.
+///
+/// AVX2 has no 64x64 multiply, so build it from 32x32->64 ones:
+/// x * c = x_lo * c_lo + ((x_hi * c_lo + x_lo * c_hi) << 32).
+MM_TARGET_AVX2 inline __m256i
+mul64_avx2(const __m256i x, const uint64_t c)
+{
+  const __m256i c_lo = _mm256_set1_epi64x(static_cast<long long>(c & 0xffffffffULL));
+  const __m256i c_hi = _mm256_set1_epi64x(static_cast<long long>(c >> 32));
+  const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), c_lo),
+                                         _mm256_mul_epu32(x, c_hi));
+  return _mm256_add_epi64(_mm256_mul_epu32(x, c_lo), _mm256_slli_epi64(cross, 32));
+}
+
+/// @brief  SplitMixHash of 4 keys per AVX2 iteration, in 64-bit lanes.
+template<size_t N>
+MM_TARGET_AVX2 inline void
+splitmix_hash_batch_avx2(const SplitMixHash &hasher, const KeyType *keys, HashCodeType *hashcodes)
+{
+  static_assert(N % 4 == 0, "AVX2 batch hashing works on multiples of 4 keys");
+  const __m256i seed = _mm256_set1_epi64x(static_cast<long long>(hasher.seed));
+  // Gathers the low halves of the 64-bit lanes into the low 128 bits.
+  const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+  for (size_t i = 0; i < N; i += 4) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+    __m256i k = _mm256_xor_si256(_mm256_cvtepu32_epi64(x), seed);
+    k = mul64_avx2(_mm256_xor_si256(_mm256_srli_epi64(k, 30), k), 0xbf58476d1ce4e5b9ULL);
+    k = mul64_avx2(_mm256_xor_si256(_mm256_srli_epi64(k, 27), k), 0x94d049bb133111ebULL);
+    k = _mm256_xor_si256(_mm256_srli_epi64(k, 31), k);
+    const __m256i r = _mm256_permutevar8x32_epi32(k, low_halves);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(hashcodes + i), _mm256_castsi256_si128(r));
+  }
+}
+
+template<size_t N>
+inline void
+hash_batch(const SplitMixHash &hasher, const KeyType *keys, HashCodeType *hashcodes)
+{
+#if defined(__AVX512DQ__)
+  // The compiler vectorizes the scalar loop with AVX-512's 64-bit multiply,
+  // which beats our three 32-bit ones.
+  hash_batch_scalar<N>(hasher, keys, hashcodes);
+#else
+  if (cpu_has_avx2()) {
+    splitmix_hash_batch_avx2<N>(hasher, keys, hashcodes);
+  } else {
+    hash_batch_scalar<N>(hasher, keys, hashcodes);
+  }
+#endif
+}
+
+/// @brief  Multiply-shift of 8 keys per AVX2 iteration.
+///
+/// We only need bits [32, 64) of a * x + b, and x is 32 bits, so we split a
+/// into 32-bit halves: a * x = a_lo * x + ((a_hi * x) << 32).
+template<size_t N>
+MM_TARGET_AVX2 inline void
+multiply_shift_hash_batch_avx2(const MultiplyShiftHash &hasher, const KeyType *keys, HashCodeType *hashcodes)
+{
+  static_assert(N % 8 == 0, "AVX2 batch hashing works on multiples of 8 keys");
+  const __m256i a_lo = _mm256_set1_epi64x(static_cast<long long>(hasher.multiplier & 0xffffffffULL));
+  const __m256i a_hi = _mm256_set1_epi64x(static_cast<long long>(hasher.multiplier >> 32));
+  const __m256i b = _mm256_set1_epi64x(static_cast<long long>(hasher.increment));
+  for (size_t i = 0; i < N; i += 8) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+    // _mm256_mul_epu32 multiplies the even 32-bit lanes, so do the odd ones
+    // after shifting them down.
+    const __m256i x_odd = _mm256_srli_epi64(x, 32);
+    __m256i even = _mm256_add_epi64(_mm256_mul_epu32(a_lo, x),
+        _mm256_slli_epi64(_mm256_mul_epu32(a_hi, x), 32));
+    __m256i odd = _mm256_add_epi64(_mm256_mul_epu32(a_lo, x_odd),
+        _mm256_slli_epi64(_mm256_mul_epu32(a_hi, x_odd), 32));
+    even = _mm256_srli_epi64(_mm256_add_epi64(even, b), 32);
+    odd = _mm256_add_epi64(odd, b);
+    // Even results sit in the low halves; odd results are already in the high
+    // halves of their 64-bit lanes.
+    const __m256i r = _mm256_blend_epi32(even, odd, 0xaa);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(hashcodes + i), r);
+  }
+}
+
+template<size_t N>
+inline void
+hash_batch(const MultiplyShiftHash &hasher, const KeyType *keys, HashCodeType *hashcodes)
+{
+  if (cpu_has_avx2()) {
+    multiply_shift_hash_batch_avx2<N>(hasher, keys, hashcodes);
+  } else {
+    hash_batch_scalar<N>(hasher, keys, hashcodes);
+  }
+}
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/// @brief  Split [0, size) into num_threads contiguous ranges and call
+///         fn(begin, end) on each range from its own thread.
+///
+/// N.B.  The calling thread takes the first range, so num_threads == 1 does
+///       not spawn anything. fn must be safe to call concurrently.
+template<typename RangeFn>
+inline void
+parallel_for_ranges(const size_t size, size_t num_threads, RangeFn &&fn)
+{
+  num_threads = std::clamp<size_t>(num_threads, 1, std::max<size_t>(size, 1));
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < num_threads; ++t) {
+    threads.emplace_back([&fn, size, num_threads, t]() {
+      fn(size * t / num_threads, size * (t + 1) / num_threads);
+    });
+  }
+  fn(0, size / num_threads);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
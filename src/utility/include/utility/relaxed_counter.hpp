@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+
+/// @brief  A relaxed atomic counter that, unlike std::atomic, can be copied,
+///         so that a value type (e.g. a table) can hold one.
+///
+/// It is meant for statistics that const (e.g. reading) methods update and
+/// that may run in concurrent threads. add() is a relaxed load and a store
+/// rather than a read-modify-write, so it costs no more than a plain
+/// increment, and updates that race may be lost. A copy holds whatever value
+/// the source had when it was loaded.
+template<typename T>
+class RelaxedCounter {
+public:
+  RelaxedCounter() = default;
+
+  RelaxedCounter(const T value) : value_(value) {}
+
+  RelaxedCounter(const RelaxedCounter &other) : value_(other.load()) {}
+
+  RelaxedCounter &
+  operator=(const RelaxedCounter &other)
+  {
+    this->store(other.load());
+    return *this;
+  }
+
+  T
+  load() const
+  {
+    return this->value_.load(std::memory_order_relaxed);
+  }
+
+  void
+  store(const T value)
+  {
+    this->value_.store(value, std::memory_order_relaxed);
+  }
+
+  /// @return the new value.
+  T
+  add(const T delta)
+  {
+    const T value = static_cast<T>(this->load() + delta);
+    this->store(value);
+    return value;
+  }
+
+private:
+  std::atomic<T> value_ = 0;
+};
@@ -1,13 +1,23 @@
 #pragma once
 #include "common/types.hpp"
 #include "common/logger.hpp"
+#include "utility/hash.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 /// UTILITIES (static helper functions common to sequential and parallel implementations)
 ////////////////////////////////////////////////////////////////////////////////
 
-HashCodeType
-hash(const KeyType key);
+/// N.B.  These are inline (and do not log) so that they do not depend on LTO to
+///       be inlined into the probe loops.
 
-size_t
-get_home(const HashCodeType hashcode, const size_t capacity);
+/// @brief  The original unseeded hash. The tables use a seeded DefaultHash.
+inline HashCodeType
+hash(const KeyType key) {
+  return SplitMixHash{}(key);
+}
+
+inline size_t
+get_home(const HashCodeType hashcode, const size_t capacity) {
+  size_t h = static_cast<size_t>(hashcode);
+  return h % capacity;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+/// @brief  A mutex for writers plus a version counter (i.e. a seqlock) so that
+///         readers can read without locking and retry if a writer interfered.
+///
+/// Writers lock() and unlock() as usual; the version is odd while a writer
+/// holds the lock. Readers call read_begin(), read the protected data with
+/// relaxed atomic loads, and then retry if read_retry(version) is true.
+///
+/// Each lock gets its own cache line so that stripes do not false-share.
+class alignas(64) VersionedLock {
+public:
+  void
+  lock()
+  {
+    this->mutex_.lock();
+    this->version_.fetch_add(1, std::memory_order_relaxed);
+    // Readers that see any of our writes must also see the odd version.
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void
+  unlock()
+  {
+    this->version_.fetch_add(1, std::memory_order_release);
+    this->mutex_.unlock();
+  }
+
+  /// @brief  Wait until no writer holds the lock.
+  ///
+  /// @return the version to pass to read_retry().
+  uint64_t
+  read_begin() const
+  {
+    while (true) {
+      const uint64_t version = this->version_.load(std::memory_order_acquire);
+      if ((version & 1) == 0) {
+        return version;
+      }
+    }
+  }
+
+  /// @brief  Whether a writer may have changed the data since read_begin().
+  bool
+  read_retry(const uint64_t version) const
+  {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return this->version_.load(std::memory_order_relaxed) != version;
+  }
+
+private:
+  std::mutex mutex_;
+  std::atomic<uint64_t> version_ = 0;
+};
@@ -0,0 +1,154 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "common/engine.hpp"
+#include "common/types.hpp"
+#include "cuckoo/cuckoo.hpp"
+#include "delegation/delegation.hpp"
+#include "flat_combining/flat_combining.hpp"
+#include "hopscotch/hopscotch.hpp"
+#include "naive_parallel/naive_parallel.hpp"
+#include "parallel/parallel.hpp"
+#include "sequential/sequential.hpp"
+#include "test_common/engine_variants.hpp"
+#include "trace/trace.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// ALLOCATION HOOK
+////////////////////////////////////////////////////////////////////////////////
+
+/// Every heap allocation made through operator new, by any thread (including
+/// the delegation engine's owner threads).
+static std::atomic<size_t> num_allocations = 0;
+
+void *
+operator new(const std::size_t size)
+{
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *
+operator new(const std::size_t size, const std::align_val_t alignment)
+{
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc() wants a multiple of the alignment.
+    if (void *p = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// TESTS
+////////////////////////////////////////////////////////////////////////////////
+
+template<HashTableEngine HashTable>
+void
+run_trace(HashTable &hash_table, const std::vector<Trace> &traces)
+{
+    for (const auto &trace : traces) {
+        switch (trace.op) {
+            case TraceOperator::insert: {
+                hash_table.insert(trace.key, trace.value);
+                break;
+            }
+            case TraceOperator::search: {
+                hash_table.search(trace.key);
+                break;
+            }
+            case TraceOperator::remove: {
+                hash_table.remove(trace.key);
+                break;
+            }
+        }
+    }
+}
+
+//fill an engine, run trace on it twice, and check that the second run
+//allocates nothing
+template<HashTableEngine HashTable>
+bool
+test_allocations_on_engine(const std::string &name, const std::vector<Trace> &traces, const size_t num_keys)
+{
+    HashTable hash_table;
+    // Fill the table densely, so that inserts displace long chains.
+    for (size_t k = 0; k < num_keys; ++k) {
+        hash_table.insert(static_cast<KeyType>(k), static_cast<ValueType>(k));
+    }
+    // The first run is the warm-up: it may allocate lazily created state
+    // (e.g. thread-local records), but the table is then in a steady state.
+    run_trace(hash_table, traces);
+
+    const size_t before = num_allocations.load(std::memory_order_relaxed);
+    run_trace(hash_table, traces);
+    const size_t allocations = num_allocations.load(std::memory_order_relaxed) - before;
+
+    std::cout << name << ": " << allocations << " allocations in " << traces.size() << " operations ("
+              << static_cast<double>(allocations) / static_cast<double>(traces.size()) << " per operation): "
+              << (allocations == 0 ? "SUCCESS" : "FAILURE") << std::endl;
+    return allocations == 0;
+}
+
+
+int
+main()
+{
+    // A load factor of 3/4 in the engines' default capacity (1 << 20), dense
+    // enough for long Robin Hood chains, yet sparse enough that no resizable
+    // engine grows: the trace only touches these keys.
+    constexpr size_t num_keys = 3 << 18;
+
+    //generate random traces
+    const std::vector<Trace> traces = generate_random_traces(num_keys, 100000);
+
+    bool ok = true;
+    ok &= test_allocations_on_engine<SequentialRobinHoodHashTable>("sequential", traces, num_keys);
+    ok &= test_allocations_on_engine<SkewAwareSequentialRobinHoodHashTable>("sequential_skew", traces, num_keys);
+    ok &= test_allocations_on_engine<FilteredSequentialRobinHoodHashTable>("sequential_filtered", traces, num_keys);
+    ok &= test_allocations_on_engine<NaiveParallelRobinHoodHashTable>("naive_parallel", traces, num_keys);
+    ok &= test_allocations_on_engine<ParallelRobinHoodHashTable>("parallel", traces, num_keys);
+    ok &= test_allocations_on_engine<StripedParallelRobinHoodHashTable>("parallel_striped", traces, num_keys);
+    ok &= test_allocations_on_engine<OptimisticParallelRobinHoodHashTable>("parallel_optimistic", traces, num_keys);
+    ok &= test_allocations_on_engine<SequentialHopscotchHashTable>("sequential_hopscotch", traces, num_keys);
+    ok &= test_allocations_on_engine<ParallelHopscotchHashTable>("parallel_hopscotch", traces, num_keys);
+    ok &= test_allocations_on_engine<SequentialCuckooHashTable>("sequential_cuckoo", traces, num_keys);
+    ok &= test_allocations_on_engine<ParallelCuckooHashTable>("parallel_cuckoo", traces, num_keys);
+    ok &= test_allocations_on_engine<DelegationHashTable>("delegation", traces, num_keys);
+    ok &= test_allocations_on_engine<FlatCombiningHashTable>("flat_combining", traces, num_keys);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+
+#include "parallel/parallel.hpp"
+#include "sequential/sequential.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// ENGINE VARIANTS
+////////////////////////////////////////////////////////////////////////////////
+
+/// Each of these is an engine with one of its modes switched on, so that the
+/// tests and the performance test can run the mode as an engine of its own
+/// (e.g. to compare it against the plain engine in one run). Define a mode's
+/// variant here, once, and add it to each harness's list of engines.
+
+/// @brief  The sequential engine with skew-aware placement (see
+///         SequentialTableOptions::heat_sample_period).
+class SkewAwareSequentialRobinHoodHashTable : public SequentialRobinHoodHashTable {
+public:
+    SkewAwareSequentialRobinHoodHashTable()
+        : SequentialRobinHoodHashTable(SequentialTableOptions{.heat_sample_period = 8})
+    {
+    }
+};
+
+/// @brief  The sequential engine with a miss filter (see
+///         SequentialTableOptions::miss_filter).
+class FilteredSequentialRobinHoodHashTable : public SequentialRobinHoodHashTable {
+public:
+    FilteredSequentialRobinHoodHashTable()
+        : SequentialRobinHoodHashTable(SequentialTableOptions{.miss_filter = true})
+    {
+    }
+};
+
+/// @brief  The parallel engine with segment locks instead of per-bucket locks
+///         (see ParallelTableOptions::lock_segment_size).
+class StripedParallelRobinHoodHashTable : public ParallelRobinHoodHashTable {
+public:
+    static constexpr size_t default_lock_segment_size = 64;
+
+    StripedParallelRobinHoodHashTable() : StripedParallelRobinHoodHashTable(ParallelTableOptions{}) {}
+
+    explicit StripedParallelRobinHoodHashTable(const ParallelTableOptions &options,
+                                               const size_t lock_segment_size = default_lock_segment_size)
+        : ParallelRobinHoodHashTable(striped(options, lock_segment_size))
+    {
+    }
+
+private:
+    static ParallelTableOptions
+    striped(ParallelTableOptions options, const size_t lock_segment_size)
+    {
+        options.lock_segment_size = lock_segment_size;
+        return options;
+    }
+};
+
+/// @brief  The parallel engine with optimistic two-phase inserts (see
+///         ParallelTableOptions::optimistic_insert).
+class OptimisticParallelRobinHoodHashTable : public ParallelRobinHoodHashTable {
+public:
+    OptimisticParallelRobinHoodHashTable() : OptimisticParallelRobinHoodHashTable(ParallelTableOptions{}) {}
+
+    explicit OptimisticParallelRobinHoodHashTable(const ParallelTableOptions &options)
+        : ParallelRobinHoodHashTable(optimistic(options))
+    {
+    }
+
+private:
+    static ParallelTableOptions
+    optimistic(ParallelTableOptions options)
+    {
+        options.optimistic_insert = true;
+        return options;
+    }
+};
+
+/// @brief  The parallel engine with a per-thread front cache (see
+///         ParallelTableOptions::front_cache).
+class FrontCachedParallelRobinHoodHashTable : public ParallelRobinHoodHashTable {
+public:
+    FrontCachedParallelRobinHoodHashTable() : FrontCachedParallelRobinHoodHashTable(ParallelTableOptions{}) {}
+
+    explicit FrontCachedParallelRobinHoodHashTable(const ParallelTableOptions &options)
+        : ParallelRobinHoodHashTable(front_cached(options))
+    {
+    }
+
+private:
+    static ParallelTableOptions
+    front_cached(ParallelTableOptions options)
+    {
+        options.front_cache = true;
+        return options;
+    }
+};
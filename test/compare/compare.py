@@ -0,0 +1,193 @@
+#!/usr/bin/python3
+"""
+Compare two sets of performance test results and fail on a regression.
+
+A result set is either one JSON file written by performance_test_exe or a
+directory of them; files are matched by their path relative to the set. For
+every engine and worker count present in both sets, we compare the closed-loop
+throughput, and for every target QPS present in both, the open-loop p99
+latency. A change is a regression if it is worse than the threshold *and*
+statistically significant (Welch's t-test over the repetitions).
+
+Exit status: 0 if there is no regression, 1 if there is, 2 on bad input.
+"""
+
+import argparse
+import json
+import math
+import os
+import sys
+from typing import Dict, List, Optional
+
+
+def load_result_set(path: str) -> Dict[str, Dict]:
+    """
+    Return {relative path: parsed JSON} for a file or a directory of files.
+    """
+    if os.path.isfile(path):
+        with open(path) as f:
+            return {os.path.basename(path): json.load(f)}
+    results = {}
+    for root, _, files in os.walk(path):
+        for name in sorted(files):
+            if not name.endswith(".json"):
+                continue
+            full_path = os.path.join(root, name)
+            with open(full_path) as f:
+                results[os.path.relpath(full_path, path)] = json.load(f)
+    return results
+
+
+def _continued_fraction_beta(a: float, b: float, x: float) -> float:
+    # Source: Numerical Recipes, 3rd edition, section 6.4 (modified Lentz).
+    tiny = 1e-300
+    qab, qap, qam = a + b, a + 1.0, a - 1.0
+    c, d = 1.0, 1.0 - qab * x / qap
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    h = d
+    for m in range(1, 300):
+        m2 = 2 * m
+        aa = m * (b - m) * x / ((qam + m2) * (a + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        h *= d * c
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        delta = d * c
+        h *= delta
+        if abs(delta - 1.0) < 1e-12:
+            break
+    return h
+
+
+def regularized_incomplete_beta(a: float, b: float, x: float) -> float:
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    log_front = (math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b)
+                 + a * math.log(x) + b * math.log(1.0 - x))
+    if x < (a + 1.0) / (a + b + 2.0):
+        return math.exp(log_front) * _continued_fraction_beta(a, b, x) / a
+    return 1.0 - math.exp(log_front) * _continued_fraction_beta(b, a, 1.0 - x) / b
+
+
+def welch_t_test(xs: List[float], ys: List[float]) -> Optional[float]:
+    """
+    Return the two-sided p-value of Welch's t-test, or None if either side has
+    fewer than two samples.
+    """
+    if len(xs) < 2 or len(ys) < 2:
+        return None
+    mx, my = sum(xs) / len(xs), sum(ys) / len(ys)
+    vx = sum((x - mx) ** 2 for x in xs) / (len(xs) - 1)
+    vy = sum((y - my) ** 2 for y in ys) / (len(ys) - 1)
+    sx, sy = vx / len(xs), vy / len(ys)
+    if sx + sy == 0.0:
+        return 1.0 if mx == my else 0.0
+    t = (mx - my) / math.sqrt(sx + sy)
+    df = (sx + sy) ** 2 / ((sx ** 2) / (len(xs) - 1) + (sy ** 2) / (len(ys) - 1))
+    return regularized_incomplete_beta(df / 2.0, 0.5, df / (df + t * t))
+
+
+def median(xs: List[float]) -> float:
+    s = sorted(xs)
+    n = len(s)
+    return s[n // 2] if n % 2 == 1 else (s[n // 2 - 1] + s[n // 2]) / 2.0
+
+
+class Comparison:
+    def __init__(self, name: str, metric: str, baseline: List[float], candidate: List[float],
+                 higher_is_better: bool):
+        self.name = name
+        self.metric = metric
+        self.baseline = median(baseline)
+        self.candidate = median(candidate)
+        self.p_value = welch_t_test(baseline, candidate)
+        change = (self.candidate - self.baseline) / self.baseline * 100.0 if self.baseline else 0.0
+        # Positive means "worse" regardless of the metric's direction.
+        self.worse_by_percent = -change if higher_is_better else change
+        self.change_percent = change
+
+    def is_regression(self, threshold_percent: float, alpha: float) -> bool:
+        if self.worse_by_percent <= threshold_percent:
+            return False
+        # Without repetitions we cannot test significance, so the threshold alone decides.
+        return self.p_value is None or self.p_value < alpha
+
+
+def compare_files(name: str, baseline: Dict, candidate: Dict) -> List[Comparison]:
+    comparisons = []
+    for engine, b_engine in baseline.get("engines", {}).items():
+        c_engine = candidate.get("engines", {}).get(engine)
+        if c_engine is None:
+            continue
+        c_by_threads = {r["threads"]: r for r in c_engine.get("closed_loop", [])}
+        for b in b_engine.get("closed_loop", []):
+            c = c_by_threads.get(b["threads"])
+            if c is None:
+                continue
+            comparisons.append(Comparison(
+                f"{name}:{engine}:threads={b['threads']}", "throughput [ops/s]",
+                b["throughput_ops_per_sec"]["samples"], c["throughput_ops_per_sec"]["samples"],
+                higher_is_better=True))
+        c_by_qps = {r["target_qps"]: r for r in c_engine.get("open_loop", [])}
+        for b in b_engine.get("open_loop", []):
+            c = c_by_qps.get(b["target_qps"])
+            if c is None:
+                continue
+            comparisons.append(Comparison(
+                f"{name}:{engine}:qps={b['target_qps']:g}", "p99 latency [ns]",
+                b["p99_ns_per_repetition"]["samples"], c["p99_ns_per_repetition"]["samples"],
+                higher_is_better=False))
+    return comparisons
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--baseline", required=True, help="baseline JSON file or directory")
+    parser.add_argument("--candidate", required=True, help="candidate JSON file or directory")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="percent by which a metric must get worse to count as a regression [default 5]")
+    parser.add_argument("--alpha", type=float, default=0.05,
+                        help="significance level of Welch's t-test [default 0.05]")
+    args = parser.parse_args()
+
+    try:
+        baseline = load_result_set(args.baseline)
+        candidate = load_result_set(args.candidate)
+    except (OSError, json.JSONDecodeError) as e:
+        print(f"Cannot load results: {e}", file=sys.stderr)
+        return 2
+    # Two single files are compared with each other whatever their names.
+    if os.path.isfile(args.baseline) and os.path.isfile(args.candidate):
+        candidate = {name: candidate[c] for name, c in zip(baseline, candidate)}
+    common = sorted(set(baseline) & set(candidate))
+    if not common:
+        print("No result files in common between baseline and candidate", file=sys.stderr)
+        return 2
+
+    comparisons: List[Comparison] = []
+    for name in common:
+        comparisons += compare_files(name, baseline[name], candidate[name])
+
+    num_regressions = 0
+    print(f"{'configuration':<60} {'metric':<20} {'baseline':>14} {'candidate':>14} {'change':>9} {'p-value':>8}")
+    for c in comparisons:
+        regression = c.is_regression(args.threshold, args.alpha)
+        num_regressions += regression
+        p = "n/a" if c.p_value is None else f"{c.p_value:.3f}"
+        print(f"{c.name:<60} {c.metric:<20} {c.baseline:>14.4g} {c.candidate:>14.4g} "
+              f"{c.change_percent:>+8.2f}% {p:>8}{'  REGRESSION' if regression else ''}")
+    print(f"{num_regressions} regression(s) in {len(comparisons)} comparison(s) "
+          f"(threshold {args.threshold}%, alpha {args.alpha})")
+    return 1 if num_regressions > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
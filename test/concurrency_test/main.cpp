@@ -0,0 +1,364 @@
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/status.hpp"
+#include "common/types.hpp"
+#include "naive_parallel/naive_parallel.hpp"
+#include "parallel/parallel.hpp"
+#include "parallel/pointer_table.hpp"
+#include "test_common/engine_variants.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+/// HELPERS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  A value that remembers its key and marks itself dead when it is
+///         freed, so that a reader can tell if it was freed too early.
+struct CheckedValue {
+    static constexpr uint64_t alive = 0xA11CE;
+    static constexpr uint64_t dead = 0xDEAD;
+
+    explicit CheckedValue(const KeyType key) : key(key) {}
+    ~CheckedValue() { canary = dead; }
+
+    bool
+    ok(const KeyType k) const
+    {
+        return key == k && canary == alive;
+    }
+
+    KeyType key;
+    uint64_t canary = alive;
+};
+
+/// @brief  Find num_keys keys whose homes are within window buckets of the
+///         end of the table (half before it, half after it, so that the
+///         cluster wraps around), i.e. keys that all collide into one cluster.
+template<typename HashTable>
+std::vector<KeyType>
+find_hot_keys(const HashTable &hash_table, const size_t capacity, const size_t window, const size_t num_keys)
+{
+    std::vector<KeyType> keys;
+    for (KeyType k = 0; keys.size() < num_keys; ++k) {
+        const size_t home = hash_table.home_of(k);
+        if (home < window / 2 || home >= capacity - window / 2) {
+            keys.push_back(k);
+        }
+    }
+    return keys;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// TESTS
+////////////////////////////////////////////////////////////////////////////////
+
+//writers insert, search, and remove their own keys in one hot cluster while
+//readers search a set of keys that never change; check every result, then the
+//final contents against a reference map
+template<typename HashTable, typename... Args>
+bool
+test_hot_cluster(const std::string &name, const Args &...args)
+{
+    constexpr size_t num_writers = 4;
+    constexpr size_t num_readers = 2;
+    constexpr size_t keys_per_writer = 128;
+    constexpr size_t num_stable_keys = 128;
+    constexpr size_t ops_per_writer = 100000;
+
+    HashTable hash_table(args...);
+    const size_t capacity = hash_table.stats().capacity;
+    const std::vector<KeyType> keys =
+            find_hot_keys(hash_table, capacity, 64, num_writers * keys_per_writer + num_stable_keys);
+    const KeyType *stable_keys = &keys[num_writers * keys_per_writer];
+    for (size_t i = 0; i < num_stable_keys; ++i) {
+        hash_table.insert(stable_keys[i], static_cast<ValueType>(i));
+    }
+
+    std::atomic<size_t> errors = 0;
+    std::atomic<size_t> writers_done = 0;
+    std::vector<std::unordered_map<KeyType, ValueType>> references(num_writers);
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < num_writers; ++w) {
+        threads.emplace_back([&, w] {
+            // Only this thread touches its keys, so its reference is exact.
+            std::unordered_map<KeyType, ValueType> &reference = references[w];
+            std::mt19937 rng(static_cast<unsigned>(w));
+            for (size_t i = 0; i < ops_per_writer; ++i) {
+                const KeyType key = keys[w * keys_per_writer + rng() % keys_per_writer];
+                const auto it = reference.find(key);
+                switch (rng() % 3) {
+                    case 0: {
+                        const ValueType value = static_cast<ValueType>(i);
+                        hash_table.insert(key, value);
+                        reference[key] = value;
+                        break;
+                    }
+                    case 1: {
+                        const std::optional<ValueType> r = hash_table.search(key);
+                        if (r.has_value() != (it != reference.end()) || (r.has_value() && r.value() != it->second)) {
+                            ++errors;
+                        }
+                        break;
+                    }
+                    case 2: {
+                        const bool removed = hash_table.remove(key) == ErrorType::ok;
+                        if (removed != (it != reference.end())) {
+                            ++errors;
+                        }
+                        if (it != reference.end()) {
+                            reference.erase(it);
+                        }
+                        break;
+                    }
+                }
+            }
+            ++writers_done;
+        });
+    }
+    for (size_t r = 0; r < num_readers; ++r) {
+        threads.emplace_back([&, r] {
+            // The entries move as the writers shift the cluster around them,
+            // but they must never be missing.
+            for (size_t i = r; writers_done.load() < num_writers; ++i) {
+                const size_t k = i % num_stable_keys;
+                const std::optional<ValueType> v = hash_table.search(stable_keys[k]);
+                if (!v.has_value() || v.value() != static_cast<ValueType>(k)) {
+                    ++errors;
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    size_t expected_size = num_stable_keys;
+    for (size_t w = 0; w < num_writers; ++w) {
+        expected_size += references[w].size();
+        for (size_t i = 0; i < keys_per_writer; ++i) {
+            const KeyType key = keys[w * keys_per_writer + i];
+            const auto it = references[w].find(key);
+            const std::optional<ValueType> r = hash_table.search(key);
+            if (r.has_value() != (it != references[w].end()) || (r.has_value() && r.value() != it->second)) {
+                ++errors;
+            }
+        }
+    }
+    if (hash_table.size() != expected_size) {
+        ++errors;
+    }
+
+    std::cout << name << " hot cluster: " << errors.load() << " errors: "
+              << (errors.load() == 0 ? "SUCCESS" : "FAILURE") << std::endl;
+    return errors.load() == 0;
+}
+
+//one writer keeps overwriting a set of hot keys with increasing values (and
+//inserts and removes other keys among them, shifting them around) while
+//readers, which answer mostly from their front caches, check that no key's
+//value ever goes backwards and that they all see the final values
+template<typename HashTable, typename... Args>
+bool
+test_front_cache(const std::string &name, const Args &...args)
+{
+    constexpr size_t num_readers = 3;
+    constexpr size_t num_hot_keys = 64;
+    constexpr size_t num_churn_keys = 64;
+    constexpr size_t num_rounds = 5000;
+
+    HashTable hash_table(args...);
+    const size_t capacity = hash_table.stats().capacity;
+    const std::vector<KeyType> keys = find_hot_keys(hash_table, capacity, 64, num_hot_keys + num_churn_keys);
+    const KeyType *hot_keys = &keys[0];
+    const KeyType *churn_keys = &keys[num_hot_keys];
+    for (size_t i = 0; i < num_hot_keys; ++i) {
+        hash_table.insert(hot_keys[i], 0);
+    }
+
+    std::atomic<size_t> errors = 0;
+    std::atomic<bool> writer_done = false;
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        for (size_t round = 1; round <= num_rounds; ++round) {
+            for (size_t i = 0; i < num_hot_keys; ++i) {
+                hash_table.insert(hot_keys[i], static_cast<ValueType>(round));
+            }
+            const KeyType churn_key = churn_keys[round % num_churn_keys];
+            if (round / num_churn_keys % 2 == 0) {
+                hash_table.insert(churn_key, 0);
+            } else {
+                hash_table.remove(churn_key);
+            }
+        }
+        writer_done.store(true);
+    });
+    for (size_t r = 0; r < num_readers; ++r) {
+        threads.emplace_back([&] {
+            std::vector<ValueType> last_seen(num_hot_keys, 0);
+            while (!writer_done.load()) {
+                for (size_t i = 0; i < num_hot_keys; ++i) {
+                    const std::optional<ValueType> v = hash_table.search(hot_keys[i]);
+                    if (!v.has_value() || v.value() < last_seen[i]) {
+                        ++errors;
+                    } else {
+                        last_seen[i] = v.value();
+                    }
+                }
+            }
+            for (size_t i = 0; i < num_hot_keys; ++i) {
+                const std::optional<ValueType> v = hash_table.search(hot_keys[i]);
+                if (!v.has_value() || v.value() != static_cast<ValueType>(num_rounds)) {
+                    ++errors;
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    std::cout << name << " front cache: " << errors.load() << " errors: "
+              << (errors.load() == 0 ? "SUCCESS" : "FAILURE") << std::endl;
+    return errors.load() == 0;
+}
+
+//one writer keeps replacing and removing values while readers hold the
+//values they find under a guard and check that they stay readable; then check
+//that everything retired is reclaimed, and that running out of handles is
+//reported (and recovered from) rather than asserted
+bool
+test_reclamation()
+{
+    constexpr size_t num_readers = 3;
+    constexpr KeyType num_keys = 64;
+    constexpr size_t num_rounds = 2000;
+    constexpr size_t num_handles = 4 * num_keys;
+
+    std::atomic<size_t> errors = 0;
+    ParallelPointerTable<CheckedValue> table(num_handles);
+    for (KeyType k = 0; k < num_keys; ++k) {
+        table.insert(k, std::make_unique<CheckedValue>(k));
+    }
+
+    std::atomic<bool> writer_done = false;
+    std::vector<std::thread> readers;
+    for (size_t r = 0; r < num_readers; ++r) {
+        readers.emplace_back([&] {
+            while (!writer_done.load()) {
+                const auto guard = table.pin();
+                std::vector<std::pair<KeyType, const CheckedValue *>> held;
+                for (KeyType k = 0; k < num_keys; ++k) {
+                    const CheckedValue *v = table.search(k, guard);
+                    if (v != nullptr) {
+                        held.emplace_back(k, v);
+                    }
+                }
+                // By now the writer has replaced or removed many of these,
+                // but none may be freed while we are pinned.
+                std::this_thread::yield();
+                for (const auto &[k, v] : held) {
+                    if (!v->ok(k)) {
+                        ++errors;
+                    }
+                }
+            }
+        });
+    }
+    uint64_t reclaimed_midway = 0;
+    for (size_t round = 0; round < num_rounds; ++round) {
+        for (KeyType k = 0; k < num_keys; ++k) {
+            // Handles come back as readers unpin; until then, wait for them.
+            while (table.insert(k, std::make_unique<CheckedValue>(k)) != ErrorType::ok) {
+                std::this_thread::yield();
+            }
+            if ((k + round) % 4 == 0) {
+                table.remove(k);
+            }
+        }
+        if (round == num_rounds / 2) {
+            reclaimed_midway = table.domain().num_reclaimed();
+        }
+    }
+    writer_done.store(true);
+    for (auto &t : readers) {
+        t.join();
+    }
+    if (reclaimed_midway == 0) {
+        std::cout << "reclamation: nothing was reclaimed while the readers ran" << std::endl;
+        ++errors;
+    }
+    // With nobody pinned, two epochs pass and everything this thread retired
+    // is reclaimed.
+    table.domain().collect();
+    table.domain().collect();
+    if (table.domain().num_reclaimed() != table.domain().num_retired()) {
+        std::cout << "reclamation: " << table.domain().num_retired() - table.domain().num_reclaimed()
+                  << " retired objects were not reclaimed" << std::endl;
+        ++errors;
+    }
+
+    //every handle in use: insert fails cleanly, and works again once a
+    //removed key's handle is reclaimed
+    ParallelPointerTable<CheckedValue> small(num_keys);
+    for (KeyType k = 0; k < num_keys; ++k) {
+        if (small.insert(k, std::make_unique<CheckedValue>(k)) != ErrorType::ok) {
+            ++errors;
+        }
+    }
+    if (small.insert(num_keys, std::make_unique<CheckedValue>(num_keys)) != ErrorType::e_oom) {
+        std::cout << "reclamation: insert did not report running out of handles" << std::endl;
+        ++errors;
+    }
+    small.remove(0);
+    if (small.insert(num_keys, std::make_unique<CheckedValue>(num_keys)) != ErrorType::ok) {
+        std::cout << "reclamation: a removed key's handle was not reused" << std::endl;
+        ++errors;
+    }
+    {
+        const auto guard = small.pin();
+        const CheckedValue *v = small.search(num_keys, guard);
+        if (v == nullptr || !v->ok(num_keys) || small.search(0, guard) != nullptr) {
+            ++errors;
+        }
+    }
+
+    std::cout << "pointer table reclamation: " << errors.load() << " errors: "
+              << (errors.load() == 0 ? "SUCCESS" : "FAILURE") << std::endl;
+    return errors.load() == 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const std::string test = argc > 1 ? argv[1] : "hot_cluster";
+
+    bool ok = true;
+    if (test == "hot_cluster") {
+        ok &= test_hot_cluster<NaiveParallelRobinHoodHashTable>("naive_parallel");
+        ok &= test_hot_cluster<ParallelRobinHoodHashTable>("parallel");
+        ok &= test_hot_cluster<StripedParallelRobinHoodHashTable>("parallel_striped");
+        ok &= test_hot_cluster<OptimisticParallelRobinHoodHashTable>("parallel_optimistic");
+        ok &= test_hot_cluster<OptimisticParallelRobinHoodHashTable>(
+                "parallel_optimistic_striped",
+                ParallelTableOptions{.lock_segment_size = StripedParallelRobinHoodHashTable::default_lock_segment_size});
+    } else if (test == "front_cache") {
+        ok &= test_front_cache<FrontCachedParallelRobinHoodHashTable>("parallel_front_cache");
+        ok &= test_front_cache<FrontCachedParallelRobinHoodHashTable>(
+                "parallel_front_cache_striped",
+                ParallelTableOptions{.lock_segment_size = StripedParallelRobinHoodHashTable::default_lock_segment_size});
+    } else if (test == "reclamation") {
+        ok &= test_reclamation();
+    } else {
+        std::cerr << "Unknown test '" << test << "'" << std::endl;
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
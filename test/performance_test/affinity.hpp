@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/// @brief  How worker threads are placed onto CPUs.
+///
+/// - none: let the OS scheduler place (and migrate) threads.
+/// - compact: fill the hyperthreads of a core, then the cores of a socket,
+///   then the next socket.
+/// - scatter: spread threads across sockets first, then cores, and only then
+///   use hyperthread siblings.
+/// - list: an explicit list of CPU ids, assigned round-robin.
+enum class AffinityPolicy {
+    none,
+    compact,
+    scatter,
+    list,
+};
+
+struct CpuInfo {
+    int cpu = 0;
+    int package = 0;
+    int core = 0;
+};
+
+static int
+read_sysfs_int(const std::string &path, const int default_value)
+{
+    std::ifstream f(path);
+    int v = default_value;
+    if (!(f >> v)) {
+        return default_value;
+    }
+    return v;
+}
+
+/// @brief  Return the CPUs this process may run on, with their topology.
+///
+/// N.B.  If sysfs is unavailable, every CPU is treated as its own core on
+///       socket 0, so compact and scatter both degrade to a linear order.
+static std::vector<CpuInfo>
+get_available_cpus()
+{
+    std::vector<CpuInfo> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (size_t i = 0; i < CPU_SETSIZE; ++i) {
+            if (!CPU_ISSET(i, &set)) {
+                continue;
+            }
+            const int cpu = static_cast<int>(i);
+            const std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            cpus.push_back({cpu,
+                            read_sysfs_int(topology + "physical_package_id", 0),
+                            read_sysfs_int(topology + "core_id", cpu)});
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        const int n = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for (int cpu = 0; cpu < n; ++cpu) {
+            cpus.push_back({cpu, 0, cpu});
+        }
+    }
+    return cpus;
+}
+
+/// @brief  Order the available CPUs according to the policy. Worker i is then
+///         pinned to order[i % order.size()].
+static std::vector<int>
+get_cpu_order(const AffinityPolicy policy, const std::vector<int> &cpu_list)
+{
+    if (policy == AffinityPolicy::none) {
+        return {};
+    }
+    if (policy == AffinityPolicy::list) {
+        return cpu_list;
+    }
+
+    std::vector<CpuInfo> cpus = get_available_cpus();
+    // Compact: (package, core, cpu) order keeps siblings adjacent.
+    std::sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b) {
+        return std::tie(a.package, a.core, a.cpu) < std::tie(b.package, b.core, b.cpu);
+    });
+    if (policy == AffinityPolicy::scatter) {
+        // Rank each CPU among its siblings and each core within its package,
+        // then sort by (sibling rank, core rank, package) so consecutive
+        // workers land on different sockets and cores.
+        struct Ranked {
+            CpuInfo info;
+            size_t sibling_rank;
+            size_t core_rank;
+        };
+        std::vector<Ranked> ranked;
+        size_t sibling_rank = 0, core_rank = 0;
+        for (size_t i = 0; i < cpus.size(); ++i) {
+            if (i > 0 && cpus[i].package != cpus[i - 1].package) {
+                core_rank = 0;
+                sibling_rank = 0;
+            } else if (i > 0 && cpus[i].core != cpus[i - 1].core) {
+                ++core_rank;
+                sibling_rank = 0;
+            } else if (i > 0) {
+                ++sibling_rank;
+            }
+            ranked.push_back({cpus[i], sibling_rank, core_rank});
+        }
+        std::stable_sort(ranked.begin(), ranked.end(), [](const Ranked &a, const Ranked &b) {
+            return std::tie(a.sibling_rank, a.core_rank, a.info.package) <
+                   std::tie(b.sibling_rank, b.core_rank, b.info.package);
+        });
+        for (size_t i = 0; i < ranked.size(); ++i) {
+            cpus[i] = ranked[i].info;
+        }
+    }
+
+    std::vector<int> order;
+    for (const auto &c : cpus) {
+        order.push_back(c.cpu);
+    }
+    return order;
+}
+
+/// @brief  Pin the calling thread to a single CPU. Failure is reported but
+///         not fatal.
+///
+/// N.B.  Workers pin themselves before they start their timed work, rather
+///       than being pinned by the spawning thread after the fact.
+static void
+pin_current_thread_to_cpu(const int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(static_cast<size_t>(cpu), &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        std::cerr << "Failed to pin thread to CPU " << cpu << std::endl;
+    }
+#else
+    (void)cpu;
+#endif
+}
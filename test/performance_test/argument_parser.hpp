@@ -1,9 +1,25 @@
 #pragma once
 
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <string>
 #include <iostream>
+#include <vector>
+
+#include "affinity.hpp"
+#include "scheduler.hpp"
+
+/// @brief  The worker counts we swept before they were configurable.
+static std::vector<size_t>
+default_thread_counts()
+{
+    std::vector<size_t> counts;
+    for (size_t w = 1; w <= 32; ++w) {
+        counts.push_back(w);
+    }
+    return counts;
+}
 
 struct PerformanceTestArguments {
     unsigned insert_ratio = 1;
@@ -13,6 +29,34 @@ struct PerformanceTestArguments {
     size_t goal_trace_length = 100000000;
     std::string trace_op_mode = "random";
     std::string output_json_path = "output.json";
+    // Open-loop mode. An empty QPS list means we only run the closed-loop test.
+    std::vector<double> open_loop_qps = {};
+    std::string open_loop_arrival = "constant";
+    size_t open_loop_workers = 4;
+    bool collect_perf_counters = false;
+    // Worker counts for the thread-safe engines.
+    std::vector<size_t> thread_counts = default_thread_counts();
+    std::string affinity = "none";
+    AffinityPolicy affinity_policy = AffinityPolicy::none;
+    std::vector<int> affinity_cpus = {};
+    size_t warmup_runs = 0;
+    bool preload = false;
+    size_t repetitions = 1;
+    // How the closed-loop test divides the trace among the workers.
+    std::string schedule = "static";
+    SchedulePolicy schedule_policy = SchedulePolicy::static_slices;
+    size_t chunk_size = 1024;
+    // Where to write the lock-contention heat maps. Empty means don't.
+    std::string lock_profile_path = "";
+    // Bound the parallel engine's size and evict with CLOCK. Zero means don't.
+    size_t cache_capacity = 0;
+    std::string eviction = "clock";
+    // Buckets per lock for the parallel_striped engine.
+    size_t lock_segment_size = 64;
+    // Give the parallel engines a per-thread cache of recently read keys.
+    bool front_cache = false;
+    // The registered engines to run, in order.
+    std::vector<std::string> engines = {"sequential", "naive_parallel", "parallel"};
 
     void
     print() const
@@ -22,9 +66,95 @@ struct PerformanceTestArguments {
                 ", Max # Keys: " << this->max_num_keys <<
                 ", Goal Trace Length: " << this->goal_trace_length <<
                 ", Output: " << this->output_json_path << std::endl;
+        if (!this->open_loop_qps.empty()) {
+            std::cout << "Open-Loop QPS: [";
+            for (size_t i = 0; i < this->open_loop_qps.size(); ++i) {
+                std::cout << (i == 0 ? "" : ", ") << this->open_loop_qps[i];
+            }
+            std::cout << "], Arrival: '" << this->open_loop_arrival <<
+                    "', Workers: " << this->open_loop_workers << std::endl;
+        }
+        if (this->collect_perf_counters) {
+            std::cout << "Collecting hardware performance counters" << std::endl;
+        }
+        std::cout << "Engines: [";
+        for (size_t i = 0; i < this->engines.size(); ++i) {
+            std::cout << (i == 0 ? "" : ", ") << this->engines[i];
+        }
+        std::cout << "]" << std::endl;
+        std::cout << "Threads: [";
+        for (size_t i = 0; i < this->thread_counts.size(); ++i) {
+            std::cout << (i == 0 ? "" : ", ") << this->thread_counts[i];
+        }
+        std::cout << "], Affinity: '" << this->affinity <<
+                "', Warm-up Runs: " << this->warmup_runs <<
+                ", Preload: " << (this->preload ? "yes" : "no") <<
+                ", Repetitions: " << this->repetitions << std::endl;
+        std::cout << "Schedule: '" << this->schedule << "'";
+        if (this->schedule_policy != SchedulePolicy::static_slices) {
+            std::cout << ", Chunk Size: " << this->chunk_size;
+        }
+        std::cout << std::endl;
+        if (!this->lock_profile_path.empty()) {
+            std::cout << "Lock Profile: " << this->lock_profile_path << std::endl;
+        }
+        if (this->cache_capacity != 0) {
+            std::cout << "Cache Capacity: " << this->cache_capacity <<
+                    ", Eviction: '" << this->eviction << "'" << std::endl;
+        }
+        if (this->front_cache) {
+            std::cout << "Front Cache: yes" << std::endl;
+        }
     }
 };
 
+/// @brief  Parse a comma-separated list of numbers, e.g. "1000,2000,4000".
+static std::vector<double>
+parse_number_list(const char *str)
+{
+    std::vector<double> numbers;
+    const char *p = str;
+    while (*p != '\0') {
+        char *end = nullptr;
+        numbers.push_back(std::strtod(p, &end));
+        if (end == p) {
+            break;
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return numbers;
+}
+
+/// @brief  Parse a comma-separated list of names, e.g. "seq,parallel".
+static std::vector<std::string>
+parse_string_list(const char *str)
+{
+    std::vector<std::string> strings;
+    std::string current;
+    for (const char *p = str; *p != '\0'; ++p) {
+        if (*p == ',') {
+            strings.push_back(current);
+            current.clear();
+        } else {
+            current.push_back(*p);
+        }
+    }
+    strings.push_back(current);
+    return strings;
+}
+
+/// @brief  Parse a comma-separated list of non-negative integers.
+template<typename T>
+static std::vector<T>
+parse_integer_list(const char *str)
+{
+    std::vector<T> integers;
+    for (double x : parse_number_list(str)) {
+        integers.push_back(static_cast<T>(x));
+    }
+    return integers;
+}
+
 static void
 print_help_and_exit(PerformanceTestArguments &args)
 {
@@ -38,6 +168,34 @@ print_help_and_exit(PerformanceTestArguments &args)
     std::cout << "-m, --mode <mode> : trace generator mode {random,ordered} for the trace operations. [Default '" << args.trace_op_mode << "']" << std::endl;
     std::cout << "                    N.B. The option is just the raw string 'random' or 'ordered' without the quotation marks!" << std::endl;
     std::cout << "-o, --output <output-path> : path for the output JSON file relative to cwd. [Default '" << args.output_json_path << "']" << std::endl;
+    std::cout << "-q, --qps <num>[,<num>...] : target aggregate QPS values for the open-loop test. [Default none, i.e. closed-loop only]" << std::endl;
+    std::cout << "                             N.B. each value produces one point on every engine's throughput-latency curve." << std::endl;
+    std::cout << "-a, --arrival <dist> : open-loop arrival distribution {constant,poisson}. [Default '" << args.open_loop_arrival << "']" << std::endl;
+    std::cout << "-w, --open-loop-workers <num> : number of workers for the parallel engines in the open-loop test. [Default " << args.open_loop_workers << "]" << std::endl;
+    std::cout << "-p, --perf-counters : collect hardware performance counters around each timed region (Linux only)." << std::endl;
+    std::cout << "-T, --threads <num>[,<num>...] : worker counts for the thread-safe engines. [Default 1,2,...,32]" << std::endl;
+    std::cout << "-A, --affinity <policy> : worker placement {none,compact,scatter} or an explicit CPU list like '0,2,4,6'. [Default '" << args.affinity << "']" << std::endl;
+    std::cout << "-W, --warmup <num> : number of untimed warm-up runs before each configuration. [Default " << args.warmup_runs << "]" << std::endl;
+    std::cout << "-P, --preload : insert every key once (untimed) before each run." << std::endl;
+    std::cout << "-R, --repetitions <num> : number of timed runs per configuration. [Default " << args.repetitions << "]" << std::endl;
+    std::cout << "                          N.B. we report the median and a 95% confidence interval over the runs." << std::endl;
+    std::cout << "-S, --schedule <policy> : how the closed-loop test divides the trace among workers {static,chunked,stealing}. [Default '" << args.schedule << "']" << std::endl;
+    std::cout << "                          N.B. 'static' gives each worker one contiguous slice; 'chunked' hands out chunks from a shared cursor;" << std::endl;
+    std::cout << "                               'stealing' lets idle workers steal chunks from the others." << std::endl;
+    std::cout << "-C, --chunk-size <num> : number of trace operations per chunk for the dynamic schedules. [Default " << args.chunk_size << "]" << std::endl;
+    std::cout << "-L, --lock-profile <output-path> : write per-region lock contention heat maps to this JSON file." << std::endl;
+    std::cout << "                                  N.B. requires a build with -DMM_PARALLEL_LOCK_PROFILING=ON." << std::endl;
+    std::cout << "-c, --cache-capacity <num> : run the parallel engine as a cache that holds at most this many entries. [Default 0, i.e. unbounded]" << std::endl;
+    std::cout << "-E, --eviction <policy> : the cache's eviction policy {clock,gclock}. [Default '" << args.eviction << "']" << std::endl;
+    std::cout << "                          N.B. 'clock' keeps a reference bit per slot; 'gclock' keeps a counter that saturates at 3." << std::endl;
+    std::cout << "-s, --lock-segment-size <num> : buckets per lock (a power of two) for the parallel_striped engine. [Default " << args.lock_segment_size << "]" << std::endl;
+    std::cout << "-F, --front-cache : give the parallel, parallel_striped, and parallel_optimistic engines a per-thread cache of recently read keys." << std::endl;
+    std::cout << "-e, --engines <name>[,<name>...] : the engines to run, in order. [Default 'sequential,naive_parallel,parallel']" << std::endl;
+    std::cout << "                                   N.B. the engines are sequential (seq), sequential_skew (skew), sequential_filtered (filtered)," << std::endl;
+    std::cout << "                                   naive_parallel (naive), parallel, parallel_striped (striped), parallel_optimistic (optimistic)," << std::endl;
+    std::cout << "                                   sequential_hopscotch (hopscotch_seq), parallel_hopscotch (hopscotch)," << std::endl;
+    std::cout << "                                   sequential_cuckoo (cuckoo_seq), parallel_cuckoo (cuckoo), delegation (delegate)," << std::endl;
+    std::cout << "                                   flat_combining (fc), and std_unordered_map (std)." << std::endl;
     std::cout << "-h, --help : print this help message. This overrides all other arguments!" << std::endl;
     std::cout << "--------------------------------------------------------------------------------" << std::endl;
     exit(1);
@@ -87,6 +245,82 @@ parse_performance_test_arguments(int argc, char *argv[])
         } else if (matches_argument_flag(*argv, "-o", "--output")) {
             ++argv;
             args.output_json_path = std::string(*argv);
+        } else if (matches_argument_flag(*argv, "-q", "--qps")) {
+            ++argv;
+            args.open_loop_qps = parse_number_list(*argv);
+        } else if (matches_argument_flag(*argv, "-a", "--arrival")) {
+            ++argv;
+            args.open_loop_arrival = std::string(*argv);
+            assert((args.open_loop_arrival == "constant" || args.open_loop_arrival == "poisson") &&
+                    "arrival should be {constant,poisson}");
+        } else if (matches_argument_flag(*argv, "-w", "--open-loop-workers")) {
+            ++argv;
+            args.open_loop_workers = std::strtoul(*argv, nullptr, 10);
+        } else if (matches_argument_flag(*argv, "-p", "--perf-counters")) {
+            args.collect_perf_counters = true;
+        } else if (matches_argument_flag(*argv, "-T", "--threads")) {
+            ++argv;
+            args.thread_counts = parse_integer_list<size_t>(*argv);
+        } else if (matches_argument_flag(*argv, "-A", "--affinity")) {
+            ++argv;
+            args.affinity = std::string(*argv);
+            if (args.affinity == "none") {
+                args.affinity_policy = AffinityPolicy::none;
+            } else if (args.affinity == "compact") {
+                args.affinity_policy = AffinityPolicy::compact;
+            } else if (args.affinity == "scatter") {
+                args.affinity_policy = AffinityPolicy::scatter;
+            } else {
+                args.affinity_policy = AffinityPolicy::list;
+                args.affinity_cpus = parse_integer_list<int>(*argv);
+                assert(!args.affinity_cpus.empty() &&
+                        "affinity should be {none,compact,scatter} or a CPU list");
+            }
+        } else if (matches_argument_flag(*argv, "-W", "--warmup")) {
+            ++argv;
+            args.warmup_runs = std::strtoul(*argv, nullptr, 10);
+        } else if (matches_argument_flag(*argv, "-P", "--preload")) {
+            args.preload = true;
+        } else if (matches_argument_flag(*argv, "-R", "--repetitions")) {
+            ++argv;
+            args.repetitions = std::strtoul(*argv, nullptr, 10);
+            assert(args.repetitions > 0 && "need at least one repetition");
+        } else if (matches_argument_flag(*argv, "-S", "--schedule")) {
+            ++argv;
+            args.schedule = std::string(*argv);
+            if (args.schedule == "chunked") {
+                args.schedule_policy = SchedulePolicy::chunked;
+            } else if (args.schedule == "stealing") {
+                args.schedule_policy = SchedulePolicy::work_stealing;
+            } else {
+                assert(args.schedule == "static" && "schedule should be {static,chunked,stealing}");
+                args.schedule_policy = SchedulePolicy::static_slices;
+            }
+        } else if (matches_argument_flag(*argv, "-C", "--chunk-size")) {
+            ++argv;
+            args.chunk_size = std::strtoul(*argv, nullptr, 10);
+            assert(args.chunk_size > 0 && "chunk size must be positive");
+        } else if (matches_argument_flag(*argv, "-L", "--lock-profile")) {
+            ++argv;
+            args.lock_profile_path = std::string(*argv);
+        } else if (matches_argument_flag(*argv, "-c", "--cache-capacity")) {
+            ++argv;
+            args.cache_capacity = std::strtoul(*argv, nullptr, 10);
+        } else if (matches_argument_flag(*argv, "-E", "--eviction")) {
+            ++argv;
+            args.eviction = std::string(*argv);
+            assert((args.eviction == "clock" || args.eviction == "gclock") &&
+                    "eviction should be {clock,gclock}");
+        } else if (matches_argument_flag(*argv, "-s", "--lock-segment-size")) {
+            ++argv;
+            args.lock_segment_size = std::strtoul(*argv, nullptr, 10);
+            assert(args.lock_segment_size != 0 && (args.lock_segment_size & (args.lock_segment_size - 1)) == 0 &&
+                    "lock segment size should be a power of two");
+        } else if (matches_argument_flag(*argv, "-F", "--front-cache")) {
+            args.front_cache = true;
+        } else if (matches_argument_flag(*argv, "-e", "--engines")) {
+            ++argv;
+            args.engines = parse_string_list(*argv);
         } else {
             // NOTE We create a new default argument structure because we
             //      potentially already modified the other structure.
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "common/engine.hpp"
+#include "common/status.hpp"
+#include "common/types.hpp"
+
+/// @brief  std::unordered_map behind one reader-writer lock, as a baseline for
+///         the Robin Hood engines.
+class StdUnorderedMapEngine {
+public:
+    static constexpr EngineCapabilities capabilities = {.thread_safe = true, .resizable = true, .batched = false};
+
+    ErrorType
+    insert(const KeyType key, const ValueType value)
+    {
+        std::unique_lock lock(this->mutex_);
+        this->map_[key] = value;
+        return ErrorType::ok;
+    }
+
+    std::optional<ValueType>
+    search(const KeyType key)
+    {
+        std::shared_lock lock(this->mutex_);
+        const auto it = this->map_.find(key);
+        if (it == this->map_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    ErrorType
+    remove(const KeyType key)
+    {
+        std::unique_lock lock(this->mutex_);
+        return this->map_.erase(key) != 0 ? ErrorType::ok : ErrorType::e_notfound;
+    }
+
+    size_t
+    size()
+    {
+        std::shared_lock lock(this->mutex_);
+        return this->map_.size();
+    }
+
+private:
+    std::shared_mutex mutex_;
+    std::unordered_map<KeyType, ValueType> map_;
+};
+
+static_assert(HashTableEngine<StdUnorderedMapEngine>);
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/// @brief  Log-linear latency histogram (in the spirit of HdrHistogram).
+///
+/// Values below 2^sub_bucket_bits are recorded exactly. Larger values are
+/// recorded in 2^sub_bucket_bits sub-buckets per power of two, which bounds the
+/// relative error to about 3%. Recording is a couple of shifts and an
+/// increment, so each worker keeps its own histogram and we merge them after
+/// the run.
+class LatencyHistogram {
+public:
+    static constexpr unsigned sub_bucket_bits = 5;
+    static constexpr uint64_t sub_bucket_count = uint64_t{1} << sub_bucket_bits;
+    static constexpr size_t bucket_count = (65 - sub_bucket_bits) * sub_bucket_count;
+
+    void
+    record(const uint64_t value_ns)
+    {
+        ++this->counts_[index_of(value_ns)];
+        ++this->total_count_;
+        this->total_ns_ += value_ns;
+        if (value_ns > this->max_ns_) {
+            this->max_ns_ = value_ns;
+        }
+    }
+
+    void
+    merge(const LatencyHistogram &other)
+    {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            this->counts_[i] += other.counts_[i];
+        }
+        this->total_count_ += other.total_count_;
+        this->total_ns_ += other.total_ns_;
+        if (other.max_ns_ > this->max_ns_) {
+            this->max_ns_ = other.max_ns_;
+        }
+    }
+
+    uint64_t
+    count() const
+    {
+        return this->total_count_;
+    }
+
+    uint64_t
+    max() const
+    {
+        return this->max_ns_;
+    }
+
+    double
+    mean() const
+    {
+        if (this->total_count_ == 0) {
+            return 0.0;
+        }
+        return static_cast<double>(this->total_ns_) / static_cast<double>(this->total_count_);
+    }
+
+    /// @brief  Return the value at quantile q in [0, 1].
+    ///
+    /// N.B.  We report the midpoint of the sub-bucket that contains the
+    ///       quantile, clamped to the largest value actually recorded.
+    uint64_t
+    percentile(const double q) const
+    {
+        if (this->total_count_ == 0) {
+            return 0;
+        }
+        const double rank = q * static_cast<double>(this->total_count_);
+        uint64_t target = static_cast<uint64_t>(rank);
+        if (target == 0) {
+            target = 1;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            seen += this->counts_[i];
+            if (seen >= target) {
+                const uint64_t mid = lower_bound_of(i) + width_of(i) / 2;
+                return mid < this->max_ns_ ? mid : this->max_ns_;
+            }
+        }
+        return this->max_ns_;
+    }
+
+private:
+    static size_t
+    index_of(const uint64_t v)
+    {
+        if (v < sub_bucket_count) {
+            return v;
+        }
+        const unsigned msb = 63 - static_cast<unsigned>(std::countl_zero(v));
+        const unsigned shift = msb - sub_bucket_bits;
+        const uint64_t sub = (v >> shift) - sub_bucket_count;
+        return sub_bucket_count + shift * sub_bucket_count + sub;
+    }
+
+    static uint64_t
+    lower_bound_of(const size_t index)
+    {
+        if (index < sub_bucket_count) {
+            return index;
+        }
+        const uint64_t shift = (index - sub_bucket_count) / sub_bucket_count;
+        const uint64_t sub = (index - sub_bucket_count) % sub_bucket_count;
+        return (sub_bucket_count + sub) << shift;
+    }
+
+    static uint64_t
+    width_of(const size_t index)
+    {
+        if (index < sub_bucket_count) {
+            return 1;
+        }
+        return uint64_t{1} << ((index - sub_bucket_count) / sub_bucket_count);
+    }
+
+    std::array<uint64_t, bucket_count> counts_ = {};
+    uint64_t total_count_ = 0;
+    uint64_t total_ns_ = 0;
+    uint64_t max_ns_ = 0;
+};
+
+/// @brief  One point on an engine's throughput-latency curve.
+///
+/// The histogram pools the latencies of every repetition; the per-repetition
+/// samples let us put error bars on the curve.
+struct OpenLoopResult {
+    double target_qps = 0.0;
+    std::vector<double> achieved_qps_samples = {};
+    std::vector<double> p99_ns_samples = {};
+    LatencyHistogram latency = {};
+};
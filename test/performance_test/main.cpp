@@ -1,11 +1,18 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <iostream>
+#include <optional>
+#include <random>
+#include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 #include <chrono>
-#include <ctime>
 
+#include "common/engine.hpp"
 #include "common/logger.hpp"
 #include "common/status.hpp"
 #include "common/types.hpp"
@@ -14,108 +21,481 @@
 #include "sequential/sequential.hpp"
 #include "parallel/parallel.hpp"
 #include "naive_parallel/naive_parallel.hpp"
+#include "hopscotch/hopscotch.hpp"
+#include "cuckoo/cuckoo.hpp"
+#include "delegation/delegation.hpp"
+#include "flat_combining/flat_combining.hpp"
+#include "test_common/engine_variants.hpp"
 
+#include "affinity.hpp"
 #include "argument_parser.hpp"
+#include "baseline.hpp"
+#include "latency.hpp"
+#include "perf_counters.hpp"
 #include "recorder.hpp"
+#include "scheduler.hpp"
+#include "statistics.hpp"
 
-double
-run_sequential_performance_test(const std::vector<Trace> &traces)
+/// @brief  Options shared by every run of every engine.
+struct RunOptions {
+    /// Worker i is pinned to cpu_order[i % cpu_order.size()]. Empty means we
+    /// leave placement to the OS.
+    std::vector<int> cpu_order = {};
+    /// Insert every key in [0, max_num_keys) before the timed region.
+    bool preload = false;
+    size_t max_num_keys = 0;
+    /// Untimed runs (on a fresh table) before the timed repetitions.
+    size_t warmup_runs = 0;
+    size_t repetitions = 1;
+    bool collect_perf_counters = false;
+    bool collect_lock_profile = false;
+    /// How the closed-loop workers divide the trace.
+    SchedulePolicy schedule = SchedulePolicy::static_slices;
+    size_t chunk_size = 1024;
+    /// Options for the engines that take ParallelTableOptions.
+    ParallelTableOptions table_options = {};
+    /// Buckets per lock for the parallel_striped engine.
+    size_t lock_segment_size = 64;
+};
+
+/// @brief  One worker's search outcomes, for the hit ratio.
+struct alignas(64) SearchCounts {
+    uint64_t searches = 0;
+    uint64_t hits = 0;
+};
+
+/// @brief  Construct a fresh table, passing the table options to the engines
+///         that take them.
+template<typename HashTable>
+HashTable
+make_hash_table(const RunOptions &options)
 {
-    clock_t start_time, end_time;
-
-    start_time = clock();
-    SequentialRobinHoodHashTable hash_table;
-    for (auto &t : traces) {
-        switch (t.op) {
-        case TraceOperator::insert: {
-            hash_table.insert(t.key, t.value);
-            break;
-        }
-        case TraceOperator::search: {
-            volatile std::optional<ValueType> r = hash_table.search(t.key);
-            break;
-        }
-        case TraceOperator::remove: {
-            hash_table.remove(t.key);
-            break;
-        }
-        default: {
-            assert(0 && "impossible!");
-        }
-        }
+    if constexpr (std::is_constructible_v<HashTable, const ParallelTableOptions &, size_t>) {
+        // The striped engine, whose segment size has its own flag.
+        return HashTable(options.table_options, options.lock_segment_size);
+    } else if constexpr (std::is_constructible_v<HashTable, const ParallelTableOptions &>) {
+        return HashTable(options.table_options);
+    } else {
+        return HashTable();
+    }
+}
+
+template<typename HashTable>
+inline void
+execute_trace_operation(HashTable &hash_table, const Trace &t, SearchCounts &counts)
+{
+    switch (t.op) {
+    case TraceOperator::insert: {
+        hash_table.insert(t.key, t.value);
+        break;
+    }
+    case TraceOperator::search: {
+        // NOTE Counting the hits means the compiler will not optimize this
+        //      call out.
+        const auto r = hash_table.search(t.key);
+        ++counts.searches;
+        counts.hits += r.has_value();
+        break;
+    }
+    case TraceOperator::remove: {
+        hash_table.remove(t.key);
+        break;
+    }
+    default: {
+        assert(false && "impossible!");
+    }
+    }
+}
+
+static void
+pin_worker(const RunOptions &options, const size_t t_id)
+{
+    if (!options.cpu_order.empty()) {
+        pin_current_thread_to_cpu(options.cpu_order[t_id % options.cpu_order.size()]);
+    }
+}
+
+template<typename HashTable>
+void
+preload_hash_table(HashTable &hash_table, const RunOptions &options)
+{
+    if (!options.preload) {
+        return;
+    }
+    for (size_t k = 0; k < options.max_num_keys; ++k) {
+        hash_table.insert(static_cast<KeyType>(k), static_cast<ValueType>(k));
     }
-    end_time = clock();
-    double duration_in_seconds = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
-    std::cout << "Time in sec: " << duration_in_seconds << std::endl;
-    return duration_in_seconds;
 }
 
 template<typename HashTable>
 void
 run_parallel_worker(HashTable &hash_table,
                     const std::vector<Trace> &traces, const size_t t_id,
-                    const size_t num_workers)
+                    TraceScheduler &scheduler,
+                    const RunOptions &options,
+                    std::atomic<size_t> &num_ready,
+                    const std::atomic<bool> &go,
+                    SearchCounts &counts)
 {
-    size_t trace_size = traces.size();
+    pin_worker(options, t_id);
 
-    size_t traces_per_thread = trace_size / num_workers;
-    size_t traces_remaining = trace_size % num_workers;
-    size_t start_index = t_id * traces_per_thread;
-    size_t end_index = start_index + traces_per_thread;
+    // Wait for every worker to be created (and pinned) so that thread creation
+    // is not part of the timed region.
+    num_ready.fetch_add(1, std::memory_order_acq_rel);
+    while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
 
-    if (t_id == num_workers - 1)
-    {
-        end_index += traces_remaining;
+    size_t start_index = 0, end_index = 0;
+    while (scheduler.next(t_id, start_index, end_index)) {
+        for (size_t i = start_index; i < end_index; ++i) {
+            execute_trace_operation(hash_table, traces[i], counts);
+        }
+    }
+}
+
+/// @brief  Run the whole trace once on a fresh table and return the time of
+///         the timed region in seconds.
+///
+/// The table is constructed (and optionally preloaded) and the workers are
+/// created before the timed region starts. If snapshot is given, the table's
+/// stats() (and, if requested and supported, its lock profile) are stored in
+/// it after the timed region, and the search hits are added to it.
+template<typename HashTable>
+double
+run_closed_loop_once(const std::vector<Trace> &traces,
+                     const size_t num_workers,
+                     const RunOptions &options,
+                     PerfCounterGroup *counters,
+                     ClosedLoopResult *snapshot)
+{
+    HashTable hash_table = make_hash_table<HashTable>(options);
+    preload_hash_table(hash_table, options);
+    TraceScheduler scheduler(options.schedule, traces.size(), num_workers, options.chunk_size);
+
+    std::vector<std::thread> workers;
+    std::atomic<size_t> num_ready = 0;
+    std::atomic<bool> go = false;
+    std::vector<SearchCounts> counts(num_workers);
+    for (size_t i = 0; i < num_workers; ++i) {
+        workers.emplace_back(run_parallel_worker<HashTable>, std::ref(hash_table), std::ref(traces),
+                i, std::ref(scheduler), std::cref(options), std::ref(num_ready), std::cref(go),
+                std::ref(counts[i]));
+    }
+    while (num_ready.load(std::memory_order_acquire) < num_workers) {
+        std::this_thread::yield();
     }
 
-    for (size_t i = start_index; i < end_index; ++i) {
-        const Trace &t = traces[i];
-        switch (t.op) {
-        case TraceOperator::insert: {
-            hash_table.insert(t.key, t.value);
-            break;
+    if (counters != nullptr) {
+        counters->start();
+    }
+    const auto start_time = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &w : workers) {
+        w.join();
+    }
+    const auto end_time = std::chrono::steady_clock::now();
+    if (counters != nullptr) {
+        counters->stop();
+    }
+    if (snapshot != nullptr) {
+        if constexpr (requires { hash_table.stats(); }) {
+            snapshot->table_stats = hash_table.stats();
+            snapshot->num_filtered_misses += snapshot->table_stats.filtered_misses;
         }
-        case TraceOperator::search: {
-            // NOTE Marking this as volatile means the compiler will not
-            //      optimize this call out.
-            volatile auto r = hash_table.search(t.key);
-            break;
+        for (const auto &c : counts) {
+            snapshot->num_searches += c.searches;
+            snapshot->num_search_hits += c.hits;
         }
-        case TraceOperator::remove: {
-            hash_table.remove(t.key);
-            break;
+        if constexpr (requires { hash_table.lock_profile(); }) {
+            if (options.collect_lock_profile) {
+                snapshot->lock_profile = hash_table.lock_profile();
+            }
         }
-        default: {
-            assert(false && "impossible!");
+    }
+    return std::chrono::duration<double>(end_time - start_time).count();
+}
+
+/// @brief  Run the warm-up and the timed repetitions of one configuration.
+///
+/// N.B.  The sequential engine is run through here with a single worker.
+template<typename HashTable>
+ClosedLoopResult
+run_parallel_performance_test(const std::vector<Trace> &traces,
+                              const size_t num_workers,
+                              const RunOptions &options)
+{
+    ClosedLoopResult result;
+    result.num_workers = num_workers;
+    for (size_t i = 0; i < options.warmup_runs; ++i) {
+        run_closed_loop_once<HashTable>(traces, num_workers, options, nullptr, nullptr);
+    }
+    for (size_t i = 0; i < options.repetitions; ++i) {
+        // NOTE The counters must exist before we spawn the workers so that
+        //      they inherit them.
+        std::optional<PerfCounterGroup> counters;
+        if (options.collect_perf_counters) {
+            counters.emplace();
         }
+        const double duration_in_seconds = run_closed_loop_once<HashTable>(
+                traces, num_workers, options, counters.has_value() ? &counters.value() : nullptr,
+                &result);
+        if (counters.has_value()) {
+            result.perf.accumulate(counters->read());
+        }
+        result.time_sec.push_back(duration_in_seconds);
+    }
+    const SummaryStatistics s = summarize(result.time_sec);
+    std::cout << "Workers: " << num_workers << ", Time in sec: " << s.median <<
+            " (95% CI of mean: [" << s.ci95_low << ", " << s.ci95_high << "])";
+    if (result.num_searches != 0) {
+        const uint64_t num_misses = result.num_searches - result.num_search_hits;
+        std::cout << ", Hit ratio: " << static_cast<double>(result.num_search_hits) /
+                static_cast<double>(result.num_searches) << ", Miss ratio: " <<
+                static_cast<double>(num_misses) / static_cast<double>(result.num_searches);
+        if (result.table_stats.miss_filter_enabled && num_misses != 0) {
+            std::cout << " (" << static_cast<double>(result.num_filtered_misses) /
+                    static_cast<double>(num_misses) << " filtered)";
         }
     }
+    std::cout << std::endl;
+    return result;
 }
 
+/// @brief  Run one worker of the open-loop (fixed arrival rate) test.
+///
+/// Operation i of the trace is intended to start at the i-th arrival of the
+/// aggregate arrival process and is handled by worker (i % num_workers). We
+/// measure latency from the intended start time rather than from when the
+/// worker got around to it, so a stalled worker is charged for the queueing
+/// delay of every request that arrived behind it (i.e. we do not suffer from
+/// coordinated omission).
 template<typename HashTable>
-double
-run_parallel_performance_test(const std::vector<Trace> &traces, const size_t num_workers)
+void
+run_open_loop_worker(HashTable &hash_table,
+                     const std::vector<Trace> &traces,
+                     const size_t t_id,
+                     const size_t num_workers,
+                     const double qps,
+                     const bool poisson,
+                     const RunOptions &options,
+                     const std::chrono::steady_clock::time_point start_time,
+                     LatencyHistogram &latency,
+                     std::chrono::steady_clock::time_point &finish_time)
+{
+    pin_worker(options, t_id);
+
+    // Each worker sees every num_workers-th arrival, so its own arrival rate is
+    // qps / num_workers. A thinned Poisson process is not Poisson in general,
+    // but the superposition of independent Poisson processes is, so for the
+    // Poisson distribution each worker draws its own process at that rate.
+    const double worker_qps = qps / static_cast<double>(num_workers);
+    const double mean_gap_ns = 1e9 / worker_qps;
+    std::mt19937_64 rng(t_id);
+    SearchCounts counts;
+    std::exponential_distribution<double> gap_distribution(worker_qps / 1e9);
+
+    double intended_offset_ns = poisson ? gap_distribution(rng)
+                                        : 1e9 / qps * static_cast<double>(t_id);
+    for (size_t i = t_id; i < traces.size(); i += num_workers) {
+        const auto intended_time = start_time + std::chrono::nanoseconds(
+                static_cast<int64_t>(intended_offset_ns));
+        // Sleep while we are far ahead of schedule and spin for the rest so we
+        // do not pay the scheduler's wake-up latency on every operation.
+        auto now = std::chrono::steady_clock::now();
+        if (intended_time - now > std::chrono::microseconds(100)) {
+            std::this_thread::sleep_until(intended_time - std::chrono::microseconds(50));
+        }
+        while (std::chrono::steady_clock::now() < intended_time) {
+            // Spin
+        }
+
+        execute_trace_operation(hash_table, traces[i], counts);
+
+        now = std::chrono::steady_clock::now();
+        latency.record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - intended_time).count()));
+        intended_offset_ns += poisson ? gap_distribution(rng) : mean_gap_ns;
+    }
+    finish_time = std::chrono::steady_clock::now();
+}
+
+/// @brief  Replay the trace once at a fixed aggregate arrival rate.
+///
+/// As in the closed-loop test, the table is constructed (and preloaded) before
+/// the timed region. Each latency is measured from its arrival time in the
+/// schedule.
+template<typename HashTable>
+void
+run_open_loop_once(const std::vector<Trace> &traces,
+                   const size_t num_workers,
+                   const double qps,
+                   const std::string &arrival,
+                   const RunOptions &options,
+                   OpenLoopResult &result)
 {
+    HashTable hash_table = make_hash_table<HashTable>(options);
+    preload_hash_table(hash_table, options);
+    std::vector<LatencyHistogram> latencies(num_workers);
+    std::vector<std::chrono::steady_clock::time_point> finish_times(num_workers);
     std::vector<std::thread> workers;
 
-    const auto start_time = std::chrono::steady_clock::now();
-    HashTable hash_table;
+    // Give the workers a moment to start so the first arrivals are not all
+    // charged with thread creation time.
+    const auto start_time = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
     for (size_t i = 0; i < num_workers; ++i) {
-        workers.emplace_back(run_parallel_worker<HashTable>, std::ref(hash_table), std::ref(traces), i, num_workers);
+        workers.emplace_back(run_open_loop_worker<HashTable>,
+                std::ref(hash_table), std::ref(traces), i, num_workers, qps,
+                arrival == "poisson", std::cref(options), start_time, std::ref(latencies[i]),
+                std::ref(finish_times[i]));
     }
     for (auto &w : workers) {
         w.join();
     }
-    const auto end_time = std::chrono::steady_clock::now();
-    double duration_in_seconds = std::chrono::duration<double>(end_time - start_time).count();
-    std::cout << "Time in sec: " << duration_in_seconds << std::endl;
-    return duration_in_seconds;
+
+    LatencyHistogram run_latency;
+    auto end_time = start_time;
+    for (size_t i = 0; i < num_workers; ++i) {
+        run_latency.merge(latencies[i]);
+        end_time = std::max(end_time, finish_times[i]);
+    }
+    const double duration_in_seconds = std::chrono::duration<double>(end_time - start_time).count();
+    result.achieved_qps_samples.push_back(duration_in_seconds > 0.0
+            ? static_cast<double>(run_latency.count()) / duration_in_seconds : 0.0);
+    result.p99_ns_samples.push_back(static_cast<double>(run_latency.percentile(0.99)));
+    result.latency.merge(run_latency);
+}
+
+template<typename HashTable>
+OpenLoopResult
+run_open_loop_performance_test(const std::vector<Trace> &traces,
+                               const size_t num_workers,
+                               const double qps,
+                               const std::string &arrival,
+                               const RunOptions &options)
+{
+    assert(num_workers > 0 && qps > 0.0 && "need at least one worker and a positive rate");
+    OpenLoopResult result;
+    result.target_qps = qps;
+    for (size_t i = 0; i < options.warmup_runs; ++i) {
+        OpenLoopResult ignored;
+        run_open_loop_once<HashTable>(traces, num_workers, qps, arrival, options, ignored);
+    }
+    for (size_t i = 0; i < options.repetitions; ++i) {
+        run_open_loop_once<HashTable>(traces, num_workers, qps, arrival, options, result);
+    }
+    std::cout << "Open-loop target QPS: " << qps << ", achieved QPS: " <<
+            summarize(result.achieved_qps_samples).median <<
+            ", p50: " << result.latency.percentile(0.50) << " ns, p99: " <<
+            result.latency.percentile(0.99) << " ns" << std::endl;
+    return result;
+}
+
+/// @brief  Run every configuration of one engine.
+///
+/// N.B.  An engine that is not thread-safe only runs with a single worker.
+template<HashTableEngine HashTable>
+EngineResults
+run_engine(const std::string &name,
+           const std::vector<Trace> &traces,
+           const PerformanceTestArguments &args,
+           const RunOptions &options)
+{
+    constexpr bool thread_safe = HashTable::capabilities.thread_safe;
+    EngineResults results;
+    results.name = name;
+    results.capabilities = HashTable::capabilities;
+    std::cout << "=== " << name << " ===" << std::endl;
+    if (thread_safe) {
+        for (size_t w : args.thread_counts) {
+            results.closed_loop.push_back(run_parallel_performance_test<HashTable>(traces, w, options));
+        }
+    } else {
+        results.closed_loop.push_back(run_parallel_performance_test<HashTable>(traces, 1, options));
+    }
+    for (double qps : args.open_loop_qps) {
+        results.open_loop.push_back(run_open_loop_performance_test<HashTable>(
+                traces, thread_safe ? args.open_loop_workers : 1, qps, args.open_loop_arrival, options));
+    }
+    return results;
+}
+
+/// @brief  An engine that --engines can select.
+struct RegisteredEngine {
+    /// The name in the output JSON.
+    std::string name;
+    /// A shorter name that --engines also accepts.
+    std::string alias;
+    EngineResults (*run)(const std::string &name,
+                         const std::vector<Trace> &traces,
+                         const PerformanceTestArguments &args,
+                         const RunOptions &options);
+};
+
+template<HashTableEngine HashTable>
+RegisteredEngine
+register_engine(const std::string &name, const std::string &alias)
+{
+    return {name, alias, run_engine<HashTable>};
+}
+
+/// @brief  Every engine that the performance test can compare. To add an
+///         engine, add a line here.
+static const std::vector<RegisteredEngine> &
+engine_registry()
+{
+    static const std::vector<RegisteredEngine> registry = {
+        register_engine<SequentialRobinHoodHashTable>("sequential", "seq"),
+        register_engine<SkewAwareSequentialRobinHoodHashTable>("sequential_skew", "skew"),
+        register_engine<FilteredSequentialRobinHoodHashTable>("sequential_filtered", "filtered"),
+        register_engine<NaiveParallelRobinHoodHashTable>("naive_parallel", "naive"),
+        register_engine<ParallelRobinHoodHashTable>("parallel", "parallel"),
+        register_engine<StripedParallelRobinHoodHashTable>("parallel_striped", "striped"),
+        register_engine<OptimisticParallelRobinHoodHashTable>("parallel_optimistic", "optimistic"),
+        register_engine<SequentialHopscotchHashTable>("sequential_hopscotch", "hopscotch_seq"),
+        register_engine<ParallelHopscotchHashTable>("parallel_hopscotch", "hopscotch"),
+        register_engine<SequentialCuckooHashTable>("sequential_cuckoo", "cuckoo_seq"),
+        register_engine<ParallelCuckooHashTable>("parallel_cuckoo", "cuckoo"),
+        register_engine<DelegationHashTable>("delegation", "delegate"),
+        register_engine<FlatCombiningHashTable>("flat_combining", "fc"),
+        register_engine<StdUnorderedMapEngine>("std_unordered_map", "std"),
+    };
+    return registry;
+}
+
+static const RegisteredEngine *
+find_engine(const std::string &name)
+{
+    for (const auto &engine : engine_registry()) {
+        if (engine.name == name || engine.alias == name) {
+            return &engine;
+        }
+    }
+    return nullptr;
 }
 
 int main(int argc, char *argv[]) {
     PerformanceTestArguments args = parse_performance_test_arguments(argc, argv);
     args.print();
 
+    // Check the engine names before we spend any time generating traces.
+    std::vector<const RegisteredEngine *> selected_engines;
+    for (const auto &name : args.engines) {
+        const RegisteredEngine *engine = find_engine(name);
+        if (engine == nullptr) {
+            std::cerr << "Unknown engine '" << name << "'. Choose from:";
+            for (const auto &e : engine_registry()) {
+                std::cerr << " " << e.name;
+                if (e.alias != e.name) {
+                    std::cerr << " (" << e.alias << ")";
+                }
+            }
+            std::cerr << std::endl;
+            return 1;
+        }
+        selected_engines.push_back(engine);
+    }
+
     std::vector<Trace> traces;
     if (args.trace_op_mode == "random") {
         traces = generate_random_traces(args.max_num_keys, args.goal_trace_length,
@@ -126,22 +506,32 @@ int main(int argc, char *argv[]) {
     }
     LOG_INFO("Finished generating traces");
 
-    double seq_time_in_sec = run_sequential_performance_test(traces);
-    LOG_INFO("Finished sequential test");
+    RunOptions options;
+    options.cpu_order = get_cpu_order(args.affinity_policy, args.affinity_cpus);
+    options.preload = args.preload;
+    options.max_num_keys = args.max_num_keys;
+    options.warmup_runs = args.warmup_runs;
+    options.repetitions = args.repetitions;
+    options.collect_perf_counters = args.collect_perf_counters;
+    options.collect_lock_profile = !args.lock_profile_path.empty();
+    options.schedule = args.schedule_policy;
+    options.chunk_size = args.chunk_size;
+    options.table_options.cache_capacity = args.cache_capacity;
+    options.table_options.max_frequency = args.eviction == "gclock" ? 3 : 1;
+    options.table_options.front_cache = args.front_cache;
+    options.lock_segment_size = args.lock_segment_size;
 
-    std::vector<double> naive_parallel_time_in_sec;
-    for (size_t w = 1; w <= 32; ++w) {
-        double time = run_parallel_performance_test<NaiveParallelRobinHoodHashTable>(traces, w);
-        naive_parallel_time_in_sec.push_back(time);
+    std::vector<EngineResults> results;
+    for (const auto &engine : selected_engines) {
+        results.push_back(engine->run(engine->name, traces, args, options));
+        // N.B. The logger only takes numbers, so the name is in the "===" line.
+        LOG_INFO("Finished an engine's test");
     }
 
-    std::vector<double> parallel_time_in_sec;
-    for (size_t w = 1; w <= 32; ++w) {
-        double time = run_parallel_performance_test<ParallelRobinHoodHashTable>(traces, w);
-        parallel_time_in_sec.push_back(time);
+    record_performance_test_results(args, traces.size(), results);
+    if (!args.lock_profile_path.empty()) {
+        record_lock_profiles(args, results);
     }
 
-    record_performance_test_times(args, seq_time_in_sec, naive_parallel_time_in_sec, parallel_time_in_sec);
-
     return 0;
 }
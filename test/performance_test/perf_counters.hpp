@@ -0,0 +1,213 @@
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// @brief  Hardware events we collect around each timed region.
+///
+/// N.B.  The names double as the JSON keys (with a "_per_op" suffix).
+enum class PerfEvent : size_t {
+    cycles,
+    instructions,
+    llc_misses,
+    dtlb_misses,
+    branch_misses,
+    count,
+};
+
+constexpr std::array<const char *, static_cast<size_t>(PerfEvent::count)> perf_event_names = {
+    "cycles",
+    "instructions",
+    "llc_misses",
+    "dtlb_misses",
+    "branch_misses",
+};
+
+/// @brief  Counter totals for one timed region. An event is std::nullopt if
+///         the kernel or the hardware would not let us count it.
+struct PerfCounterSample {
+    std::array<std::optional<double>, static_cast<size_t>(PerfEvent::count)> totals = {};
+
+    std::optional<double>
+    per_op(const PerfEvent e, const size_t num_ops) const
+    {
+        const auto &total = this->totals[static_cast<size_t>(e)];
+        if (!total.has_value() || num_ops == 0) {
+            return std::nullopt;
+        }
+        return total.value() / static_cast<double>(num_ops);
+    }
+
+    /// @brief  Add another run's totals (e.g. from another repetition).
+    void
+    accumulate(const PerfCounterSample &other)
+    {
+        for (size_t i = 0; i < this->totals.size(); ++i) {
+            if (other.totals[i].has_value()) {
+                this->totals[i] = this->totals[i].value_or(0.0) + other.totals[i].value();
+            }
+        }
+    }
+};
+
+/// @brief  A set of perf_event_open counters on the calling thread.
+///
+/// The counters are opened with `inherit` set, so every thread created by the
+/// calling thread *after* construction is counted as well and its counts are
+/// folded into ours when it exits. This means the counters must be constructed
+/// before spawning the workers, and read after joining them.
+///
+/// If perf events are unavailable (e.g. non-Linux, or perf_event_paranoid
+/// forbids it), every event simply reads as std::nullopt.
+class PerfCounterGroup {
+public:
+    PerfCounterGroup()
+    {
+        this->fds_.fill(-1);
+#if defined(__linux__)
+        for (size_t i = 0; i < static_cast<size_t>(PerfEvent::count); ++i) {
+            this->fds_[i] = open_event(static_cast<PerfEvent>(i));
+        }
+        if (this->fds_[static_cast<size_t>(PerfEvent::cycles)] < 0 && !warned_unavailable()) {
+            std::cerr << "Hardware performance counters are unavailable: " <<
+                    std::strerror(errno) << " (check /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+            warned_unavailable() = true;
+        }
+#endif
+    }
+
+    PerfCounterGroup(const PerfCounterGroup &) = delete;
+    PerfCounterGroup &
+    operator=(const PerfCounterGroup &) = delete;
+
+    ~PerfCounterGroup()
+    {
+#if defined(__linux__)
+        for (int fd : this->fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    void
+    start()
+    {
+#if defined(__linux__)
+        for (int fd : this->fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    void
+    stop()
+    {
+#if defined(__linux__)
+        for (int fd : this->fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+#endif
+    }
+
+    /// @brief  Read the totals, scaled up if the kernel had to multiplex the
+    ///         counters (i.e. they were not running the whole time).
+    PerfCounterSample
+    read() const
+    {
+        PerfCounterSample sample;
+#if defined(__linux__)
+        for (size_t i = 0; i < static_cast<size_t>(PerfEvent::count); ++i) {
+            if (this->fds_[i] < 0) {
+                continue;
+            }
+            // Layout given by PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+            struct {
+                uint64_t value;
+                uint64_t time_enabled;
+                uint64_t time_running;
+            } data = {};
+            if (::read(this->fds_[i], &data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) ||
+                data.time_running == 0) {
+                continue;
+            }
+            sample.totals[i] = static_cast<double>(data.value) *
+                    (static_cast<double>(data.time_enabled) / static_cast<double>(data.time_running));
+        }
+#endif
+        return sample;
+    }
+
+private:
+#if defined(__linux__)
+    static int
+    open_event(const PerfEvent e)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        switch (e) {
+        case PerfEvent::cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfEvent::instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfEvent::llc_misses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_LL |
+                    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PerfEvent::dtlb_misses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PerfEvent::branch_misses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default:
+            return -1;
+        }
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // pid = 0, cpu = -1: this thread (and its future children) on any CPU.
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+    static bool &
+    warned_unavailable()
+    {
+        static bool warned = false;
+        return warned;
+    }
+
+    std::array<int, static_cast<size_t>(PerfEvent::count)> fds_;
+};
@@ -2,13 +2,301 @@
 
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <string>
 #include <vector>
 
+#include "common/engine.hpp"
+#include "common/stats.hpp"
+#include "parallel/lock_profile.hpp"
+
+#include "argument_parser.hpp"
+#include "latency.hpp"
+#include "perf_counters.hpp"
+#include "statistics.hpp"
+
+/// @brief  Minimal streaming JSON writer so we stop hand-placing commas.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::ostream &ostrm)
+        : ostrm_(ostrm)
+    {
+        // Keep enough digits to compare repeated runs.
+        this->ostrm_.precision(12);
+    }
+
+    JsonWriter &
+    begin_object()
+    {
+        this->separate();
+        this->ostrm_ << "{";
+        this->first_ = true;
+        return *this;
+    }
+
+    JsonWriter &
+    end_object()
+    {
+        this->ostrm_ << "}";
+        this->first_ = false;
+        return *this;
+    }
+
+    JsonWriter &
+    begin_array()
+    {
+        this->separate();
+        this->ostrm_ << "[";
+        this->first_ = true;
+        return *this;
+    }
+
+    JsonWriter &
+    end_array()
+    {
+        this->ostrm_ << "]";
+        this->first_ = false;
+        return *this;
+    }
+
+    /// @brief  Write an object key. The next value is written without a comma.
+    JsonWriter &
+    key(const std::string &k)
+    {
+        this->separate();
+        this->ostrm_ << "\"" << k << "\": ";
+        this->first_ = true;
+        return *this;
+    }
+
+    template<typename T>
+    JsonWriter &
+    value(const T &v)
+    {
+        this->separate();
+        this->ostrm_ << v;
+        return *this;
+    }
+
+    JsonWriter &
+    value(const std::string &v)
+    {
+        this->separate();
+        this->ostrm_ << "\"" << v << "\"";
+        return *this;
+    }
+
+    JsonWriter &
+    value(const bool v)
+    {
+        this->separate();
+        this->ostrm_ << (v ? "true" : "false");
+        return *this;
+    }
+
+    JsonWriter &
+    null_value()
+    {
+        this->separate();
+        this->ostrm_ << "null";
+        return *this;
+    }
+
+    template<typename T>
+    JsonWriter &
+    array(const std::vector<T> &vs)
+    {
+        this->begin_array();
+        for (const auto &v : vs) {
+            this->value(v);
+        }
+        return this->end_array();
+    }
+
+private:
+    void
+    separate()
+    {
+        // NOTE JSON does not allow trailing commas, so we emit the comma
+        //      before every element except the first.
+        if (!this->first_) {
+            this->ostrm_ << ", ";
+        }
+        this->first_ = false;
+    }
+
+    std::ostream &ostrm_;
+    bool first_ = true;
+};
+
+/// @brief  Every repetition of one (engine, number of workers) configuration.
+struct ClosedLoopResult {
+    size_t num_workers = 0;
+    std::vector<double> time_sec = {};
+    /// Summed over the repetitions.
+    PerfCounterSample perf = {};
+    /// Shape of the table at the end of the last repetition.
+    TableStats table_stats = {};
+    /// Lock profile of the last repetition, for engines that support it.
+    std::optional<LockProfile> lock_profile = std::nullopt;
+    /// Summed over the repetitions.
+    uint64_t num_searches = 0;
+    uint64_t num_search_hits = 0;
+    /// Summed over the repetitions, for tables with a miss filter.
+    uint64_t num_filtered_misses = 0;
+};
+
+struct EngineResults {
+    std::string name;
+    EngineCapabilities capabilities = {};
+    std::vector<ClosedLoopResult> closed_loop = {};
+    std::vector<OpenLoopResult> open_loop = {};
+};
+
+inline void
+record_summary_statistics(JsonWriter &json, const SummaryStatistics &s)
+{
+    json.begin_object();
+    json.key("median").value(s.median);
+    json.key("mean").value(s.mean);
+    json.key("stddev").value(s.stddev);
+    json.key("min").value(s.min);
+    json.key("max").value(s.max);
+    json.key("ci95_low").value(s.ci95_low);
+    json.key("ci95_high").value(s.ci95_high);
+    json.key("samples").array(s.samples);
+    json.end_object();
+}
+
 inline void
-record_performance_test_times(const PerformanceTestArguments &args,
-                              const double seq_time_sec,
-                              const std::vector<double> & naive_par_time_sec,
-                              const std::vector<double> & par_time_sec)
+record_perf_counters(JsonWriter &json, const PerfCounterSample &sample, const size_t num_ops)
+{
+    json.begin_object();
+    for (size_t i = 0; i < static_cast<size_t>(PerfEvent::count); ++i) {
+        json.key(std::string(perf_event_names[i]) + "_per_op");
+        const auto v = sample.per_op(static_cast<PerfEvent>(i), num_ops);
+        if (v.has_value()) {
+            json.value(v.value());
+        } else {
+            json.null_value();
+        }
+    }
+    const auto cycles = sample.totals[static_cast<size_t>(PerfEvent::cycles)];
+    const auto instructions = sample.totals[static_cast<size_t>(PerfEvent::instructions)];
+    json.key("ipc");
+    if (cycles.has_value() && instructions.has_value() && cycles.value() > 0.0) {
+        json.value(instructions.value() / cycles.value());
+    } else {
+        json.null_value();
+    }
+    json.end_object();
+}
+
+inline void
+record_table_stats(JsonWriter &json, const TableStats &s)
+{
+    json.begin_object();
+    json.key("length").value(s.length);
+    json.key("capacity").value(s.capacity);
+    json.key("load_factor").value(s.load_factor);
+    json.key("mean_displacement").value(s.mean_displacement);
+    json.key("max_displacement").value(s.max_displacement);
+    json.key("bytes_used").value(s.bytes_used);
+    json.key("probe_length_histogram").array(s.probe_length_histogram);
+    json.key("cluster_length_histogram").array(s.cluster_length_histogram);
+    if (s.counters_enabled) {
+        json.key("lock_acquisitions").value(s.lock_acquisitions);
+        json.key("contended_locks").value(s.contended_locks);
+        if (s.probe_retries_enabled) {
+            json.key("probe_retries").value(s.probe_retries);
+        }
+    }
+    if (s.cache_capacity != 0) {
+        json.key("cache_capacity").value(s.cache_capacity);
+        json.key("evictions").value(s.evictions);
+    }
+    if (s.ttl_enabled) {
+        json.key("expirations").value(s.expirations);
+    }
+    if (s.miss_filter_enabled) {
+        json.key("filtered_misses").value(s.filtered_misses);
+    }
+    json.end_object();
+}
+
+inline void
+record_closed_loop_result(JsonWriter &json,
+                          const PerformanceTestArguments &args,
+                          const size_t num_ops,
+                          const ClosedLoopResult &r)
+{
+    std::vector<double> throughput;
+    for (double t : r.time_sec) {
+        throughput.push_back(t > 0.0 ? static_cast<double>(num_ops) / t : 0.0);
+    }
+    json.begin_object();
+    json.key("threads").value(r.num_workers);
+    json.key("time_sec");
+    record_summary_statistics(json, summarize(r.time_sec));
+    json.key("throughput_ops_per_sec");
+    record_summary_statistics(json, summarize(throughput));
+    if (args.collect_perf_counters) {
+        json.key("perf_counters");
+        record_perf_counters(json, r.perf, num_ops * r.time_sec.size());
+    }
+    json.key("hit_ratio");
+    if (r.num_searches != 0) {
+        json.value(static_cast<double>(r.num_search_hits) / static_cast<double>(r.num_searches));
+    } else {
+        json.null_value();
+    }
+    json.key("miss_ratio");
+    if (r.num_searches != 0) {
+        json.value(static_cast<double>(r.num_searches - r.num_search_hits) / static_cast<double>(r.num_searches));
+    } else {
+        json.null_value();
+    }
+    json.key("table_stats");
+    record_table_stats(json, r.table_stats);
+    json.end_object();
+}
+
+inline void
+record_open_loop_result(JsonWriter &json, const OpenLoopResult &r)
+{
+    json.begin_object();
+    json.key("target_qps").value(r.target_qps);
+    json.key("achieved_qps");
+    record_summary_statistics(json, summarize(r.achieved_qps_samples));
+    json.key("count").value(r.latency.count());
+    json.key("mean_ns").value(r.latency.mean());
+    json.key("p50_ns").value(r.latency.percentile(0.50));
+    json.key("p90_ns").value(r.latency.percentile(0.90));
+    json.key("p99_ns").value(r.latency.percentile(0.99));
+    json.key("p999_ns").value(r.latency.percentile(0.999));
+    json.key("max_ns").value(r.latency.max());
+    json.key("p99_ns_per_repetition");
+    record_summary_statistics(json, summarize(r.p99_ns_samples));
+    json.end_object();
+}
+
+/// @brief  Write the results of every engine as one JSON object.
+///
+/// The layout is:
+/// {
+///   "config": {...},
+///   "engines": {
+///     "<engine>": {
+///       "capabilities": {"thread_safe": <bool>, "resizable": <bool>, "batched": <bool>},
+///       "closed_loop": [{"threads": <n>, "time_sec": {<stats>}, ...}, ...],
+///       "open_loop": [{"target_qps": <qps>, "p99_ns": ..., ...}, ...]
+///     }, ...
+///   }
+/// }
+inline void
+record_performance_test_results(const PerformanceTestArguments &args,
+                                const size_t num_ops,
+                                const std::vector<EngineResults> &results)
 {
     // Open file
     std::ofstream ostrm(args.output_json_path);
@@ -17,28 +305,110 @@ record_performance_test_times(const PerformanceTestArguments &args,
         return;
     }
 
-    ostrm << "{";
-    ostrm << "\"sequential\": " << seq_time_sec << ",";
-    ostrm << "\"naive_parallel\": [";
-    for (size_t i = 0; i < naive_par_time_sec.size(); ++i) {
-        ostrm << naive_par_time_sec[i];
-        // NOTE JSON does not allow trailing commas at the end of arrays, so
-        //      skip the last element.
-        if (i != naive_par_time_sec.size() - 1) {
-            ostrm << ", ";
+    JsonWriter json(ostrm);
+    json.begin_object();
+    json.key("config").begin_object();
+    json.key("mode").value(args.trace_op_mode);
+    json.key("ratio").array(std::vector<unsigned>{args.insert_ratio, args.search_ratio, args.remove_ratio});
+    json.key("num_keys").value(args.max_num_keys);
+    json.key("trace_length").value(num_ops);
+    json.key("threads").array(args.thread_counts);
+    json.key("affinity").value(args.affinity);
+    json.key("warmup_runs").value(args.warmup_runs);
+    json.key("preload").value(args.preload);
+    json.key("repetitions").value(args.repetitions);
+    json.key("schedule").value(args.schedule);
+    json.key("chunk_size").value(args.chunk_size);
+    json.key("cache_capacity").value(args.cache_capacity);
+    json.key("eviction").value(args.eviction);
+    json.key("lock_segment_size").value(args.lock_segment_size);
+    json.key("front_cache").value(args.front_cache);
+    json.key("engines").array(args.engines);
+    json.key("open_loop_arrival").value(args.open_loop_arrival);
+    json.key("open_loop_workers").value(args.open_loop_workers);
+    json.end_object();
+
+    json.key("engines").begin_object();
+    for (const auto &engine : results) {
+        json.key(engine.name).begin_object();
+        json.key("capabilities").begin_object();
+        json.key("thread_safe").value(engine.capabilities.thread_safe);
+        json.key("resizable").value(engine.capabilities.resizable);
+        json.key("batched").value(engine.capabilities.batched);
+        json.end_object();
+        json.key("closed_loop").begin_array();
+        for (const auto &r : engine.closed_loop) {
+            record_closed_loop_result(json, args, num_ops, r);
         }
-    }
-    ostrm << "],";
-    ostrm << "\"parallel\": [";
-    for (size_t i = 0; i < par_time_sec.size(); ++i) {
-        ostrm << par_time_sec[i];
-        // NOTE JSON does not allow trailing commas at the end of arrays, so
-        //      skip the last element.
-        if (i != par_time_sec.size() - 1) {
-            ostrm << ", ";
+        json.end_array();
+        json.key("open_loop").begin_array();
+        for (const auto &r : engine.open_loop) {
+            record_open_loop_result(json, r);
         }
+        json.end_array();
+        json.end_object();
     }
-    ostrm << "]";
-    ostrm << "}\n";
+    json.end_object();
+    json.end_object();
+    ostrm << "\n";
     ostrm.close();
 }
+
+/// @brief  Write the lock-contention heat maps to args.lock_profile_path.
+///
+/// For each engine with a lock profile, there is one entry per worker count
+/// with a column per bucket region, plus the correlation of each column with
+/// key hotness (the number of operations whose home is in that region).
+inline void
+record_lock_profiles(const PerformanceTestArguments &args,
+                     const std::vector<EngineResults> &results)
+{
+    std::ofstream ostrm(args.lock_profile_path);
+    if (!ostrm.is_open()) {
+        std::cerr << "Cannot open " << args.lock_profile_path << std::endl;
+        return;
+    }
+    JsonWriter json(ostrm);
+    bool any_enabled = false;
+    json.begin_object();
+    for (const auto &engine : results) {
+        std::vector<const ClosedLoopResult *> profiled;
+        for (const auto &r : engine.closed_loop) {
+            if (r.lock_profile.has_value()) {
+                profiled.push_back(&r);
+                any_enabled = any_enabled || r.lock_profile->enabled;
+            }
+        }
+        if (profiled.empty()) {
+            continue;
+        }
+        json.key(engine.name).begin_array();
+        for (const ClosedLoopResult *r : profiled) {
+            const LockProfile &p = r->lock_profile.value();
+            std::vector<uint64_t> acquisitions, contended, wait_ns, home_hits;
+            for (const auto &region : p.regions) {
+                acquisitions.push_back(region.acquisitions);
+                contended.push_back(region.contended);
+                wait_ns.push_back(region.wait_ns);
+                home_hits.push_back(region.home_hits);
+            }
+            json.begin_object();
+            json.key("threads").value(r->num_workers);
+            json.key("enabled").value(p.enabled);
+            json.key("region_size").value(p.region_size);
+            json.key("hotness_vs_contended").value(p.correlation_with_hotness(&LockProfileRegion::contended));
+            json.key("hotness_vs_wait_ns").value(p.correlation_with_hotness(&LockProfileRegion::wait_ns));
+            json.key("acquisitions").array(acquisitions);
+            json.key("contended").array(contended);
+            json.key("wait_ns").array(wait_ns);
+            json.key("home_hits").array(home_hits);
+            json.end_object();
+        }
+        json.end_array();
+    }
+    json.end_object();
+    ostrm << std::endl;
+    if (!any_enabled) {
+        std::cerr << "Lock profiling is disabled; rebuild with -DMM_PARALLEL_LOCK_PROFILING=ON" << std::endl;
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+/// @brief  How the trace is divided among the workers.
+///
+/// - static_slices: worker i runs the i-th contiguous slice of the trace. This
+///   is the original behaviour; with skewed keys, the slowest slice decides
+///   the measured time.
+/// - chunked: workers grab fixed-size chunks from a shared atomic cursor.
+/// - work_stealing: every worker starts with its own contiguous range of
+///   chunks and, once that is empty, steals half of the remaining chunks of
+///   another worker.
+enum class SchedulePolicy {
+    static_slices,
+    chunked,
+    work_stealing,
+};
+
+/// @brief  Hand out [begin, end) ranges of trace indices to the workers.
+///
+/// One scheduler is shared by all of the workers of a single run.
+class TraceScheduler {
+public:
+    TraceScheduler(const SchedulePolicy policy,
+                   const size_t trace_size,
+                   const size_t num_workers,
+                   const size_t chunk_size)
+        : policy_(policy),
+          trace_size_(trace_size),
+          num_workers_(num_workers),
+          chunk_size_(std::max<size_t>(chunk_size, 1)),
+          workers_(num_workers)
+    {
+        const size_t num_chunks = (trace_size + this->chunk_size_ - 1) / this->chunk_size_;
+        assert(num_chunks <= UINT32_MAX && "chunk indices must fit in 32 bits");
+        for (size_t t_id = 0; t_id < num_workers; ++t_id) {
+            // Same partition as the static slices, but in units of chunks.
+            const size_t begin = num_chunks * t_id / num_workers;
+            const size_t end = num_chunks * (t_id + 1) / num_workers;
+            this->workers_[t_id].range.store(pack(begin, end), std::memory_order_relaxed);
+        }
+    }
+
+    /// @brief  Get the next range of trace indices for worker t_id.
+    ///
+    /// @return false once there is no work left for this worker.
+    bool
+    next(const size_t t_id, size_t &begin, size_t &end)
+    {
+        switch (this->policy_) {
+        case SchedulePolicy::static_slices:
+            return this->next_static(t_id, begin, end);
+        case SchedulePolicy::chunked:
+            return this->next_chunked(begin, end);
+        case SchedulePolicy::work_stealing:
+            return this->next_stolen(t_id, begin, end);
+        default:
+            assert(false && "impossible!");
+            return false;
+        }
+    }
+
+private:
+    static uint64_t
+    pack(const size_t begin, const size_t end)
+    {
+        return (static_cast<uint64_t>(begin) << 32) | static_cast<uint64_t>(end);
+    }
+
+    static size_t
+    unpack_begin(const uint64_t range)
+    {
+        return range >> 32;
+    }
+
+    static size_t
+    unpack_end(const uint64_t range)
+    {
+        return range & UINT32_MAX;
+    }
+
+    void
+    chunk_to_indices(const size_t chunk, size_t &begin, size_t &end) const
+    {
+        begin = chunk * this->chunk_size_;
+        end = std::min(begin + this->chunk_size_, this->trace_size_);
+    }
+
+    bool
+    next_static(const size_t t_id, size_t &begin, size_t &end)
+    {
+        Worker &w = this->workers_[t_id];
+        if (w.static_done) {
+            return false;
+        }
+        w.static_done = true;
+        const size_t traces_per_thread = this->trace_size_ / this->num_workers_;
+        begin = t_id * traces_per_thread;
+        end = begin + traces_per_thread;
+        if (t_id == this->num_workers_ - 1) {
+            end += this->trace_size_ % this->num_workers_;
+        }
+        return begin < end;
+    }
+
+    bool
+    next_chunked(size_t &begin, size_t &end)
+    {
+        begin = this->cursor_.fetch_add(this->chunk_size_, std::memory_order_relaxed);
+        if (begin >= this->trace_size_) {
+            return false;
+        }
+        end = std::min(begin + this->chunk_size_, this->trace_size_);
+        return true;
+    }
+
+    /// @brief  Pop a chunk from the front of our own range, or else steal the
+    ///         back half of another worker's range.
+    ///
+    /// Each range is a packed (begin, end) pair of chunk indices, so the owner
+    /// (advancing begin) and thieves (retreating end) resolve races with a
+    /// single compare-and-swap on the same word.
+    bool
+    next_stolen(const size_t t_id, size_t &begin, size_t &end)
+    {
+        std::atomic<uint64_t> &own = this->workers_[t_id].range;
+        uint64_t r = own.load(std::memory_order_acquire);
+        while (unpack_begin(r) < unpack_end(r)) {
+            const uint64_t popped = pack(unpack_begin(r) + 1, unpack_end(r));
+            if (own.compare_exchange_weak(r, popped, std::memory_order_acq_rel)) {
+                this->chunk_to_indices(unpack_begin(r), begin, end);
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < this->num_workers_; ++i) {
+            std::atomic<uint64_t> &victim = this->workers_[(t_id + i) % this->num_workers_].range;
+            uint64_t v = victim.load(std::memory_order_acquire);
+            while (unpack_begin(v) < unpack_end(v)) {
+                const size_t remaining = unpack_end(v) - unpack_begin(v);
+                const size_t steal = (remaining + 1) / 2;
+                const size_t steal_begin = unpack_end(v) - steal;
+                if (victim.compare_exchange_weak(v, pack(unpack_begin(v), steal_begin),
+                                                 std::memory_order_acq_rel)) {
+                    // Keep the first stolen chunk and publish the rest as our
+                    // own range. Nobody else writes to an empty range, so a
+                    // plain store is enough.
+                    own.store(pack(steal_begin + 1, steal_begin + steal), std::memory_order_release);
+                    this->chunk_to_indices(steal_begin, begin, end);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    struct alignas(64) Worker {
+        std::atomic<uint64_t> range = 0;
+        bool static_done = false;
+    };
+
+    const SchedulePolicy policy_;
+    const size_t trace_size_;
+    const size_t num_workers_;
+    const size_t chunk_size_;
+    alignas(64) std::atomic<size_t> cursor_ = 0;
+    std::vector<Worker> workers_;
+};
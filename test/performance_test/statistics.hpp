@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+/// @brief  Summary of repeated measurements of one configuration.
+struct SummaryStatistics {
+    size_t count = 0;
+    double median = 0.0;
+    double mean = 0.0;
+    double stddev = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    /// 95% confidence interval of the mean (Student's t). With one sample,
+    /// the interval collapses to the sample itself.
+    double ci95_low = 0.0;
+    double ci95_high = 0.0;
+    std::vector<double> samples = {};
+};
+
+/// @brief  Two-sided 95% critical value of Student's t-distribution.
+static double
+student_t_critical_95(const size_t degrees_of_freedom)
+{
+    // Source: standard t-table, df = 1..30.
+    static constexpr std::array<double, 30> table = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    if (degrees_of_freedom == 0) {
+        return 0.0;
+    }
+    if (degrees_of_freedom <= table.size()) {
+        return table[degrees_of_freedom - 1];
+    }
+    // The normal approximation is within 2% beyond df = 30.
+    return 1.960;
+}
+
+static SummaryStatistics
+summarize(const std::vector<double> &samples)
+{
+    SummaryStatistics s;
+    s.samples = samples;
+    s.count = samples.size();
+    if (samples.empty()) {
+        return s;
+    }
+
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    const size_t n = sorted.size();
+    s.min = sorted.front();
+    s.max = sorted.back();
+    s.median = (n % 2 == 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0;
+
+    double sum = 0.0;
+    for (double x : sorted) {
+        sum += x;
+    }
+    s.mean = sum / static_cast<double>(n);
+
+    double sum_sq = 0.0;
+    for (double x : sorted) {
+        sum_sq += (x - s.mean) * (x - s.mean);
+    }
+    s.stddev = n > 1 ? std::sqrt(sum_sq / static_cast<double>(n - 1)) : 0.0;
+
+    const double half_width = student_t_critical_95(n - 1) * s.stddev / std::sqrt(static_cast<double>(n));
+    s.ci95_low = s.mean - half_width;
+    s.ci95_high = s.mean + half_width;
+    return s;
+}
@@ -3,17 +3,44 @@
 import itertools
 import json
 import subprocess
-from typing import List, Tuple
+from typing import Dict, List, Tuple
 
 import matplotlib.pyplot as plt
 
 
+# Consistent colours and labels for the engines we know about. Unknown engines
+# fall back to matplotlib's default colour cycle and their raw name.
+ENGINE_STYLES = {
+    "sequential": ("Sequential", "tab:blue"),
+    "sequential_skew": ("Sequential (Skew-Aware)", "navy"),
+    "sequential_filtered": ("Sequential (Miss Filter)", "deepskyblue"),
+    "naive_parallel": ("Naive Parallel", "tab:green"),
+    "parallel": ("Parallel", "tab:red"),
+    "parallel_striped": ("Parallel (Striped)", "salmon"),
+    "parallel_optimistic": ("Parallel (Optimistic)", "darkred"),
+    "sequential_hopscotch": ("Sequential Hopscotch", "tab:cyan"),
+    "parallel_hopscotch": ("Parallel Hopscotch", "tab:purple"),
+    "sequential_cuckoo": ("Sequential Cuckoo", "tab:olive"),
+    "parallel_cuckoo": ("Parallel Cuckoo", "tab:orange"),
+    "delegation": ("Delegation", "tab:brown"),
+    "flat_combining": ("Flat Combining", "tab:pink"),
+    "std_unordered_map": ("std::unordered_map", "tab:gray"),
+}
+
+
 def run_performance_tests(
     modes: List[str] = ["random", "ordered"],
     ratios: List[Tuple[int, int, int]] = [(10, 80, 10), (33, 33, 33), (50, 0, 50), (1, 98, 1)],
     max_num_keys: int = 10000,
     goal_trace_length: int = 100000,
     version: int = 0,               # TODO Change this if you have multiple runs
+    open_loop_qps: List[int] = [],  # Empty means closed-loop only
+    open_loop_arrival: str = "poisson",
+    threads: List[int] = [x for x in range(1, 32 + 1)],
+    affinity: str = "compact",
+    warmup_runs: int = 1,
+    repetitions: int = 5,
+    lock_profile: bool = False,     # Needs -DMM_PARALLEL_LOCK_PROFILING=ON
 ):
     for m, r in itertools.product(modes, ratios):
         print(f"Running '{m}' mode with ratios {r} keys {max_num_keys} length {goal_trace_length}")
@@ -30,7 +57,16 @@ def run_performance_tests(
             f"--trace-length {goal_trace_length}",
             f" --mode {m}",
             f"--output {output_file}",
-        ])
+            f"--threads {','.join(str(t) for t in threads)}",
+            f"--affinity {affinity}",
+            f"--warmup {warmup_runs}",
+            f"--repetitions {repetitions}",
+        ] + ([
+            f"--qps {','.join(str(q) for q in open_loop_qps)}",
+            f"--arrival {open_loop_arrival}",
+        ] if open_loop_qps else []) + ([
+            f"--lock-profile {output_file.removesuffix('.json')}-locks.json",
+        ] if lock_profile else []))
         print(f"Running '{cmd}'")
         subprocess.run(cmd, shell=True)
 
@@ -39,14 +75,8 @@ def run_performance_tests(
         output_file = f"plots/{m}-{r[0]}:{r[1]}:{r[2]}-n{max_num_keys}-t{goal_trace_length}-v{version}.json"
         with open(output_file) as f:
             j = json.load(f)
-        sequential_time = j["sequential"]
-        naive_parallel_times = j["naive_parallel"]
-        parallel_times = j["parallel"]
         plot_performance(
-            sequential_time_in_sec=sequential_time,
-            parallel_num_workers=[x for x in range(1, 32 + 1)],
-            naive_parallel_time_in_sec=naive_parallel_times,
-            parallel_time_in_sec=parallel_times,
+            engines=j["engines"],
             workload_name=f"{m} operators",
             insert_ratio=r[0],
             search_ratio=r[1],
@@ -55,15 +85,108 @@ def run_performance_tests(
             goal_trace_length=goal_trace_length,
             version=version,
         )
+        if lock_profile:
+            plot_lock_profile(
+                lock_profile_file=f"{output_file.removesuffix('.json')}-locks.json",
+                save_title=f"{output_file.removesuffix('.json')}-locks",
+            )
+        if any(e["open_loop"] for e in j["engines"].values()):
+            plot_throughput_latency(
+                engines=j["engines"],
+                arrival=j["config"]["open_loop_arrival"],
+                workload_name=f"{m} operators",
+                insert_ratio=r[0],
+                search_ratio=r[1],
+                remove_ratio=r[2],
+                max_num_keys=max_num_keys,
+                goal_trace_length=goal_trace_length,
+                version=version,
+            )
+
+
+def plot_throughput_latency(
+    *,
+    engines: Dict,
+    arrival: str,
+    workload_name: str,
+    insert_ratio: int,
+    search_ratio: int,
+    remove_ratio: int,
+    max_num_keys: int,
+    goal_trace_length: int,
+    version: int,
+):
+    """
+    Plot the throughput-latency curve of each engine from an open-loop run.
+    """
+    title = "\n".join([
+        f"Throughput vs Latency for {workload_name} ({arrival} arrivals)",
+        f"with insert:search:remove ratio {insert_ratio}:{search_ratio}:{remove_ratio}",
+        f"with {max_num_keys} keys and {goal_trace_length} operations",
+    ])
+    save_title = f"plots/{workload_name}-{insert_ratio}:{search_ratio}:{remove_ratio}-n{max_num_keys}-t{goal_trace_length}-v{version}-latency"
+
+    plt.figure()
+    plt.title(title)
+    plt.xlabel("Achieved Throughput [ops/s]")
+    plt.ylabel("Latency [ns]")
+    plt.yscale("log")
+
+    for engine, results in engines.items():
+        label, color = ENGINE_STYLES.get(engine, (engine, None))
+        points = results["open_loop"]
+        if not points:
+            continue
+        throughput = [p["achieved_qps"]["median"] for p in points]
+        plt.plot(throughput, [p["p50_ns"] for p in points], label=f"{label} p50", c=color, linestyle="dashed", marker="o")
+        plt.plot(throughput, [p["p99_ns"] for p in points], label=f"{label} p99", c=color, linestyle="solid", marker="o")
+
+    plt.legend()
+    plt.savefig(save_title)
+
+
+def plot_lock_profile(*, lock_profile_file: str, save_title: str):
+    """
+    Plot the lock-contention heat map (worker count by bucket region) of each
+    profiled engine, next to a scatter plot of key hotness vs time spent
+    waiting for locks in each region.
+    """
+    with open(lock_profile_file) as f:
+        j = json.load(f)
+    for engine, profiles in j.items():
+        profiles = [p for p in profiles if p["enabled"]]
+        if not profiles:
+            continue
+        label, _ = ENGINE_STYLES.get(engine, (engine, None))
+        region_size = profiles[0]["region_size"]
+
+        fig, (heat, scatter) = plt.subplots(1, 2, figsize=(14, 5))
+        fig.suptitle(f"Lock Contention for {label} ({region_size} buckets per region)")
+        im = heat.imshow(
+            [p["wait_ns"] for p in profiles],
+            aspect="auto",
+            interpolation="nearest",
+            extent=(0, len(profiles[0]["wait_ns"]) * region_size, len(profiles), 0),
+        )
+        heat.set_yticks([i + 0.5 for i in range(len(profiles))], [str(p["threads"]) for p in profiles])
+        heat.set_xlabel("Bucket Index")
+        heat.set_ylabel("Number of Workers")
+        fig.colorbar(im, ax=heat, label="Lock Wait [ns]")
+
+        for p in profiles:
+            scatter.scatter(
+                p["home_hits"], p["wait_ns"], s=4,
+                label=f"{p['threads']} workers (r={p['hotness_vs_wait_ns']:.2f})",
+            )
+        scatter.set_xlabel("Operations Homed in Region")
+        scatter.set_ylabel("Lock Wait [ns]")
+        scatter.legend()
+        fig.savefig(f"{save_title}-{engine}")
 
 
 def plot_performance(
     *,
-    sequential_time_in_sec: float,
-    # For both naive and parallel implementations
-    parallel_num_workers: List[float],
-    naive_parallel_time_in_sec: List[float],
-    parallel_time_in_sec: List[float],
+    engines: Dict,
     workload_name: str,
     insert_ratio: int,
     search_ratio: int,
@@ -74,6 +197,10 @@ def plot_performance(
 ):
     """
     Plot the results of a performance test.
+
+    Engines that were only run with a single worker (e.g. the sequential one)
+    are drawn as a horizontal line; the others are drawn against the number of
+    workers, with the 95% confidence interval as error bars.
     """
     title = "\n".join([
         f"Performance Test for {workload_name}",
@@ -89,9 +216,17 @@ def plot_performance(
     plt.ylabel("Total Compuation Time [s]")
 
     # Plot data
-    plt.axhline(y=sequential_time_in_sec, label="Sequential", color="tab:blue", linestyle="dashed")
-    plt.plot(parallel_num_workers, naive_parallel_time_in_sec, label="Naive Parallel", c="tab:green", linestyle="solid")
-    plt.plot(parallel_num_workers, parallel_time_in_sec, label="Parallel", c="tab:red", linestyle="solid")
+    for engine, results in engines.items():
+        label, color = ENGINE_STYLES.get(engine, (engine, None))
+        points = results["closed_loop"]
+        if len(points) == 1:
+            plt.axhline(y=points[0]["time_sec"]["median"], label=label, color=color, linestyle="dashed")
+            continue
+        workers = [p["threads"] for p in points]
+        median = [p["time_sec"]["median"] for p in points]
+        lower = [max(0.0, p["time_sec"]["median"] - p["time_sec"]["ci95_low"]) for p in points]
+        upper = [max(0.0, p["time_sec"]["ci95_high"] - p["time_sec"]["median"]) for p in points]
+        plt.errorbar(workers, median, yerr=[lower, upper], label=label, c=color, linestyle="solid", capsize=2)
 
     # Finish up plot and save
     plt.legend()
@@ -100,10 +235,11 @@ def plot_performance(
 
 def main():
     plot_performance(
-        sequential_time_in_sec=10.0,
-        parallel_num_workers=[x for x in range(1, 32 + 1)],
-        naive_parallel_time_in_sec=[x + 1 for x in range(1, 32 + 1)],
-        parallel_time_in_sec=[x for x in range(1, 32 + 1)],
+        engines={
+            "sequential": {"closed_loop": [{"threads": 1, "time_sec": {"median": 10.0, "ci95_low": 10.0, "ci95_high": 10.0}}]},
+            "naive_parallel": {"closed_loop": [{"threads": x, "time_sec": {"median": x + 1, "ci95_low": x + 0.5, "ci95_high": x + 1.5}} for x in range(1, 32 + 1)]},
+            "parallel": {"closed_loop": [{"threads": x, "time_sec": {"median": x, "ci95_low": x - 0.5, "ci95_high": x + 0.5}} for x in range(1, 32 + 1)]},
+        },
         workload_name="Ficticious Example",
         insert_ratio=1,
         search_ratio=1,
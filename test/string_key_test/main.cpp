@@ -0,0 +1,240 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/status.hpp"
+#include "common/types.hpp"
+#include "string_key/string_key.hpp"
+
+using ReferenceMap = std::unordered_map<std::string, ValueType>;
+
+////////////////////////////////////////////////////////////////////////////////
+/// HELPERS
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Check that hash_table holds exactly the pairs in map.
+///
+/// @return the number of mismatches.
+size_t
+check_contents(const std::string &name,
+               const StringKeyRobinHoodHashTable &hash_table,
+               const ReferenceMap &map)
+{
+    size_t num_failures = 0;
+    for (const auto &[key, value] : map) {
+        const std::optional<ValueType> actual = hash_table.search(key);
+        if (actual != std::optional<ValueType>(value)) {
+            std::cout << name << ": search failed for a key of length " << key.size() << std::endl;
+            ++num_failures;
+        }
+    }
+    size_t num_entries = 0;
+    hash_table.for_each([&](const std::string_view key, const ValueType value) {
+        ++num_entries;
+        const auto it = map.find(std::string(key));
+        if (it == map.end() || it->second != value) {
+            std::cout << name << ": unexpected entry for a key of length " << key.size() << std::endl;
+            ++num_failures;
+        }
+    });
+    if (num_entries != map.size()) {
+        std::cout << name << ": size is " << num_entries << ", expected " << map.size() << std::endl;
+        ++num_failures;
+    }
+    return num_failures;
+}
+
+bool
+report(const std::string &name, const size_t num_failures)
+{
+    std::cout << name << ": " << (num_failures == 0 ? "SUCCESS" : "FAILURE") << std::endl;
+    return num_failures == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// TESTS
+////////////////////////////////////////////////////////////////////////////////
+
+//keys of at most 4 bytes live in the bucket and longer ones in the arena;
+//check that keys which differ only in length or in embedded '\0's, on either
+//side of that boundary, stay distinct
+bool
+test_inline_and_arena_keys()
+{
+    const std::string name = "inline_and_arena_keys";
+    size_t num_failures = 0;
+    StringKeyRobinHoodHashTable hash_table;
+    ReferenceMap map;
+
+    const std::vector<std::string> keys = {
+        "",
+        std::string("\0", 1),
+        std::string("\0\0", 2),
+        std::string("\0\0\0\0", 4),
+        std::string("\0\0\0\0\0", 5),
+        "a",
+        std::string("a\0", 2),
+        std::string("\0a", 2),
+        "ab",
+        "abc",
+        "abcd",
+        std::string("ab\0d", 4),
+        "abcde",
+        std::string("abcd\0", 5),
+        "a somewhat longer key that lives in the arena",
+        std::string("a somewhat longer key that lives in the arena\0", 46),
+    };
+    for (size_t i = 0; i < keys.size(); ++i) {
+        hash_table.insert(keys[i], static_cast<ValueType>(i));
+        map[keys[i]] = static_cast<ValueType>(i);
+    }
+    num_failures += check_contents(name, hash_table, map);
+
+    //random trace over a small alphabet (with '\0'), so that many keys share
+    //prefixes and short keys pad to the same bytes as longer ones
+    std::mt19937 rng(0);
+    const char alphabet[] = {'\0', 'a', 'b'};
+    for (size_t i = 0; i < 100000; ++i) {
+        std::string key(rng() % 8, '\0');
+        for (char &c : key) {
+            c = alphabet[rng() % sizeof(alphabet)];
+        }
+        switch (rng() % 3) {
+            case 0: {
+                const ValueType value = static_cast<ValueType>(i);
+                hash_table.insert(key, value);
+                map[key] = value;
+                break;
+            }
+            case 1: {
+                const auto it = map.find(key);
+                const std::optional<ValueType> expected =
+                        it == map.end() ? std::nullopt : std::optional<ValueType>(it->second);
+                if (hash_table.search(key) != expected) {
+                    std::cout << name << ": search failed at step " << i << std::endl;
+                    ++num_failures;
+                }
+                break;
+            }
+            case 2: {
+                const ErrorType expected = map.erase(key) != 0 ? ErrorType::ok : ErrorType::e_notfound;
+                if (hash_table.remove(key) != expected) {
+                    std::cout << name << ": remove failed at step " << i << std::endl;
+                    ++num_failures;
+                }
+                break;
+            }
+        }
+    }
+    num_failures += check_contents(name, hash_table, map);
+    return report(name, num_failures);
+}
+
+//removing most of the arena keys makes remove() compact the arena; the
+//remaining keys must survive the move
+bool
+test_compaction()
+{
+    const std::string name = "compaction";
+    constexpr size_t num_keys = 8192;
+    size_t num_failures = 0;
+    StringKeyRobinHoodHashTable hash_table;
+    ReferenceMap map;
+
+    size_t num_bytes = 0;
+    for (size_t i = 0; i < num_keys; ++i) {
+        const std::string key = "a key long enough for the arena, number " + std::to_string(i);
+        hash_table.insert(key, static_cast<ValueType>(i));
+        map[key] = static_cast<ValueType>(i);
+        num_bytes += key.size();
+    }
+    for (size_t i = 0; i < num_keys; ++i) {
+        if (i % 4 != 0) {
+            const std::string key = "a key long enough for the arena, number " + std::to_string(i);
+            hash_table.remove(key);
+            map.erase(key);
+        }
+        //interleave inline keys, which never touch the arena
+        hash_table.insert(std::to_string(i % 1000), static_cast<ValueType>(i));
+        map[std::to_string(i % 1000)] = static_cast<ValueType>(i);
+    }
+    const StringArena &arena = hash_table.arena();
+    if (arena.live_bytes() + arena.dead_bytes() >= num_bytes) {
+        std::cout << name << ": the arena was never compacted" << std::endl;
+        ++num_failures;
+    }
+    num_failures += check_contents(name, hash_table, map);
+    return report(name, num_failures);
+}
+
+//grow the table past its initial capacity; the references move to the new
+//bucket array, but the arena does not
+bool
+test_resize()
+{
+    const std::string name = "resize";
+    size_t num_failures = 0;
+    StringKeyRobinHoodHashTable hash_table;
+    ReferenceMap map;
+
+    //as many keys as there are buckets is past the maximum load factor; the
+    //first 10000 (with at most 4 digits) are inline
+    const size_t initial_capacity = hash_table.stats().capacity;
+    for (size_t i = 0; i < initial_capacity; ++i) {
+        const std::string key = std::to_string(i);
+        hash_table.insert(key, static_cast<ValueType>(i));
+        map[key] = static_cast<ValueType>(i);
+    }
+    if (hash_table.stats().capacity <= initial_capacity) {
+        std::cout << name << ": the table did not grow" << std::endl;
+        ++num_failures;
+    }
+    num_failures += check_contents(name, hash_table, map);
+    return report(name, num_failures);
+}
+
+//a key's length must fit in 16 bits; a longer key is rejected and changes
+//nothing
+bool
+test_key_length_limit()
+{
+    const std::string name = "key_length_limit";
+    size_t num_failures = 0;
+    StringKeyRobinHoodHashTable hash_table;
+    ReferenceMap map;
+
+    const std::string longest(UINT16_MAX, 'x');
+    const std::string too_long(size_t{UINT16_MAX} + 1, 'x');
+    if (hash_table.insert(longest, 1) != ErrorType::ok) {
+        std::cout << name << ": rejected a key of the maximum length" << std::endl;
+        ++num_failures;
+    }
+    map[longest] = 1;
+    if (hash_table.insert(too_long, 2) == ErrorType::ok) {
+        std::cout << name << ": accepted a key over the maximum length" << std::endl;
+        ++num_failures;
+    }
+    if (hash_table.search(too_long).has_value() || hash_table.remove(too_long) != ErrorType::e_notfound) {
+        std::cout << name << ": found a key over the maximum length" << std::endl;
+        ++num_failures;
+    }
+    num_failures += check_contents(name, hash_table, map);
+    return report(name, num_failures);
+}
+
+
+int
+main()
+{
+    bool ok = true;
+    ok &= test_inline_and_arena_keys();
+    ok &= test_compaction();
+    ok &= test_resize();
+    ok &= test_key_length_limit();
+    return ok ? 0 : 1;
+}
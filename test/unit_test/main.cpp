@@ -1,135 +1,259 @@
-#include "trace/trace.hpp"
-#include <vector>
-#include <unordered_map>
+#include <chrono>
 #include <iostream>
-#include "sequential/sequential.hpp"
-#include "parallel/parallel.hpp"
-#include <unordered_set>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
+#include "common/engine.hpp"
 #include "common/types.hpp"
+#include "cuckoo/cuckoo.hpp"
+#include "delegation/delegation.hpp"
+#include "flat_combining/flat_combining.hpp"
+#include "hopscotch/hopscotch.hpp"
+#include "naive_parallel/naive_parallel.hpp"
+#include "parallel/parallel.hpp"
+#include "sequential/sequential.hpp"
+#include "test_common/engine_variants.hpp"
+#include "trace/trace.hpp"
+#include "utility/hash.hpp"
+#include "utility/utility.hpp"
 
 
-std::unordered_map<KeyType, ValueType> map;
-SequentialRobinHoodHashTable sequential_hash_table;
-ParallelRobinHoodHashTable parallel_hash_table;
-
-
-//run trace on unordered map for baseline comparison
-void 
-test_traces_on_unordered_map(const std::vector<Trace>& traces) 
+//run trace on an engine and check every result against std::unordered_map
+template<HashTableEngine HashTable>
+bool
+test_traces_on_engine(const std::string &name,
+                      const std::vector<Trace> &traces,
+                      const size_t max_num_keys)
 {
-    for (const auto& trace : traces) {
+    HashTable hash_table;
+    std::unordered_map<KeyType, ValueType> map;
+    size_t num_failures = 0;
+    for (const auto &trace : traces) {
         switch (trace.op) {
-            case TraceOperator::insert:
+            case TraceOperator::insert: {
+                hash_table.insert(trace.key, trace.value);
                 map[trace.key] = trace.value;
                 break;
-            case TraceOperator::search:
-                map.find(trace.key);
+            }
+            case TraceOperator::search: {
+                const auto actual = hash_table.search(trace.key);
+                const auto it = map.find(trace.key);
+                const bool expected_found = it != map.end();
+                if (actual.has_value() != expected_found ||
+                        (expected_found && actual.value() != it->second)) {
+                    std::cout << name << ": search failed for key " << trace.key << std::endl;
+                    ++num_failures;
+                }
                 break;
-            case TraceOperator::remove:
-                map.erase(trace.key);
+            }
+            case TraceOperator::remove: {
+                const bool removed = hash_table.remove(trace.key) == ErrorType::ok;
+                if (removed != (map.erase(trace.key) != 0)) {
+                    std::cout << name << ": remove failed for key " << trace.key << std::endl;
+                    ++num_failures;
+                }
                 break;
+            }
         }
     }
-}
 
-//run trace on sequential hash table for comparison 
-void 
-test_traces_on_sequential(const std::vector<Trace>& traces) 
-{
-    for (const auto& trace : traces) {
-        switch (trace.op) {
-            case TraceOperator::insert:
-                sequential_hash_table.insert((trace.key), (trace.value));
-                break;
-            case TraceOperator::search:
-                sequential_hash_table.search(trace.key);
-                break;
-            case TraceOperator::remove:
-                sequential_hash_table.remove(trace.key);
-                break;
+    //check that the final contents match, including the keys that are absent
+    for (size_t k = 0; k < max_num_keys; ++k) {
+        const KeyType key = static_cast<KeyType>(k);
+        const auto actual = hash_table.search(key);
+        const auto it = map.find(key);
+        if (actual.has_value() != (it != map.end()) ||
+                (actual.has_value() && actual.value() != it->second)) {
+            std::cout << name << ": final search failed for key " << key << std::endl;
+            ++num_failures;
         }
     }
+    if (hash_table.size() != map.size()) {
+        std::cout << name << ": size is " << hash_table.size() << ", expected " << map.size() << std::endl;
+        ++num_failures;
+    }
+
+    std::cout << name << ": " << (num_failures == 0 ? "SUCCESS" : "FAILURE") << std::endl;
+    return num_failures == 0;
 }
 
-//run trace on parallel hash table for comparison 
-void 
-test_traces_on_parallel(const std::vector<Trace>& traces) 
+//check a hash policy: its batched hashing must agree with its scalar hashing,
+//and its seed must decide whether two keys share a home (so that an attacker
+//who does not know the seed cannot choose keys that collide, i.e. HashDoS)
+template<typename Hash>
+bool
+test_hash_policy(const std::string &name)
 {
-    for (const auto& trace : traces) {
-        switch (trace.op) {
-            case TraceOperator::insert:
-                parallel_hash_table.insert((trace.key), (trace.value));
-                break;
-            case TraceOperator::search:
-                parallel_hash_table.find(trace.key);
-                break;
-            case TraceOperator::remove:
-                parallel_hash_table.remove(trace.key);
-                break;
+    constexpr size_t num_seeds = 1000;
+    constexpr size_t capacity = 1 << 20;
+    size_t num_failures = 0;
+    std::mt19937_64 rng(0);
+
+    for (size_t s = 0; s < 100; ++s) {
+        const Hash hasher(rng());
+        KeyType keys[64];
+        for (KeyType &key : keys) {
+            key = static_cast<KeyType>(rng());
+        }
+        HashCodeType batch_8[8];
+        HashCodeType batch_64[64];
+        hash_batch<8>(hasher, keys, batch_8);
+        hash_batch<64>(hasher, keys, batch_64);
+        for (size_t i = 0; i < 64; ++i) {
+            if ((i < 8 && batch_8[i] != hasher(keys[i])) || batch_64[i] != hasher(keys[i])) {
+                std::cout << name << ": batch hash differs from scalar hash for key " << keys[i] << std::endl;
+                ++num_failures;
+            }
+        }
+    }
+
+    //for a fixed key difference, only about num_seeds / capacity seeds should
+    //put a key and its partner in the same home (188609 used to do so for
+    //every seed with Crc32Hash)
+    for (const KeyType difference : {KeyType{1}, KeyType{188609}, static_cast<KeyType>(rng())}) {
+        size_t num_collisions = 0;
+        for (size_t s = 0; s < num_seeds; ++s) {
+            const Hash hasher(rng());
+            const KeyType a = static_cast<KeyType>(rng());
+            const KeyType b = a ^ difference;
+            num_collisions += get_home(hasher(a), capacity) == get_home(hasher(b), capacity);
+        }
+        if (num_collisions > 5) {
+            std::cout << name << ": keys " << difference << " apart share a home under " << num_collisions
+                      << " of " << num_seeds << " seeds" << std::endl;
+            ++num_failures;
         }
     }
-}
 
+    std::cout << name << " hash: " << (num_failures == 0 ? "SUCCESS" : "FAILURE") << std::endl;
+    return num_failures == 0;
+}
 
-int 
-main(int argc, char** argv) 
+//check that entries inserted with a short TTL read as misses once it passes,
+//and that each is reclaimed (and counted in the expirations stat) exactly once:
+//by its own lookup, by another key's probe passing it, by expire_tick(), or by
+//the background sweeper
+bool
+test_ttl_on_parallel(const std::string &name, const ParallelTableOptions &options)
 {
-
-    //generate random traces 
-    std::vector<Trace> traces = generate_random_traces(100, 1000); 
-    
-    //run traces on all three hash tables 
-    test_traces_on_unordered_map(traces);
-    test_traces_on_sequential(traces);
-    test_traces_on_parallel(traces);
-
-    bool equal = true;
-
-    //check if all values in unordered map are in sequential hash table
-    for (auto& element: map) 
-    {
-        auto actual = sequential_hash_table.search(element.first);
-
-        if(actual.value() != element.second) 
-        {
-            std::cout << "**************************" << std::endl;
-            std::cout << "********FAILURE**********" << std::endl;
-            std::cout << "********SEQUENTIAL*******" << std::endl;
-            std::cout << "Search failed for key " << element.first << std::endl;
-            std::cout << "**************************" << std::endl;
-            equal = false;
+    using namespace std::chrono_literals;
+    constexpr auto short_ttl = 20ms;
+    constexpr auto long_ttl = 1h;
+    constexpr KeyType num_keys = 100;
+    size_t num_failures = 0;
+    const auto check = [&](const bool ok, const std::string &what) {
+        if (!ok) {
+            std::cout << name << ": " << what << std::endl;
+            ++num_failures;
         }
+    };
+
+    ParallelRobinHoodHashTable hash_table(options);
 
+    //expired keys read as misses and are reclaimed when looked up; a plain
+    //insert clears a TTL and a long one has not passed
+    for (KeyType k = 0; k < num_keys; ++k) {
+        hash_table.insert_with_ttl(k, k, short_ttl);
     }
+    hash_table.insert(0, 1000);
+    hash_table.insert_with_ttl(1, 1001, long_ttl);
+    std::this_thread::sleep_for(2 * short_ttl);
+    check(hash_table.size() == num_keys, "expired entries were reclaimed before any lookup");
+    for (KeyType k = 0; k < num_keys; ++k) {
+        const std::optional<ValueType> v = hash_table.search(k);
+        if (k < 2) {
+            check(v == std::optional<ValueType>(1000 + k), "lost an entry whose TTL was cleared or long");
+        } else {
+            check(!v.has_value(), "found an expired entry");
+        }
+    }
+    check(hash_table.size() == 2, "expired entries were not reclaimed when looked up");
+    check(hash_table.stats().expirations == num_keys - 2, "wrong number of expirations after lookups");
+    hash_table.remove(0);
+    hash_table.remove(1);
 
-    //check if all values in unordered map are in parallel hash table
-    for (auto& element: map) 
-    {
-        auto actual = parallel_hash_table.find(element.first);
-
-        if(actual.first != element.second) 
-        {
-            std::cout << "**************************" << std::endl;
-            std::cout << "********FAILURE**********" << std::endl;
-            std::cout << "********PARALLEL*******" << std::endl;
-            std::cout << "Search failed for key " << element.first << std::endl;
-            std::cout << "**************************" << std::endl;
-            equal = false;
+    //an expired entry is reclaimed by a lookup of another key whose probe
+    //passes it
+    std::vector<KeyType> colliding;
+    const size_t home = hash_table.home_of(0);
+    for (KeyType k = 0; colliding.size() < 2; ++k) {
+        if (hash_table.home_of(k) == home) {
+            colliding.push_back(k);
         }
+    }
+    hash_table.insert_with_ttl(colliding[0], 0, short_ttl);
+    hash_table.insert(colliding[1], 1);
+    std::this_thread::sleep_for(2 * short_ttl);
+    check(hash_table.search(colliding[1]) == std::optional<ValueType>(1), "lost an entry behind an expired one");
+    check(hash_table.size() == 1, "an expired entry along the probe was not reclaimed");
+    check(hash_table.stats().expirations == num_keys - 1, "wrong number of expirations after a probe");
+    hash_table.remove(colliding[1]);
+
+    //expire_tick() reclaims expired entries that are never looked up
+    const size_t capacity = hash_table.stats().capacity;
+    for (KeyType k = 0; k < num_keys; ++k) {
+        hash_table.insert_with_ttl(k, k, short_ttl);
+    }
+    std::this_thread::sleep_for(2 * short_ttl);
+    check(hash_table.expire_tick(capacity) == num_keys, "expire_tick() missed expired entries");
+    check(hash_table.size() == 0, "expire_tick() left expired entries");
+    check(hash_table.stats().expirations == 2 * num_keys - 1, "wrong number of expirations after a tick");
 
+    //and so does the background sweeper
+    for (KeyType k = 0; k < num_keys; ++k) {
+        hash_table.insert_with_ttl(k, k, short_ttl);
     }
-    
-    //if all values in unordered map are in both hash tables, then they are equal
-    if(equal)
-    {
-        std::cout << "**************************" << std::endl;
-        std::cout << "*********SUCCESS**********" << std::endl;
-        std::cout << "****Hash tables equal*****" << std::endl;
-        std::cout << "**************************" << std::endl;
+    hash_table.start_expiry_sweeper(1ms, capacity);
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (hash_table.size() != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
     }
+    hash_table.stop_expiry_sweeper();
+    check(hash_table.size() == 0, "the sweeper left expired entries");
+    check(hash_table.stats().expirations == 3 * num_keys - 1, "wrong number of expirations after sweeping");
 
-    return 0;
+    std::cout << name << " TTL: " << (num_failures == 0 ? "SUCCESS" : "FAILURE") << std::endl;
+    return num_failures == 0;
 }
 
 
+int
+main()
+{
+    constexpr size_t max_num_keys = 100;
+
+    //generate random traces
+    const std::vector<Trace> traces = generate_random_traces(max_num_keys, 10000);
+
+    bool ok = true;
+    ok &= test_traces_on_engine<SequentialRobinHoodHashTable>("sequential", traces, max_num_keys);
+    ok &= test_traces_on_engine<SkewAwareSequentialRobinHoodHashTable>("sequential_skew", traces, max_num_keys);
+    ok &= test_traces_on_engine<FilteredSequentialRobinHoodHashTable>("sequential_filtered", traces, max_num_keys);
+    ok &= test_traces_on_engine<NaiveParallelRobinHoodHashTable>("naive_parallel", traces, max_num_keys);
+    ok &= test_traces_on_engine<ParallelRobinHoodHashTable>("parallel", traces, max_num_keys);
+    ok &= test_traces_on_engine<StripedParallelRobinHoodHashTable>("parallel_striped", traces, max_num_keys);
+    ok &= test_traces_on_engine<OptimisticParallelRobinHoodHashTable>("parallel_optimistic", traces, max_num_keys);
+    ok &= test_traces_on_engine<FrontCachedParallelRobinHoodHashTable>("parallel_front_cache", traces, max_num_keys);
+    ok &= test_traces_on_engine<SequentialHopscotchHashTable>("sequential_hopscotch", traces, max_num_keys);
+    ok &= test_traces_on_engine<ParallelHopscotchHashTable>("parallel_hopscotch", traces, max_num_keys);
+    ok &= test_traces_on_engine<SequentialCuckooHashTable>("sequential_cuckoo", traces, max_num_keys);
+    ok &= test_traces_on_engine<ParallelCuckooHashTable>("parallel_cuckoo", traces, max_num_keys);
+    ok &= test_traces_on_engine<DelegationHashTable>("delegation", traces, max_num_keys);
+    ok &= test_traces_on_engine<FlatCombiningHashTable>("flat_combining", traces, max_num_keys);
+
+    ok &= test_hash_policy<SplitMixHash>("splitmix");
+    ok &= test_hash_policy<MultiplyShiftHash>("multiply_shift");
+    ok &= test_hash_policy<Crc32Hash>("crc32");
+    ok &= test_hash_policy<WyHash>("wyhash");
+
+    ok &= test_ttl_on_parallel("parallel", ParallelTableOptions{.enable_ttl = true});
+    ok &= test_ttl_on_parallel(
+            "parallel_striped",
+            ParallelTableOptions{.enable_ttl = true,
+                                 .lock_segment_size = StripedParallelRobinHoodHashTable::default_lock_segment_size});
+
+    return ok ? 0 : 1;
+}